@@ -0,0 +1,18 @@
+#pragma once
+
+#include "MIR.hpp"
+
+#include <string>
+
+// 将 MIR 打印为 GNU 汇编文本, 是代码生成的最后一步
+class AsmPrinter {
+  public:
+    explicit AsmPrinter(const MachineModule &module) : module_(module) {}
+
+    std::string print() const;
+
+  private:
+    std::string print_function(const MachineFunction &func) const;
+
+    const MachineModule &module_;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "BasicBlock.hpp"
+#include "Instruction.hpp"
+
+#include <vector>
+
+/* 比较与条件跳转的融合
+ * cminusf 中条件的典型形式为
+ *   %c = icmp/fcmp ...; %z = zext i1 %c to i32; %b = icmp ne i32 %z, 0; br %b
+ * 若其中每个定值都只被链上的下一条指令使用且位于同一基本块,
+ * 则整条链不需要物化, 直接以根比较 %c 的操作数生成 blt/bge/beq/bne 或 fcmp + bcnez。
+ */
+
+// 返回 br 可以融合的比较链, 最后一个元素为根比较; 不可融合时为空
+std::vector<Instruction *> get_fused_cmp_chain(BasicBlock *bb);
+
+// 指令是否被融合进了其所在块的条件跳转
+bool is_fused_into_br(Instruction *inst);
@@ -1,34 +1,42 @@
 #pragma once
 
-#include "ASMInstruction.hpp"
+#include "MIR.hpp"
 #include "Module.hpp"
+#include "RegAlloc.hpp"
 #include "Register.hpp"
 
+#include <memory>
+
+class ThreadPool;
+
 class CodeGen {
   public:
-    explicit CodeGen(Module *module) : m(module) {}
+    // pool 不为空且有多个线程时, 各函数的代码在其上并行生成
+    explicit CodeGen(Module *module,
+                     RegAllocKind regalloc_kind = RegAllocKind::stack,
+                     bool tail_call = false, ThreadPool *pool = nullptr);
 
     std::string print() const;
 
     void run();
 
-    template <class... Args> void append_inst(Args... arg) {
-        output.emplace_back(arg...);
+    MachineModule &get_machine_module() { return mmodule; }
+
+    // 在当前机器基本块末尾追加指令
+    void append_inst(MachineInstr::OpID op,
+                     std::initializer_list<MachineOperand> args) {
+        context.mbb->append(MachineInstr(op, args));
     }
 
-    void
-    append_inst(const char *inst, std::initializer_list<std::string> args,
-                ASMInstruction::InstType ty = ASMInstruction::Instruction) {
-        auto content = std::string(inst) + " ";
-        for (const auto &arg : args) {
-            content += arg + ", ";
-        }
-        content.pop_back();
-        content.pop_back();
-        output.emplace_back(content, ty);
+    void append_comment(std::string content) {
+        append_inst(MachineInstr::COMMENT,
+                    {MachineOperand::label(std::move(content))});
     }
 
   private:
+    // 为 func 生成代码, 写入 mfunc; 只访问 func 及本对象的 context 与 regalloc
+    void gen_function(Function *func, MachineFunction *mfunc);
+
     void allocate();
     void copy_stmt(); // for phi copy
 
@@ -37,6 +45,13 @@ class CodeGen {
     void load_to_freg(Value *, const FReg &);
     void load_from_stack_to_greg(Value *, const Reg &);
 
+    // 获取操作数所在的寄存器, 未分配寄存器时装载到临时寄存器 tmp 中
+    Reg use_greg(Value *, const Reg &tmp);
+    FReg use_freg(Value *, const FReg &tmp);
+    // 获取定值应写入的寄存器, 未分配寄存器时为 tmp, 写入后需调用 store_from_*
+    Reg def_greg(Value *, const Reg &tmp);
+    FReg def_freg(Value *, const FReg &tmp);
+
     // 向寄存器中加载立即数
     void load_large_int32(int32_t, const Reg &);
     void load_large_int64(int64_t, const Reg &);
@@ -49,7 +64,9 @@ class CodeGen {
     void gen_prologue();
     void gen_ret();
     void gen_br();
+    void gen_fused_br(Instruction *cmp); // 与比较融合的条件跳转
     void gen_binary();
+    void gen_sdiv_imm(const Reg &n, const Reg &dst, int32_t d);
     void gen_float_binary();
     void gen_alloca();
     void gen_load();
@@ -58,45 +75,60 @@ class CodeGen {
     void gen_fcmp();
     void gen_zext();
     void gen_call();
+    bool is_sibling_call(Instruction *inst) const;
     void gen_gep();
     void gen_sitofp();
     void gen_fptosi();
     void gen_epilogue();
+    void restore_frame(); // epilogue 中除返回之外的部分, 尾调用前也需要
 
     static std::string label_name(BasicBlock *bb) {
         return "." + bb->get_parent()->get_name() + "_" + bb->get_name();
     }
 
-    static std::string func_exit_label_name(Function *func) {
-        return func->get_name() + "_exit";
-    }
-
-    static std::string fcmp_label_name(BasicBlock *bb, unsigned cnt) {
-        return label_name(bb) + "_fcmp_" + std::to_string(cnt);
-    }
-
     struct {
         /* 随着ir遍历设置 */
         Function *func{nullptr};    // 当前函数
         BasicBlock *bb{nullptr};    // 当前基本块
         Instruction *inst{nullptr}; // 当前指令
+        MachineFunction *mfunc{nullptr}; // 当前机器函数
+        MachineBasicBlock *mbb{nullptr}; // 当前机器基本块
         int num{0};
         /* 在allocate()中设置 */
         unsigned frame_size{0}; // 当前函数的栈帧大小
+        bool has_call{false};   // 函数中是否存在调用, 没有调用时无需备份 $ra
+        bool frameless{false};  // 叶函数且没有栈上数据, 不建立栈帧
         std::unordered_map<Value *, int> offset_map{}; // 指针相对 fp 的偏移
-        unsigned fcmp_cnt{0}; // fcmp 的计数器, 用于创建 fcmp 需要的 label
+        std::unordered_map<Value *, int> alloca_map{}; // alloca 空间相对 fp 的偏移
+        std::unordered_map<Value *, unsigned> greg_map{}; // 分配到的整数寄存器
+        std::unordered_map<Value *, unsigned> freg_map{}; // 分配到的浮点寄存器
+        // 需要备份的被调用者保存寄存器及其备份位置相对 fp 的偏移
+        std::vector<std::pair<unsigned, int>> saved_gregs{};
+        std::vector<std::pair<unsigned, int>> saved_fregs{};
 
         void clear() {
             func = nullptr;
             bb = nullptr;
             inst = nullptr;
+            mfunc = nullptr;
+            mbb = nullptr;
             frame_size = 0;
-            fcmp_cnt = 0;
+            has_call = false;
+            frameless = false;
             offset_map.clear();
+            alloca_map.clear();
+            greg_map.clear();
+            freg_map.clear();
+            saved_gregs.clear();
+            saved_fregs.clear();
         }
 
     } context;
 
     Module *m;
-    std::list<ASMInstruction> output;
+    RegAllocKind regalloc_kind;
+    bool tail_call; // 是否把紧跟 ret 的调用翻译为跳转
+    ThreadPool *pool;
+    std::unique_ptr<RegAlloc> regalloc;
+    MachineModule mmodule;
 };
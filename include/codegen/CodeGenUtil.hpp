@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
+#include <utility>
 
 /* 关于位宽 */
 #define IMM_12_MAX 0x7FF
@@ -16,51 +18,14 @@ inline unsigned ALIGN(unsigned x, unsigned alignment) {
 
 inline bool IS_IMM_12(int x) { return x <= IMM_12_MAX and x >= IMM_12_MIN; }
 
+/* 有符号 32 位除以常量 d 的魔数与移位量 (要求 2 <= |d| 且 d 不是 2 的幂):
+ * n / d = (mulh(n, magic) (+/- n)) >> shift, 再加上结果的符号位 */
+std::pair<int32_t, int> signed_div_magic(int32_t d);
+
 /* 栈帧相关 */
 #define PROLOGUE_OFFSET_BASE 16 // $ra $fp
 #define PROLOGUE_ALIGN 16
 
-/* 龙芯指令 */
-// Arithmetic
-#define ADD "add"
-#define SUB "sub"
-#define MUL "mul"
-#define DIV "div"
-
-#define ADDI "addi"
-
-#define FADD "fadd"
-#define FSUB "fsub"
-#define FMUL "fmul"
-#define FDIV "fdiv"
-
-#define ORI "ori"
-
-#define LU12I_W "lu12i.w"
-#define LU32I_D "lu32i.d"
-#define LU52I_D "lu52i.d"
-
-// Data transfer (greg <-> freg)
-#define GR2FR "movgr2fr"
-#define FR2GR "movfr2gr"
-
-// Memory access
-#define LOAD "ld"
-#define STORE "st"
-#define FLOAD "fld"
-#define FSTORE "fst"
-
-#define BYTE ".b"
-#define HALF_WORD ".h"
-#define WORD ".w"
-#define DOUBLE ".d"
-
-#define SINGLE ".s" // float
-#define LONG ".l"
-
-// ASM syntax sugar
-#define LOAD_ADDR "la.local"
-
 // errors
 class not_implemented_error : public std::logic_error {
   public:
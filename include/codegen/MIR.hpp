@@ -0,0 +1,249 @@
+#pragma once
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Register.hpp"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+/* 机器级中间表示 (MIR)
+ * CodeGen 的指令选择生成 MIR, 之后的优化直接在 MIR 上进行,
+ * 最后由 AsmPrinter 将其打印为汇编文本。
+ */
+
+class MachineOperand {
+  public:
+    enum Kind {
+        GRegKind,  // 通用寄存器
+        FRegKind,  // 浮点寄存器
+        CFRegKind, // 条件标志寄存器
+        ImmKind,   // 立即数
+        LabelKind, // 标签或符号
+    };
+
+    MachineOperand(const Reg &reg) : kind_(GRegKind), reg_(reg.id) {}
+    MachineOperand(const FReg &reg) : kind_(FRegKind), reg_(reg.id) {}
+    MachineOperand(const CFReg &reg) : kind_(CFRegKind), reg_(reg.id) {}
+
+    static MachineOperand imm(int64_t val) {
+        MachineOperand op(ImmKind);
+        op.imm_ = val;
+        return op;
+    }
+    static MachineOperand label(std::string name) {
+        MachineOperand op(LabelKind);
+        op.label_ = std::move(name);
+        return op;
+    }
+
+    Kind get_kind() const { return kind_; }
+    bool is_greg() const { return kind_ == GRegKind; }
+    bool is_freg() const { return kind_ == FRegKind; }
+    bool is_cfreg() const { return kind_ == CFRegKind; }
+    bool is_imm() const { return kind_ == ImmKind; }
+    bool is_label() const { return kind_ == LabelKind; }
+
+    Reg get_greg() const { return Reg(reg_); }
+    FReg get_freg() const { return FReg(reg_); }
+    CFReg get_cfreg() const { return CFReg(reg_); }
+    int64_t get_imm() const { return imm_; }
+    const std::string &get_label() const { return label_; }
+
+    bool operator==(const MachineOperand &other) const;
+    bool operator!=(const MachineOperand &other) const {
+        return not(*this == other);
+    }
+
+    std::string print() const;
+
+  private:
+    explicit MachineOperand(Kind kind) : kind_(kind) {}
+
+    Kind kind_;
+    unsigned reg_{0};
+    int64_t imm_{0};
+    std::string label_;
+};
+
+class MachineInstr {
+  public:
+    enum OpID {
+        // Arithmetic
+        ADD_W,
+        ADD_D,
+        SUB_W,
+        SUB_D,
+        MUL_W,
+        MULH_W,
+        DIV_W,
+        ADDI_W,
+        ADDI_D,
+        ALSL_W,
+        ALSL_D,
+        // Shift
+        SLLI_W,
+        SLLI_D,
+        SRLI_W,
+        SRAI_W,
+        // Logic & compare
+        ORI,
+        XOR,
+        XORI,
+        SLT,
+        SLTU,
+        SLTUI,
+        BSTRPICK_W,
+        BSTRPICK_D,
+        MOVE,
+        // Immediate
+        LU12I_W,
+        LU32I_D,
+        LU52I_D,
+        // Memory access
+        LD_B,
+        LD_W,
+        LD_D,
+        ST_B,
+        ST_W,
+        ST_D,
+        FLD_S,
+        FLD_D,
+        FST_S,
+        FST_D,
+        // Float
+        FADD_S,
+        FSUB_S,
+        FMUL_S,
+        FDIV_S,
+        FMOV_S,
+        FCMP_SLT_S,
+        FCMP_SLE_S,
+        FCMP_SEQ_S,
+        FCMP_SNE_S,
+        FFINT_S_W,
+        FTINTRZ_W_S,
+        // Data transfer (greg <-> freg, fcc -> greg)
+        MOVGR2FR_W,
+        MOVFR2GR_S,
+        MOVCF2GR,
+        // ASM syntax sugar
+        LA_LOCAL,
+        // Control flow
+        B,
+        BNEZ,
+        BEQ,
+        BNE,
+        BLT,
+        BGE,
+        BCNEZ,
+        BL,
+        JR,
+        // 伪指令: 注释, 操作数为一个标签
+        COMMENT,
+    };
+
+    MachineInstr(OpID op, std::vector<MachineOperand> operands)
+        : op_id_(op), operands_(std::move(operands)) {}
+
+    OpID get_opcode() const { return op_id_; }
+    void set_opcode(OpID op) { op_id_ = op; }
+    static std::string get_opcode_name(OpID op);
+
+    const std::vector<MachineOperand> &get_operands() const {
+        return operands_;
+    }
+    const MachineOperand &get_operand(unsigned i) const {
+        return operands_.at(i);
+    }
+    void set_operand(unsigned i, MachineOperand op) {
+        operands_.at(i) = std::move(op);
+    }
+    unsigned get_num_operand() const { return operands_.size(); }
+
+    bool is_comment() const { return op_id_ == COMMENT; }
+    bool is_load() const;
+    bool is_store() const;
+    bool is_call() const { return op_id_ == BL; }
+    bool is_terminator() const;
+
+    // 第一个操作数是否为该指令写入的寄存器
+    bool has_def() const;
+    const MachineOperand &get_def() const { return operands_.at(0); }
+    // 指令读取的寄存器操作数 (不含 call 的隐式传参)
+    std::vector<MachineOperand> get_uses() const;
+
+    std::string print() const;
+
+  private:
+    OpID op_id_;
+    std::vector<MachineOperand> operands_;
+};
+
+class MachineBasicBlock {
+  public:
+    // bb 为空时表示 prologue 或 epilogue 这样没有对应 IR 基本块的部分
+    MachineBasicBlock(std::string label, BasicBlock *bb = nullptr)
+        : label_(std::move(label)), bb_(bb) {}
+
+    const std::string &get_label() const { return label_; }
+    BasicBlock *get_ir_block() const { return bb_; }
+
+    std::list<MachineInstr> &get_instrs() { return instrs_; }
+    const std::list<MachineInstr> &get_instrs() const { return instrs_; }
+
+    void append(MachineInstr inst) { instrs_.push_back(std::move(inst)); }
+
+  private:
+    std::string label_;
+    BasicBlock *bb_;
+    std::list<MachineInstr> instrs_;
+};
+
+class MachineFunction {
+  public:
+    explicit MachineFunction(Function *func) : func_(func) {}
+
+    Function *get_ir_function() const { return func_; }
+    std::string get_name() const { return func_->get_name(); }
+
+    MachineBasicBlock *create_block(std::string label,
+                                    BasicBlock *bb = nullptr) {
+        blocks_.emplace_back(std::move(label), bb);
+        return &blocks_.back();
+    }
+    std::list<MachineBasicBlock> &get_blocks() { return blocks_; }
+    const std::list<MachineBasicBlock> &get_blocks() const { return blocks_; }
+
+  private:
+    Function *func_;
+    std::list<MachineBasicBlock> blocks_;
+};
+
+class MachineModule {
+  public:
+    struct Global {
+        std::string name;
+        unsigned size;
+    };
+
+    void add_global(std::string name, unsigned size) {
+        globals_.push_back({std::move(name), size});
+    }
+    const std::vector<Global> &get_globals() const { return globals_; }
+
+    MachineFunction *create_function(Function *func) {
+        functions_.emplace_back(func);
+        return &functions_.back();
+    }
+    std::list<MachineFunction> &get_functions() { return functions_; }
+    const std::list<MachineFunction> &get_functions() const {
+        return functions_;
+    }
+
+  private:
+    std::vector<Global> globals_;
+    std::list<MachineFunction> functions_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "MIR.hpp"
+
+#include <map>
+#include <string>
+
+/* 基本块内的窥孔优化:
+ * - reload-removed: 删除紧随 store 之后、读回同一寄存器的 load
+ * - load-forwarded: 将读取刚刚 store 的值的 load 改写为寄存器间 move
+ * - remat-removed: 删除被覆盖前未被使用, 或与寄存器中已有常量重复的
+ *   `addi.w $tX, $zero, imm`
+ */
+class Peephole {
+  public:
+    void run(MachineModule &module);
+    void run(MachineFunction &func);
+
+    // 各模式的命中次数
+    const std::map<std::string, unsigned> &get_counters() const {
+        return counters_;
+    }
+
+  private:
+    void forward_stores(MachineBasicBlock &mbb);
+    void remove_remats(MachineBasicBlock &mbb);
+
+    std::map<std::string, unsigned> counters_{
+        {"reload-removed", 0},
+        {"load-forwarded", 0},
+        {"remat-removed", 0},
+    };
+};
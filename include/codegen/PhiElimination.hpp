@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Function.hpp"
+
+/* SSA 的消除 (phi 的翻译)
+ * phi 被翻译为前驱块末尾的并行拷贝, 由 CodeGen::copy_stmt 串行化。
+ * 若前驱块有多个后继而后继块含 phi (关键边), 拷贝放在前驱块末尾会在走向其他后继时也被执行,
+ * 因此先在这样的边上插入只含一条无条件跳转的新块, 拷贝放在新块中进行。
+ */
+
+// 拆分函数中所有通向含 phi 基本块的关键边
+void split_critical_edges(Function *func);
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "Function.hpp"
+#include "Register.hpp"
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/* 寄存器分配约定:
+ * - $t0-$t2, $t8 与 $ft0-$ft2 保留给 CodeGen 作为临时寄存器, 不参与分配
+ * - $a0-$a7 与 $fa0-$fa7 用于传参与返回值, 不参与分配
+ * - $t3-$t7 与 $ft3-$ft15 为调用者保存寄存器, 跨越 call 的定值不能使用
+ * - $s0-$s8 与 $fs0-$fs7 为被调用者保存寄存器, 使用后需在 prologue 中备份
+ */
+enum class RegAllocKind {
+    stack,  // 所有定值都放在栈上
+    linear, // 线性扫描
+    graph,  // 图着色 (迭代合并)
+};
+
+class RegAlloc {
+  public:
+    virtual ~RegAlloc() = default;
+
+    void run(Function *func);
+
+    // 分配结果, 返回的是寄存器编号
+    const std::unordered_map<Value *, unsigned> &get_greg_map() const {
+        return greg_map_;
+    }
+    const std::unordered_map<Value *, unsigned> &get_freg_map() const {
+        return freg_map_;
+    }
+    // 被使用的被调用者保存寄存器
+    const std::set<unsigned> &get_used_callee_gregs() const {
+        return used_callee_gregs_;
+    }
+    const std::set<unsigned> &get_used_callee_fregs() const {
+        return used_callee_fregs_;
+    }
+    unsigned get_spill_count() const { return spill_count_; }
+    // 溢出后与另一个定值共用栈槽的定值, 它们之间的 phi 拷贝因此可以省去
+    const std::unordered_map<Value *, Value *> &get_spill_alias() const {
+        return spill_alias_;
+    }
+
+    static const std::vector<unsigned> &caller_saved_gregs();
+    static const std::vector<unsigned> &callee_saved_gregs();
+    static const std::vector<unsigned> &caller_saved_fregs();
+    static const std::vector<unsigned> &callee_saved_fregs();
+    static bool is_callee_saved_greg(unsigned id);
+    static bool is_callee_saved_freg(unsigned id);
+
+  protected:
+    // 需要分配的定值: 非 void 指令与函数参数, 与 br 融合的比较除外
+    static bool is_allocatable(Value *val);
+    /* 指令在翻译后实际读取的操作数:
+     * 融合了比较的 br 读取根比较的操作数, 被融合的指令不读取任何操作数 */
+    static std::vector<Value *> get_operands(Instruction *inst);
+    static bool is_float(Value *val) {
+        return val->get_type()->is_float_type();
+    }
+
+    virtual void allocate(Function *func) = 0;
+
+    void compute_liveness(Function *func);
+    void assign(Value *val, unsigned reg);
+
+    /* 线性化: 按基本块在函数中的顺序为指令编号,
+     * 指令 i 在 2i 处使用操作数, 在 2i+1 处产生定值,
+     * phi 的拷贝发生在前驱块终结指令的 2i 处 */
+    std::unordered_map<Instruction *, int> inst_pos_;
+    std::map<BasicBlock *, std::pair<int, int>> bb_range_;
+    std::vector<int> call_pos_;
+
+    // 基本块入口与出口处的活跃定值
+    std::map<BasicBlock *, std::set<Value *>> live_in_;
+    std::map<BasicBlock *, std::set<Value *>> live_out_;
+
+    std::unordered_map<Value *, unsigned> greg_map_;
+    std::unordered_map<Value *, unsigned> freg_map_;
+    std::set<unsigned> used_callee_gregs_;
+    std::set<unsigned> used_callee_fregs_;
+    std::unordered_map<Value *, Value *> spill_alias_;
+    unsigned spill_count_{0};
+};
+
+class LinearScan : public RegAlloc {
+  protected:
+    void allocate(Function *func) override;
+
+  private:
+    struct Interval {
+        Value *val;
+        int start;
+        int end;
+        bool cross_call;
+    };
+
+    void build_intervals(Function *func);
+    void scan(bool is_float);
+    void spill_at_interval(Interval *cur, std::vector<Interval *> &active,
+                           std::map<Interval *, unsigned> &reg_of);
+
+    std::unordered_map<Value *, Interval> intervals_;
+};
+
+/* Chaitin-Briggs 图着色分配, 采用 George-Appel 的迭代寄存器合并:
+ * phi 与其来源之间的拷贝视作 move, 在保守条件下合并以消去 copy_stmt 中的拷贝。
+ * 溢出的定值直接放在栈上, 由 CodeGen 通过临时寄存器访问, 因此无需重写程序。
+ */
+class GraphColoring : public RegAlloc {
+  protected:
+    void allocate(Function *func) override;
+
+  private:
+    enum class NodeState {
+        initial,
+        simplify,
+        freeze,
+        spill,
+        coalesced,
+        colored,
+        spilled,
+        on_stack,
+    };
+    enum class MoveState { worklist, active, coalesced, constrained, frozen };
+
+    void build_graph(Function *func);
+    void add_edge(int u, int v);
+    void color(bool is_float);
+
+    std::vector<int> adjacent(int n) const;
+    std::vector<int> node_moves(int n) const;
+    bool move_related(int n) const { return not node_moves(n).empty(); }
+    unsigned k_of(int n) const;
+    int get_alias(int n) const;
+
+    void make_worklist();
+    void simplify();
+    void decrement_degree(int m);
+    void enable_moves(int n);
+    void coalesce();
+    void add_worklist(int u);
+    bool conservative(const std::vector<int> &nodes, unsigned k) const;
+    void combine(int u, int v);
+    void freeze();
+    void freeze_moves(int u);
+    void select_spill();
+    void assign_colors(bool is_float);
+
+    void set_state(int n, NodeState state);
+    int pop_worklist(NodeState state);
+
+    // 节点按定值顺序编号: 先参数, 后指令
+    std::vector<Value *> nodes_;
+    std::unordered_map<Value *, int> node_id_;
+    std::vector<std::set<int>> adj_;
+    std::vector<unsigned> degree_;
+    std::vector<bool> cross_call_;
+    std::vector<unsigned> spill_cost_;
+    std::vector<std::pair<int, int>> moves_;
+    std::vector<std::vector<int>> move_list_;
+
+    // 以下状态在每个寄存器类着色时重置
+    std::vector<NodeState> node_state_;
+    std::vector<std::set<int>> worklists_;
+    std::vector<MoveState> move_state_;
+    std::set<int> worklist_moves_;
+    std::vector<int> alias_;
+    std::vector<int> select_stack_;
+    std::vector<int> color_;
+};
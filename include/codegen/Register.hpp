@@ -28,7 +28,8 @@ struct Reg {
     unsigned id;
 
     explicit Reg(unsigned i) : id(i) { assert(i <= 31); }
-    bool operator==(const Reg &other) { return id == other.id; }
+    bool operator==(const Reg &other) const { return id == other.id; }
+    bool operator!=(const Reg &other) const { return id != other.id; }
 
     std::string print() const;
 
@@ -57,7 +58,8 @@ struct FReg {
     unsigned id;
 
     explicit FReg(unsigned i) : id(i) { assert(i <= 31); }
-    bool operator==(const FReg &other) { return id == other.id; }
+    bool operator==(const FReg &other) const { return id == other.id; }
+    bool operator!=(const FReg &other) const { return id != other.id; }
 
     std::string print() const;
 
@@ -79,7 +81,7 @@ struct CFReg {
     unsigned id;
 
     explicit CFReg(unsigned i) : id(i) { assert(i <= 7); }
-    bool operator==(const CFReg &other) { return id == other.id; }
+    bool operator==(const CFReg &other) const { return id == other.id; }
 
     std::string print() const { return "$fcc" + std::to_string(id); }
 };
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 工作窃取 (work-stealing) 线程池:
+ * parallel_for 把下标按连续的块分给各线程的任务队列, 线程先从自己队列的头部取任务,
+ * 自己的队列空了再从其他线程队列的尾部窃取, 使各函数大小不均时负载仍然平衡。
+ * 调用 parallel_for 的线程本身作为 0 号线程参与执行。
+ */
+class ThreadPool {
+  public:
+    using Task = std::function<void(std::size_t index, unsigned worker)>;
+
+    // num_threads 包括调用者自己, 为 1 时不创建后台线程
+    explicit ThreadPool(unsigned num_threads);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    unsigned get_num_threads() const { return workers_.size(); }
+
+    /**
+     * @brief 对 [0, n) 中的每个下标执行 task(index, worker), 全部完成后返回
+     *
+     * worker 为执行该任务的线程编号, 小于 get_num_threads(), 可用于索引每线程的状态。
+     * 任务抛出异常时不再开始新的任务, 第一个异常在返回前重新抛出。
+     */
+    void parallel_for(std::size_t n, const Task &task);
+
+  private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void worker_loop(unsigned id);
+    void run_tasks(unsigned id);
+    bool pop_task(unsigned id, std::size_t &index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_; // 1 号及之后的线程
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const Task *task_{nullptr};
+    unsigned generation_{0}; // 每次 parallel_for 加一, 唤醒后台线程
+    unsigned busy_{0};       // 还在执行本轮任务的后台线程数
+    bool stop_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+};
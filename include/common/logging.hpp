@@ -6,6 +6,14 @@
 #include <sstream>
 
 enum LogLevel { DEBUG = 0, INFO, WARNING, ERROR };
+
+/* 编译期的最低日志级别: 低于它的日志语句在编译时被整个去掉。
+ * Release 构建中由 CMake 定义为 INFO, 其他构建默认保留全部级别。
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
 struct LocationInfo {
     LocationInfo(std::string file, int line, const char *func)
         : file_(file), line_(line), func_(func) {}
@@ -18,18 +26,18 @@ struct LocationInfo {
 class LogStream;
 class LogWriter;
 
+// 运行期的日志级别, 由环境变量 LOGV 给出, 只在第一次使用时读取; 未设置时不输出日志
+int env_log_level();
+
+// 该级别的日志是否会输出, 编译期去掉的级别不读取 LOGV
+inline bool log_enabled(LogLevel level) {
+    return level >= LOG_MIN_LEVEL and level >= env_log_level();
+}
+
 class LogWriter {
   public:
     LogWriter(LocationInfo location, LogLevel loglevel)
-        : location_(location), log_level_(loglevel) {
-        char *logv = std::getenv("LOGV");
-        if (logv) {
-            std::string string_logv = logv;
-            env_log_level = std::stoi(logv);
-        } else {
-            env_log_level = 4;
-        }
-    };
+        : location_(location), log_level_(loglevel) {}
 
     void operator<(const LogStream &stream);
 
@@ -37,7 +45,6 @@ class LogWriter {
     void output_log(const std::ostringstream &g);
     LocationInfo location_;
     LogLevel log_level_;
-    int env_log_level;
 };
 
 class LogStream {
@@ -57,9 +64,14 @@ std::string level2string(LogLevel level);
 std::string get_short_name(const char *file_path);
 
 #define __FILESHORTNAME__ get_short_name(__FILE__)
+/* 级别未开启时走条件表达式的空分支, 其后 << 连接的参数都不会求值;
+ * ?: 的优先级低于 < 与 <<, 整条语句仍是一个表达式, 可以安全地用在 if/else 中
+ */
 #define LOG_IF(level)                                                          \
-    LogWriter(LocationInfo(__FILESHORTNAME__, __LINE__, __FUNCTION__),         \
-              level) < LogStream()
+    not log_enabled(level)                                                     \
+        ? (void)0                                                              \
+        : LogWriter(LocationInfo(__FILESHORTNAME__, __LINE__, __FUNCTION__),   \
+                    level) < LogStream()
 #define LOG(level) LOG_##level
 #define LOG_DEBUG LOG_IF(DEBUG)
 #define LOG_INFO LOG_IF(INFO)
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/* Module 持有的 bump 分配器:
+ * IR 结点 (Function, BasicBlock, Instruction, 常量, 全局变量) 与它们的操作数 / use
+ * 数组都从这里按顺序切出, 单个结点不归还内存, Module 析构时整块释放。
+ * allocate 是线程安全的, 多个线程可以同时在不同函数中创建结点。
+ */
+class Arena {
+  public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena();
+
+    void *allocate(std::size_t size, std::size_t align);
+
+    // 统计信息
+    std::size_t get_num_allocations() const { return num_allocations_; }
+    std::size_t get_bytes_allocated() const { return bytes_allocated_; }
+    std::size_t get_num_slabs() const { return slabs_.size(); }
+
+  private:
+    static constexpr std::size_t slab_size = 64 * 1024;
+
+    char *new_slab(std::size_t size);
+
+    std::mutex mutex_;
+    std::vector<char *> slabs_;
+    char *cur_{nullptr};
+    char *end_{nullptr};
+    std::size_t num_allocations_{0};
+    std::size_t bytes_allocated_{0};
+};
+
+// 供标准容器使用的 arena 分配器, deallocate 不做任何事
+template <typename T> class ArenaAllocator {
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena *arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena_) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, std::size_t) {}
+
+    template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+        return arena_ == other.arena_;
+    }
+    template <typename U> bool operator!=(const ArenaAllocator<U> &other) const {
+        return arena_ != other.arena_;
+    }
+
+  private:
+    template <typename U> friend class ArenaAllocator;
+
+    Arena *arena_;
+};
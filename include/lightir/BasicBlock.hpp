@@ -19,7 +19,11 @@ class BasicBlock : public Value, public llvm::ilist_node<BasicBlock> {
     static BasicBlock *create(Module *m, const std::string &name,
                               Function *parent) {
         auto prefix = name.empty() ? "" : "label_";
-        return new BasicBlock(m, prefix + name, parent);
+        return new (m) BasicBlock(m, prefix + name, parent);
+    }
+
+    static bool classof(const Value *v) {
+        return v->get_value_id() == BasicBlockVal;
     }
 
     /****************api about cfg****************/
@@ -8,16 +8,29 @@ class Constant : public User {
   private:
     // int value;
   public:
-    Constant(Type *ty, const std::string &name = "") : User(ty, name) {}
+    Constant(Type *ty, unsigned id, const std::string &name = "")
+        : User(ty, id, name) {}
     ~Constant() = default;
+
+    static bool classof(const Value *v) {
+        return ConstantIntVal <= v->get_value_id() and
+               v->get_value_id() <= ConstantZeroVal;
+    }
 };
 
 class ConstantInt : public Constant {
+    friend class Module;
+
   private:
     int value_;
-    ConstantInt(Type *ty, int val) : Constant(ty, ""), value_(val) {}
+    ConstantInt(Type *ty, int val)
+        : Constant(ty, ConstantIntVal, ""), value_(val) {}
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantIntVal;
+    }
+
     int get_value() { return value_; }
     static ConstantInt *get(int val, Module *m);
     static ConstantInt *get(bool val, Module *m);
@@ -33,6 +46,10 @@ class ConstantArray : public Constant {
   public:
     ~ConstantArray() = default;
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantArrayVal;
+    }
+
     Constant *get_element_value(int index);
 
     unsigned get_size_of_array() { return const_array.size(); }
@@ -44,20 +61,33 @@ class ConstantArray : public Constant {
 };
 
 class ConstantZero : public Constant {
+    friend class Module;
+
   private:
-    ConstantZero(Type *ty) : Constant(ty, "") {}
+    ConstantZero(Type *ty) : Constant(ty, ConstantZeroVal, "") {}
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantZeroVal;
+    }
+
     static ConstantZero *get(Type *ty, Module *m);
     virtual std::string print() override;
 };
 
 class ConstantFP : public Constant {
+    friend class Module;
+
   private:
     float val_;
-    ConstantFP(Type *ty, float val) : Constant(ty, ""), val_(val) {}
+    ConstantFP(Type *ty, float val)
+        : Constant(ty, ConstantFPVal, ""), val_(val) {}
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantFPVal;
+    }
+
     static ConstantFP *get(float val, Module *m);
     float get_value() { return val_; }
     virtual std::string print() override;
@@ -26,6 +26,10 @@ class Function : public Value, public llvm::ilist_node<Function> {
     static Function *create(FunctionType *ty, const std::string &name,
                             Module *parent);
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() == FunctionVal;
+    }
+
     FunctionType *get_function_type() const;
     Type *get_return_type() const;
 
@@ -60,9 +64,13 @@ class Argument : public Value {
     Argument(const Argument &) = delete;
     explicit Argument(Type *ty, const std::string &name = "",
                       Function *f = nullptr, unsigned arg_no = 0)
-        : Value(ty, name), parent_(f), arg_no_(arg_no) {}
+        : Value(ty, ArgumentVal, name), parent_(f), arg_no_(arg_no) {}
     virtual ~Argument() {}
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ArgumentVal;
+    }
+
     inline const Function *get_parent() const { return parent_; }
     inline Function *get_parent() { return parent_; }
 
@@ -17,6 +17,10 @@ class GlobalVariable : public User, public llvm::ilist_node<GlobalVariable> {
     static GlobalVariable *create(std::string name, Module *m, Type *ty,
                                   bool is_const, Constant *init);
     virtual ~GlobalVariable() = default;
+
+    static bool classof(const Value *v) {
+        return v->get_value_id() == GlobalVariableVal;
+    }
     Constant *get_init() { return init_val_; }
     bool is_const() { return is_const_; }
     std::string print();
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 64 位整数的混合函数 (splitmix64 的终结步骤), 使相近的键分散到不同的槽
+inline std::size_t hash_mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<std::size_t>(x);
+}
+
+// 将 value 的哈希值并入 seed, 用于由多个字段组成的键
+inline std::size_t hash_combine(std::size_t seed, std::size_t value) {
+    return hash_mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) +
+                            (seed >> 2)));
+}
+
+// 整数与指针键的默认哈希
+struct HashMix {
+    template <typename T> std::size_t operator()(T *ptr) const {
+        return hash_mix(reinterpret_cast<std::uintptr_t>(ptr));
+    }
+    template <typename T,
+              typename = std::enable_if_t<std::is_integral<T>::value>>
+    std::size_t operator()(T val) const {
+        return hash_mix(static_cast<std::uint64_t>(val));
+    }
+};
+
+/* 开放定址 (线性探测) 的哈希表, 用于 Module 中各类唯一化表:
+ * 所有槽位存放在一块连续的数组中, 查找不需要逐个节点跳转指针。
+ * 表项只增不删, 因此不需要墓碑标记; K 与 V 需要可默认构造。
+ */
+template <typename K, typename V, typename Hash = HashMix> class HashMap {
+  public:
+    explicit HashMap(std::size_t capacity = 16) : slots_(capacity) {
+        assert(capacity != 0 and (capacity & (capacity - 1)) == 0 &&
+               "capacity must be a power of 2");
+    }
+
+    std::size_t size() const { return size_; }
+
+    // 未找到时返回 nullptr
+    V *find(const K &key) {
+        auto &slot = slots_[probe(key)];
+        return slot.used ? &slot.value : nullptr;
+    }
+
+    // 返回 key 对应的值, 不存在时插入一个值初始化的 V
+    V &operator[](const K &key) {
+        auto idx = probe(key);
+        if (not slots_[idx].used) {
+            if ((size_ + 1) * 4 > slots_.size() * 3) {
+                grow();
+                idx = probe(key);
+            }
+            slots_[idx].key = key;
+            slots_[idx].value = V();
+            slots_[idx].used = true;
+            size_++;
+        }
+        return slots_[idx].value;
+    }
+
+  private:
+    struct Slot {
+        K key{};
+        V value{};
+        bool used{false};
+    };
+
+    // 返回 key 所在的槽, 或者探测序列上第一个空槽
+    std::size_t probe(const K &key) const {
+        auto mask = slots_.size() - 1;
+        auto idx = Hash()(key) & mask;
+        while (slots_[idx].used and not(slots_[idx].key == key)) {
+            idx = (idx + 1) & mask;
+        }
+        return idx;
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots_.size() * 2);
+        old.swap(slots_);
+        for (auto &slot : old) {
+            if (slot.used) {
+                slots_[probe(slot.key)] = std::move(slot);
+            }
+        }
+    }
+
+    std::vector<Slot> slots_; // 容量总是 2 的幂
+    std::size_t size_{0};
+};
@@ -4,10 +4,12 @@
 #include "User.hpp"
 
 #include <cstdint>
+#include <tuple>
 #include <llvm/ADT/ilist_node.h>
 
 class BasicBlock;
 class Function;
+class Module;
 
 class Instruction : public User, public llvm::ilist_node<Instruction> {
   public:
@@ -59,6 +61,10 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
     Instruction(const Instruction &) = delete;
     virtual ~Instruction() = default;
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() >= InstructionVal;
+    }
+
     BasicBlock *get_parent() { return parent_; }
     const BasicBlock *get_parent() const { return parent_; }
     void set_parent(BasicBlock *parent) { this->parent_ = parent; }
@@ -109,6 +115,15 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
 
     bool isTerminator() const { return is_br() || is_ret(); }
 
+  protected:
+    // BasicBlock 在此处尚不完整, 供 BaseInst::create 取得分配所用的 Module
+    static Module *module_of(BasicBlock *bb);
+    // 供子类的 classof 使用: 值是否为 [first, last] 之间的指令
+    static bool is_inst_in(const Value *v, OpID first, OpID last) {
+        auto id = v->get_value_id();
+        return InstructionVal + first <= id and id <= InstructionVal + last;
+    }
+
   private:
     OpID op_id_;
     BasicBlock *parent_;
@@ -116,8 +131,11 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
 
 template <typename Inst> class BaseInst : public Instruction {
   protected:
+    // 最后一个参数总是指令所在的基本块, 指令分配在它所属 Module 的 arena 中
     template <typename... Args> static Inst *create(Args &&...args) {
-        return new Inst(std::forward<Args>(args)...);
+        BasicBlock *bb =
+            std::get<sizeof...(Args) - 1>(std::forward_as_tuple(args...));
+        return new (module_of(bb)) Inst(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
@@ -131,6 +149,10 @@ class IBinaryInst : public BaseInst<IBinaryInst> {
     IBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, add, sdiv);
+    }
+
     static IBinaryInst *create_add(Value *v1, Value *v2, BasicBlock *bb);
     static IBinaryInst *create_sub(Value *v1, Value *v2, BasicBlock *bb);
     static IBinaryInst *create_mul(Value *v1, Value *v2, BasicBlock *bb);
@@ -146,6 +168,10 @@ class FBinaryInst : public BaseInst<FBinaryInst> {
     FBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, fadd, fdiv);
+    }
+
     static FBinaryInst *create_fadd(Value *v1, Value *v2, BasicBlock *bb);
     static FBinaryInst *create_fsub(Value *v1, Value *v2, BasicBlock *bb);
     static FBinaryInst *create_fmul(Value *v1, Value *v2, BasicBlock *bb);
@@ -161,6 +187,10 @@ class ICmpInst : public BaseInst<ICmpInst> {
     ICmpInst(OpID id, Value *lhs, Value *rhs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, ge, ne);
+    }
+
     static ICmpInst *create_ge(Value *v1, Value *v2, BasicBlock *bb);
     static ICmpInst *create_gt(Value *v1, Value *v2, BasicBlock *bb);
     static ICmpInst *create_le(Value *v1, Value *v2, BasicBlock *bb);
@@ -178,6 +208,10 @@ class FCmpInst : public BaseInst<FCmpInst> {
     FCmpInst(OpID id, Value *lhs, Value *rhs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, fge, fne);
+    }
+
     static FCmpInst *create_fge(Value *v1, Value *v2, BasicBlock *bb);
     static FCmpInst *create_fgt(Value *v1, Value *v2, BasicBlock *bb);
     static FCmpInst *create_fle(Value *v1, Value *v2, BasicBlock *bb);
@@ -195,9 +229,15 @@ class CallInst : public BaseInst<CallInst> {
     CallInst(Function *func, std::vector<Value *> args, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, call, call);
+    }
+
     static CallInst *create_call(Function *func, std::vector<Value *> args,
                                  BasicBlock *bb);
     FunctionType *get_function_type() const;
+    // 其后紧跟返回其结果 (或返回 void) 的 ret 时为尾调用
+    bool is_tail_call();
 
     virtual std::string print() override;
 };
@@ -211,6 +251,10 @@ class BranchInst : public BaseInst<BranchInst> {
     ~BranchInst();
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, br, br);
+    }
+
     static BranchInst *create_cond_br(Value *cond, BasicBlock *if_true,
                                       BasicBlock *if_false, BasicBlock *bb);
     static BranchInst *create_br(BasicBlock *if_true, BasicBlock *bb);
@@ -229,6 +273,10 @@ class ReturnInst : public BaseInst<ReturnInst> {
     ReturnInst(Value *val, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, ret, ret);
+    }
+
     static ReturnInst *create_ret(Value *val, BasicBlock *bb);
     static ReturnInst *create_void_ret(BasicBlock *bb);
     bool is_void_ret() const;
@@ -243,6 +291,10 @@ class GetElementPtrInst : public BaseInst<GetElementPtrInst> {
     GetElementPtrInst(Value *ptr, std::vector<Value *> idxs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, getelementptr, getelementptr);
+    }
+
     static Type *get_element_type(Value *ptr, std::vector<Value *> idxs);
     static GetElementPtrInst *create_gep(Value *ptr, std::vector<Value *> idxs,
                                          BasicBlock *bb);
@@ -258,6 +310,10 @@ class StoreInst : public BaseInst<StoreInst> {
     StoreInst(Value *val, Value *ptr, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, store, store);
+    }
+
     static StoreInst *create_store(Value *val, Value *ptr, BasicBlock *bb);
 
     Value *get_rval() { return this->get_operand(0); }
@@ -273,6 +329,10 @@ class LoadInst : public BaseInst<LoadInst> {
     LoadInst(Value *ptr, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, load, load);
+    }
+
     static LoadInst *create_load(Value *ptr, BasicBlock *bb);
 
     Value *get_lval() const { return this->get_operand(0); }
@@ -288,6 +348,10 @@ class AllocaInst : public BaseInst<AllocaInst> {
     AllocaInst(Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, alloca, alloca);
+    }
+
     static AllocaInst *create_alloca(Type *ty, BasicBlock *bb);
 
     Type *get_alloca_type() const {
@@ -304,6 +368,10 @@ class ZextInst : public BaseInst<ZextInst> {
     ZextInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, zext, zext);
+    }
+
     static ZextInst *create_zext(Value *val, Type *ty, BasicBlock *bb);
     static ZextInst *create_zext_to_i32(Value *val, BasicBlock *bb);
 
@@ -319,6 +387,10 @@ class FpToSiInst : public BaseInst<FpToSiInst> {
     FpToSiInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, fptosi, fptosi);
+    }
+
     static FpToSiInst *create_fptosi(Value *val, Type *ty, BasicBlock *bb);
     static FpToSiInst *create_fptosi_to_i32(Value *val, BasicBlock *bb);
 
@@ -334,6 +406,10 @@ class SiToFpInst : public BaseInst<SiToFpInst> {
     SiToFpInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, sitofp, sitofp);
+    }
+
     static SiToFpInst *create_sitofp(Value *val, BasicBlock *bb);
 
     Type *get_dest_type() const { return get_type(); };
@@ -349,6 +425,10 @@ class PhiInst : public BaseInst<PhiInst> {
             std::vector<BasicBlock *> val_bbs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return is_inst_in(v, phi, phi);
+    }
+
     static PhiInst *create_phi(Type *ty, BasicBlock *bb,
                                std::vector<Value *> vals = {},
                                std::vector<BasicBlock *> val_bbs = {});
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Arena.hpp"
 #include "Function.hpp"
 #include "GlobalVariable.hpp"
+#include "HashMap.hpp"
 #include "Instruction.hpp"
 #include "Type.hpp"
 #include "Value.hpp"
@@ -9,8 +11,9 @@
 #include <list>
 #include <llvm/ADT/ilist.h>
 #include <llvm/ADT/ilist_node.h>
-#include <map>
+#include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
 
 class GlobalVariable;
@@ -18,7 +21,7 @@ class Function;
 class Module {
   public:
     Module();
-    ~Module() = default;
+    ~Module();
 
     Type *get_void_type();
     Type *get_label_type();
@@ -32,15 +35,26 @@ class Module {
     ArrayType *get_array_type(Type *contained, unsigned num_elements);
     FunctionType *get_function_type(Type *retty, std::vector<Type *> &args);
 
+    // 常量唯一化, 由 ConstantInt::get 等调用
+    ConstantInt *get_int_constant(int val);
+    ConstantInt *get_bool_constant(bool val);
+    ConstantFP *get_float_constant(float val);
+    ConstantZero *get_zero_constant(Type *ty);
+
     void add_function(Function *f);
     llvm::ilist<Function> &get_functions();
     void add_global_variable(GlobalVariable *g);
     llvm::ilist<GlobalVariable> &get_global_variable();
 
+    // IR 结点与操作数数组的分配器
+    Arena &get_arena() { return arena_; }
+
     void set_print_name();
     std::string print();
 
   private:
+    // 最先构造, 最后析构: 其余成员析构时 IR 结点的内存仍然有效
+    Arena arena_;
     // The global variables in the module
     llvm::ilist<GlobalVariable> global_list_;
     // The functions in the module
@@ -51,9 +65,49 @@ class Module {
     std::unique_ptr<Type> label_ty_;
     std::unique_ptr<Type> void_ty_;
     std::unique_ptr<FloatType> float32_ty_;
-    std::map<Type *, std::unique_ptr<PointerType>> pointer_map_;
-    std::map<std::pair<Type *, int>, std::unique_ptr<ArrayType>> array_map_;
-    std::map<std::pair<Type *, std::vector<Type *>>,
-             std::unique_ptr<FunctionType>>
-        function_map_;
+    /* 派生类型的唯一化表: 键的哈希由元素类型预先算好的结构哈希组合而成,
+     * 函数类型的键只引用参数数组, 查找时不必复制 */
+    struct TypeHash {
+        std::size_t operator()(Type *ty) const { return ty->get_hash(); }
+    };
+    struct ArrayTypeKey {
+        Type *contained{nullptr};
+        unsigned num_elements{0};
+        bool operator==(const ArrayTypeKey &other) const {
+            return contained == other.contained and
+                   num_elements == other.num_elements;
+        }
+    };
+    struct ArrayTypeHash {
+        std::size_t operator()(const ArrayTypeKey &key) const {
+            return hash_combine(key.contained->get_hash(), key.num_elements);
+        }
+    };
+    struct FunctionTypeKey {
+        Type *result{nullptr};
+        const std::vector<Type *> *params{nullptr};
+        std::size_t hash{0};
+        bool operator==(const FunctionTypeKey &other) const {
+            return hash == other.hash and result == other.result and
+                   *params == *other.params;
+        }
+    };
+    struct FunctionTypeHash {
+        std::size_t operator()(const FunctionTypeKey &key) const {
+            return key.hash;
+        }
+    };
+
+    // 保护以下唯一化表, 并行处理不同函数时它们会被同时访问
+    std::mutex uniquing_mutex_;
+    std::vector<std::unique_ptr<Type>> derived_types_; // 持有以下表中的类型
+    HashMap<Type *, PointerType *, TypeHash> pointer_map_;
+    HashMap<ArrayTypeKey, ArrayType *, ArrayTypeHash> array_map_;
+    HashMap<FunctionTypeKey, FunctionType *, FunctionTypeHash> function_map_;
+
+    // 本模块的常量表, 随模块一起销毁; float 按位唯一化, 以区分 0.0 与 -0.0
+    HashMap<int, ConstantInt *> int_constants_;
+    ConstantInt *bool_constants_[2]{nullptr, nullptr};
+    HashMap<std::uint32_t, ConstantFP *> float_constants_;
+    HashMap<Type *, ConstantZero *> zero_constants_;
 };
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
+#include <string>
 #include <vector>
 
 class Module;
@@ -43,12 +45,26 @@ class Type {
 
     Module *get_module() const { return m_; }
     unsigned get_size() const;
+    // 结构哈希: 只由类型的结构决定, 供 Module 唯一化类型时使用
+    std::size_t get_hash() const { return hash_; }
 
-    std::string print() const;
+    const std::string &print() const { return name_; }
+
+  protected:
+    /* 类型一经创建便不再改变, 因此在构造的最后一次性算出
+     * 大小, 打印名与结构哈希, 之后的查询都是 O(1) */
+    void cache_layout();
 
   private:
+    unsigned compute_size() const;
+    std::string compute_name() const;
+    std::size_t compute_hash() const;
+
     TypeID tid_;
     Module *m_;
+    unsigned size_{0};
+    std::size_t hash_{0};
+    std::string name_;
 };
 
 class IntegerType : public Type {
@@ -75,6 +91,7 @@ class FunctionType : public Type {
     Type *get_param_type(unsigned i) const;
     std::vector<Type *>::iterator param_begin() { return args_.begin(); }
     std::vector<Type *>::iterator param_end() { return args_.end(); }
+    const std::vector<Type *> &get_params() const { return args_; }
     Type *get_return_type() const;
 
   private:
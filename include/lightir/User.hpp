@@ -1,15 +1,23 @@
 #pragma once
 
+#include "Arena.hpp"
 #include "Value.hpp"
 
 #include <vector>
 
 class User : public Value {
   public:
-    User(Type *ty, const std::string &name = "") : Value(ty, name){};
+    // 操作数与 use 数组分配在 ty 所属 Module 的 arena 中
+    template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    User(Type *ty, unsigned id, const std::string &name = "");
     virtual ~User() { remove_all_operands(); }
 
-    const std::vector<Value *> &get_operands() const { return operands_; }
+    static bool classof(const Value *v) {
+        return v->get_value_id() >= GlobalVariableVal;
+    }
+
+    const ArenaVector<Value *> &get_operands() const { return operands_; }
     unsigned get_num_operand() const { return operands_.size(); }
 
     // start from 0
@@ -22,20 +30,10 @@ class User : public Value {
     void remove_operand(unsigned i);
 
   private:
-    std::vector<Value *> operands_; // operands of this value
-};
+    /* 移动 use 结点会改写它在链表中的邻居, 结点挂在共享值 (见 Value::is_shared)
+     * 的链表上时需要持有 Value::shared_use_mutex() */
+    bool has_shared_operand() const;
 
-/* For example: op = func(a, b)
- *  for a: Use(op, 0)
- *  for b: Use(op, 1)
- */
-struct Use {
-    User *val_;       // used by whom
-    unsigned arg_no_; // the no. of operand
-
-    Use(User *val, unsigned no) : val_(val), arg_no_(no) {}
-
-    bool operator==(const Use &other) const {
-        return val_ == other.val_ and arg_no_ == other.arg_no_;
-    }
+    ArenaVector<Value *> operands_; // operands of this value
+    ArenaVector<Use> uses_;         // 与 operands_ 一一对应的 use 结点
 };
@@ -1,60 +1,210 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <iostream>
-#include <list>
+#include <mutex>
 #include <string>
 #include <cassert>
 
+class Module;
 class Type;
 class Value;
 class User;
-struct Use;
+
+/* For example: op = func(a, b)
+ *  for a: Use(op, 0)
+ *  for b: Use(op, 1)
+ * Use 由 User 的操作数数组持有, 同时作为侵入式双向循环链表的结点挂在被使用的 Value 上,
+ * 因此增删操作数都只需 O(1) 地摘下或挂上结点, 链表保持使用被加入的顺序。
+ * 操作数数组扩容或移动元素时, 由移动构造与移动赋值把链表中的指针改为指向新位置。
+ */
+struct Use {
+    User *val_;       // used by whom
+    unsigned arg_no_; // the no. of operand
+
+    Use(User *val, unsigned no) : val_(val), arg_no_(no) {}
+    Use(const Use &) = delete;
+    Use(Use &&other) noexcept : val_(other.val_), arg_no_(other.arg_no_) {
+        take_links(other);
+    }
+    Use &operator=(Use &&other) noexcept {
+        assert(not is_linked() && "overwriting a linked use");
+        val_ = other.val_;
+        arg_no_ = other.arg_no_;
+        take_links(other);
+        return *this;
+    }
+
+    bool operator==(const Use &other) const {
+        return val_ == other.val_ and arg_no_ == other.arg_no_;
+    }
+
+    Use *get_next() const { return next_; }
+
+  private:
+    friend class Value;
+
+    bool is_linked() const { return next_ != nullptr; }
+    void take_links(Use &other) {
+        next_ = other.next_;
+        prev_ = other.prev_;
+        if (next_ != nullptr) {
+            prev_->next_ = this;
+            next_->prev_ = this;
+        }
+        other.next_ = nullptr;
+        other.prev_ = nullptr;
+    }
+
+    Use *prev_{nullptr};
+    Use *next_{nullptr};
+};
+
+// Value 的使用者链表的只读视图
+class UseList {
+  public:
+    class iterator {
+      public:
+        explicit iterator(Use *use) : use_(use) {}
+        Use &operator*() const { return *use_; }
+        Use *operator->() const { return use_; }
+        iterator &operator++() {
+            use_ = use_->get_next();
+            return *this;
+        }
+        bool operator==(const iterator &other) const {
+            return use_ == other.use_;
+        }
+        bool operator!=(const iterator &other) const {
+            return use_ != other.use_;
+        }
+
+      private:
+        Use *use_;
+    };
+
+    UseList(Use *first, Use *last, unsigned size)
+        : first_(first), last_(last), size_(size) {}
+
+    iterator begin() const { return iterator(first_); }
+    iterator end() const { return iterator(last_); }
+    unsigned size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    Use &front() const { return *first_; }
+
+  private:
+    Use *first_;
+    Use *last_; // 链表的哨兵结点
+    unsigned size_;
+};
 
 class Value {
   public:
-    explicit Value(Type *ty, const std::string &name = "")
-        : type_(ty), name_(name){};
+    /* 值的种类, 由各子类的 classof 判断, 使 is<>/as<>/dyn_cast<> 只需比较整数
+     * 常量与指令各占一段连续的编号, 指令的编号为 InstructionVal + Instruction::OpID */
+    enum ValueID : unsigned {
+        ArgumentVal,
+        BasicBlockVal,
+        FunctionVal,
+        // User
+        GlobalVariableVal,
+        // Constant
+        ConstantIntVal,
+        ConstantFPVal,
+        ConstantArrayVal,
+        ConstantZeroVal,
+        // Instruction
+        InstructionVal,
+    };
+
+    explicit Value(Type *ty, unsigned id, const std::string &name = "")
+        : type_(ty), value_id_(id),
+          creation_index_(next_creation_index()), name_(name) {
+        uses_.prev_ = uses_.next_ = &uses_;
+    }
     virtual ~Value() { replace_all_use_with(nullptr); }
 
+    /* IR 结点只能在所属 Module 的 arena 中创建: new (m) T(...)
+     * delete 只运行析构函数, 内存在 Module 析构时随 arena 一并释放 */
+    static void *operator new(std::size_t size, Module *m);
+    static void operator delete(void *, Module *) {}
+    static void operator delete(void *) {}
+
+    unsigned get_value_id() const { return value_id_; }
+    // 创建序号, 越晚创建的值越大, 见 CreationOrder
+    unsigned get_creation_index() const { return creation_index_; }
+    static bool classof(const Value *) { return true; }
+
     std::string get_name() const { return name_; };
     Type *get_type() const { return type_; }
-    const std::list<Use> &get_use_list() const { return use_list_; }
+    UseList get_use_list() const {
+        return UseList(uses_.next_, const_cast<Use *>(&uses_), num_uses_);
+    }
 
     bool set_name(std::string name);
 
-    void add_use(User *user, unsigned arg_no);
-    void remove_use(User *user, unsigned arg_no);
+    // 由 User 在设置操作数时调用, 挂上或摘下其操作数数组中的结点
+    void add_use(Use &use);
+    void remove_use(Use &use);
+
+    /* Function, 全局变量与常量可以被多个函数中的指令使用, 多个线程同时处理不同函数时,
+     * 它们的使用者链表由 shared_use_mutex() 保护; 其余的值只在所属函数内被使用 */
+    bool is_shared() const {
+        return value_id_ == FunctionVal or
+               (value_id_ >= GlobalVariableVal and value_id_ < InstructionVal);
+    }
+    static std::mutex &shared_use_mutex();
 
     void replace_all_use_with(Value *new_val);
     void replace_use_with_if(Value *new_val, std::function<bool(Use *)> pred);
 
     virtual std::string print() = 0;
 
+    // is 接口
+    template <typename T>
+    [[nodiscard]] bool is() const {
+        static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
+        return T::classof(this);
+    }
+    // as 接口, 类型不符时断言失败
     template<typename T>
     T *as()
     {
-      static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-      const auto ptr = dynamic_cast<T*>(this);
-      assert(ptr && "dynamic_cast failed");
-      return ptr;
+      assert(is<T>() && "as<T>() on a value of another kind");
+      return static_cast<T*>(this);
     }
     template<typename T>
     [[nodiscard]] const T* as() const {
-        static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-        const auto ptr = dynamic_cast<const T*>(this);
-        assert(ptr);
-        return ptr;
+        assert(is<T>() && "as<T>() on a value of another kind");
+        return static_cast<const T*>(this);
     }
-    // is 接口
+    // dyn_cast 接口, 类型不符时返回 nullptr
     template <typename T>
-    [[nodiscard]] bool is() const {
-        static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-        return dynamic_cast<const T*>(this);
+    T *dyn_cast() {
+        return is<T>() ? static_cast<T *>(this) : nullptr;
+    }
+    template <typename T>
+    [[nodiscard]] const T *dyn_cast() const {
+        return is<T>() ? static_cast<const T *>(this) : nullptr;
     }
 
   private:
+    static unsigned next_creation_index();
+
     Type *type_;
-    std::list<Use> use_list_; // who use this value
+    unsigned value_id_;
+    unsigned creation_index_;
+    Use uses_{nullptr, 0}; // who use this value, 使用者链表的哨兵结点
+    unsigned num_uses_{0};
     std::string name_;        // should we put name field here ?
 };
+
+/* 以 Value 指针为键的有序容器的比较器, 按创建顺序而不是地址排序:
+ * 同一函数中的值总以相同的顺序创建, 所以遍历顺序在每次运行中都相同,
+ * 多个线程同时处理不同函数时 (各函数的结点在 arena 中交错分配) 也是如此 */
+struct CreationOrder {
+    bool operator()(const Value *lhs, const Value *rhs) const {
+        return lhs->get_creation_index() < rhs->get_creation_index();
+    }
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Value.hpp"
+
+/**
+ * GVN 与 LICM 共用的简单别名分析。
+ * cminus 中没有指针运算与类型转换, 地址都是 alloca, 全局变量, 数组参数
+ * (或从中 load 出的数组指针) 经过若干 GEP 得到的。
+ */
+
+// 地址所指向的对象: 沿 GEP 找到最初的指针 (alloca, 全局变量, 参数或 load 得到的数组指针)
+Value *get_base(Value *ptr);
+
+// alloca 与全局变量: 不同的这类对象互不重叠
+bool is_identified_object(Value *base);
+
+/**
+ * 两个地址是否可能指向同一位置:
+ * 类型不同的地址不会重叠;
+ * 不同的 alloca 或全局变量互不重叠, 由参数传入的数组指针也不会指向本函数的 alloca;
+ * 同一对象上下标都是常量且不同的两个 GEP 不重叠。
+ */
+bool may_alias(Value *ptr1, Value *ptr2);
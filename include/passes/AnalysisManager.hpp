@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "LoopDetection.hpp"
+#include "PassManager.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * 分析结果的缓存:
+ * Pass 通过 get_* 按需获取分析, 结果在首次请求时计算, 之后一直复用,
+ * 直到某个 Pass 运行后没有声明保留它 (见 PreservedAnalyses) 才被丢弃。
+ * 支配树与循环按函数缓存, 只有被请求的函数才会计算。
+ * 多个线程可以同时请求不同函数的分析; invalidate 只在 Pass 之间调用。
+ */
+class AnalysisManager {
+  public:
+    explicit AnalysisManager(Module *m) : m_(m) {}
+
+    Dominators &get_dominators(Function *func);
+    LoopDetection &get_loops(Function *func);
+    FuncInfo &get_func_info();
+
+    // 丢弃 pa 中没有保留的分析
+    void invalidate(const PreservedAnalyses &pa);
+
+    // 各分析实际计算的次数
+    unsigned get_compute_count(AnalysisID id) const {
+        return compute_count_[static_cast<unsigned>(id)];
+    }
+
+  private:
+    // 取得 func 在 cache 中的槽位, 槽位的地址在表扩容时保持不变
+    template <typename T>
+    std::unique_ptr<T> &
+    get_slot(std::unordered_map<Function *, std::unique_ptr<T>> &cache,
+             Function *func) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cache[func];
+    }
+
+    Module *m_;
+    std::mutex mutex_;
+    std::unordered_map<Function *, std::unique_ptr<Dominators>> dominators_;
+    std::unordered_map<Function *, std::unique_ptr<LoopDetection>> loops_;
+    std::unique_ptr<FuncInfo> func_info_;
+    std::atomic<unsigned> compute_count_[3]{0, 0, 0};
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+// 原值 -> 副本, 不在表中的值 (常量, 全局变量, 被复制区域之外定义的值) 在副本中保持不变
+using ValueMap = std::unordered_map<Value *, Value *>;
+
+inline Value *map_value(const ValueMap &value_map, Value *val) {
+    auto it = value_map.find(val);
+    return it == value_map.end() ? val : it->second;
+}
+
+// 在 bb 末尾创建与 inst 相同的指令, 操作数仍为原来的值; 不处理 phi, br 与 ret
+Instruction *clone_instruction(Instruction *inst, BasicBlock *bb);
+
+/**
+ * 把 blocks 复制到 func 末尾, 返回按原顺序排列的新块。
+ * value_map 中预先放入的对应关系 (例如形参 -> 实参) 在副本中生效, 复制出的块与指令也加入其中。
+ * 副本中的跳转指向被复制的块时改为指向其副本, 否则不变;
+ * phi 的来源值与来源块同样映射, 调用者负责补全或删除来自区域之外的来源。
+ * ret 的返回类型属于原函数, 不复制: 以 ret 结尾的块的副本没有终结指令, 由调用者补上。
+ */
+std::vector<BasicBlock *> clone_blocks(const std::vector<BasicBlock *> &blocks,
+                                       Function *func, ValueMap &value_map);
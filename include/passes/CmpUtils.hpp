@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Instruction.hpp"
+
+// IndexCheckElim 与 LoopUnroll 共用的整数比较辅助函数
+
+// !(a op b) 对应的比较
+Instruction::OpID negate_cmp(Instruction::OpID op);
+
+// a op b 等价于 b swap_cmp(op) a
+Instruction::OpID swap_cmp(Instruction::OpID op);
+
+/**
+ * 条件分支 br 跳向 true 目标 (to_true) 或 false 目标时成立的整数比较 lhs op rhs。
+ * builder 生成的条件形如 icmp ne (zext (icmp lhs, rhs)), 0, 这里还原出里面的比较。
+ * 条件不是整数比较时返回 false。
+ */
+bool get_branch_cmp(BranchInst *br, bool to_true, Value *&lhs,
+                    Instruction::OpID &op, Value *&rhs);
@@ -9,15 +9,30 @@
  * 死代码消除：参见
  *https://www.clear.rice.edu/comp512/Lectures/10Dead-Clean-SCCP.pdf
  **/
-class DeadCode : public Pass {
+class DeadCode : public FunctionPass {
   public:
-    DeadCode(Module *m) : Pass(m), func_info(std::make_shared<FuncInfo>(m)) {}
+    DeadCode(Module *m) : FunctionPass(m) {}
 
-    void run();
+    std::string get_name() const override { return "dead-code"; }
+    void initialize() override;
+    // 在函数内反复删除不可达块与无用指令, 直到不再变化
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override;
+    Statistics get_statistics() const override {
+        return {{"erased_instructions", ins_count}};
+    }
+    /* 只删除了指令时控制流不变; 删除的调用与 store 可能让函数变纯,
+     * 因此 FuncInfo 总是失效 */
+    PreservedAnalyses get_preserved() const override {
+        if (erased_blocks_)
+            return PreservedAnalyses::none();
+        return ins_count ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
 
   private:
-    std::shared_ptr<FuncInfo> func_info;
+    FuncInfo *func_info{nullptr};
     int ins_count{0}; // 用以衡量死代码消除的性能
+    bool erased_blocks_{false};
     std::deque<Instruction *> work_list{};
     std::unordered_map<Instruction *, bool> marked{};
 
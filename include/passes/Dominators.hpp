@@ -4,15 +4,18 @@
 #include "PassManager.hpp"
 
 #include <map>
+#include <ostream>
 #include <set>
 
 class Dominators : public Pass {
   public:
-    using BBSet = std::set<BasicBlock *>;
+    // 按创建顺序遍历, 使依赖遍历顺序的变换 (如插入 phi) 结果确定
+    using BBSet = std::set<BasicBlock *, CreationOrder>;
 
     explicit Dominators(Module *m) : Pass(m) {}
     ~Dominators() = default;
     void run() override;
+    std::string get_name() const override { return "dominators"; }
     void run_on_func(Function *f);
 
     // functions for getting information
@@ -24,14 +27,18 @@ class Dominators : public Pass {
         return dom_tree_succ_blocks_.at(bb);
     }
 
-    // print cfg or dominance tree
-    void dump_cfg(Function *f);
-    void dump_dominator_tree(Function *f);
+    // 以 DOT 格式输出控制流图或支配树, 只写文本 (见 GraphDump)
+    static void dump_cfg(Function *f, std::ostream &os);
+    void dump_dominator_tree(Function *f, std::ostream &os);
 
     // functions for dominance tree
+    // 从入口不可达的块不在支配树中, 视为不被任何块支配
     const bool is_dominate(BasicBlock *bb1, BasicBlock *bb2) {
-        return dom_tree_L_.at(bb1) <= dom_tree_L_.at(bb2) &&
-               dom_tree_R_.at(bb1) >= dom_tree_L_.at(bb2);
+        auto l1 = dom_tree_L_.find(bb1), l2 = dom_tree_L_.find(bb2);
+        if (l1 == dom_tree_L_.end() or l2 == dom_tree_L_.end())
+            return false;
+        return l1->second <= l2->second &&
+               dom_tree_R_.at(bb1) >= l2->second;
     }
 
     const std::vector<BasicBlock *> &get_dom_dfs_order() {
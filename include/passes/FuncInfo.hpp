@@ -16,6 +16,7 @@ class FuncInfo : public Pass {
     FuncInfo(Module *m) : Pass(m) {}
 
     void run();
+    std::string get_name() const override { return "func-info"; }
 
     bool is_pure_function(Function *func) const { return is_pure.at(func); }
 
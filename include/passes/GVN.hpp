@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 基于支配树作用域的全局值编号 (公共子表达式消除):
+ * 按支配树先序遍历基本块, 把无副作用的指令 (算术, 比较, GEP, 类型转换, 纯函数调用)
+ * 按 (操作码, 类型, 操作数) 编号, 与支配它的某条指令编号相同时用那条指令代替。
+ * 离开支配树的子树时撤销其中加入的编号, 因此代替者总是支配被代替的指令。
+ *
+ * 冗余 load 消除: 记录每个地址上已知的值 (之前的 load 或 store), 之后从同一地址的 load
+ * 直接使用该值; 可能写到该地址的 store 与非纯函数调用使记录失效。
+ * 只有唯一前驱为其直接支配者的块继承支配者结束时的记录, 其余的块从空记录开始。
+ */
+class GVN : public FunctionPass {
+  public:
+    GVN(Module *m) : FunctionPass(m) {}
+
+    std::string get_name() const override { return "gvn"; }
+    void initialize() override;
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override;
+    Statistics get_statistics() const override {
+        return {{"eliminated_expressions", eliminated_},
+                {"eliminated_loads", loads_}};
+    }
+    // 只删除指令, 不改变控制流
+    PreservedAnalyses get_preserved() const override {
+        return eliminated_ or loads_ ? PreservedAnalyses::cfg()
+                                     : PreservedAnalyses::all();
+    }
+
+  private:
+    // 指令的编号: 交换律运算的操作数按创建顺序排列, a > b 统一为 b < a
+    struct Expression {
+        Instruction::OpID op;
+        Type *type;
+        std::vector<Value *> operands;
+
+        bool operator==(const Expression &other) const {
+            return op == other.op and type == other.type and
+                   operands == other.operands;
+        }
+    };
+    struct ExpressionHash {
+        std::size_t operator()(const Expression &expr) const;
+    };
+    // 地址 -> 该地址上已知的值
+    using AvailableLoads = std::unordered_map<Value *, Value *>;
+
+    void visit(BasicBlock *bb, const AvailableLoads &parent_loads);
+    bool is_numbered(Instruction *inst);
+    Expression get_expression(Instruction *inst);
+    // 用 leader 代替 inst, inst 在遍历结束后删除
+    void replace(Instruction *inst, Value *leader);
+
+    // 存储与 load 的地址分析
+    void compute_escaped_allocas(Function *func);
+    void kill_aliasing(AvailableLoads &loads, Value *ptr);
+    void kill_on_call(AvailableLoads &loads);
+
+    FuncInfo *func_info_{nullptr};
+    Dominators *dominators_{nullptr};
+    std::unordered_map<Expression, Instruction *, ExpressionHash> table_;
+    std::unordered_set<Value *> escaped_allocas_;
+    std::vector<Instruction *> wait_delete_;
+
+    int eliminated_{0}; // 消除的冗余计算
+    int loads_{0};      // 消除的冗余 load
+};
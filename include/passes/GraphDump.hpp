@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <filesystem>
+
+/**
+ * 诊断用的图输出 (-dump-cfg=<dir> / -dump-domtree):
+ * 把模块中每个函数的控制流图 / 支配树以 graphviz 的 DOT 文本写入 dir,
+ * 文件名为 <函数名>_cfg.dot 与 <函数名>_dom_tree.dot, 需要图片时自行调用 dot 转换。
+ * 默认不开启, 分析本身不做任何 I/O。
+ */
+struct GraphDumpOptions {
+    std::filesystem::path dir{"."};
+    bool cfg{false};
+    bool domtree{false};
+
+    bool enabled() const { return cfg or domtree; }
+};
+
+// 按 options 输出 m 中各函数的图, 目录无法创建或文件无法写入时返回 false
+bool dump_graphs(Module *m, const GraphDumpOptions &options);
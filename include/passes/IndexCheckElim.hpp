@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "LoopDetection.hpp"
+#include "PassManager.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 数组负下标检查消除:
+ * CminusfBuilder 在每次数组访问前生成 icmp slt idx, 0 并在为真时跳转到调用
+ * neg_idx_except 的块。本 Pass 用区间分析证明 idx 非负, 把这类分支改为直接跳到访问所在的块,
+ * 并删除不再可达的异常块。区间的来源有:
+ *   - 常量与 add/sub/mul/sdiv 等运算 (结果可能溢出时放弃);
+ *   - 循环归纳变量: 循环头的 phi, 入口值非负, 每次经回边加上一个正常数,
+ *     且由循环条件保证加法不溢出;
+ *   - 支配当前块的条件分支 (循环条件, if 条件以及之前的下标检查) 给出的大小关系。
+ */
+class IndexCheckElim : public FunctionPass {
+  public:
+    IndexCheckElim(Module *m) : FunctionPass(m) {}
+
+    std::string get_name() const override { return "index-check-elim"; }
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override;
+    Statistics get_statistics() const override {
+        return {{"eliminated_checks", eliminated_}};
+    }
+    PreservedAnalyses get_preserved() const override {
+        return eliminated_ ? PreservedAnalyses::none()
+                           : PreservedAnalyses::all();
+    }
+
+  private:
+    // 有符号 32 位整数的取值范围 [lo, hi], 用 64 位计算以判断溢出
+    struct Range {
+        int64_t lo;
+        int64_t hi;
+
+        static Range full() { return {INT32_MIN, INT32_MAX}; }
+        bool fits() const { return lo >= INT32_MIN and hi <= INT32_MAX; }
+    };
+    // 在当前位置成立的关系: value op other, op 为整数比较
+    struct Fact {
+        Instruction::OpID op;
+        Value *other;
+    };
+
+    void visit(BasicBlock *bb);
+    // 从 pre 跳到 bb 时成立的关系, 只有 bb 的唯一前驱为条件分支时才有
+    void collect_edge_facts(BasicBlock *bb, std::vector<Value *> &added);
+    void add_fact(Value *val, Instruction::OpID op, Value *other,
+                  std::vector<Value *> &added);
+
+    /* use_facts 为真时使用支配当前块的分支给出的关系;
+     * phi 的来源值在另外的位置取得, 总是不使用这些关系 */
+    Range get_range(Value *val, bool use_facts, int depth = 0);
+    Range compute_range(Value *val, bool use_facts, int depth);
+    Range induction_range(PhiInst *phi, Loop *loop);
+    Range apply_facts(Value *val, Range range);
+    // 从 bb 沿支配树向上到 stop 为止, 由分支条件得出的 val 的上界
+    int64_t upper_bound_at(Value *val, BasicBlock *bb, BasicBlock *stop);
+
+    void eliminate(BranchInst *br);
+    void remove_unreachable_blocks(Function *func);
+
+    Dominators *dominators_{nullptr};
+    std::unordered_map<BasicBlock *, Loop *> header_loop_;
+    std::unordered_map<Value *, std::vector<Fact>> facts_;
+    std::unordered_map<Value *, Range> range_cache_; // 不使用关系时的结果
+    std::unordered_set<Value *> visiting_;
+    std::vector<BranchInst *> redundant_checks_;
+
+    int eliminated_{0}; // 消除的下标检查数
+};
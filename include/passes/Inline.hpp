@@ -0,0 +1,49 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 函数内联: 把被调用函数的基本块复制到调用处。
+ * 调用所在的块在 call 之后被拆开, 形参替换为实参, 被调用者的 alloca 移入调用者的入口块,
+ * 每个 ret 改为跳到拆出的后半部分, 多个返回值在那里用 phi 合并。
+ *
+ * 按调用图的强连通分量自底向上处理, 被调用者先完成自身的内联;
+ * 同一强连通分量中的函数 (直接或间接递归) 不被内联。
+ * 被调用者的指令数 (不计 alloca) 不超过阈值时内联, 调用处每处于一层循环阈值增加一倍,
+ * 调用者的规模超过上限后不再内联。
+ */
+class Inliner : public Pass {
+  public:
+    Inliner(Module *m, unsigned threshold) : Pass(m), threshold_(threshold) {}
+
+    std::string get_name() const override { return "inline"; }
+    Statistics get_statistics() const override {
+        return {{"inlined_call_sites", inlined_}};
+    }
+    void run() override;
+    PreservedAnalyses get_preserved() const override {
+        return inlined_ ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+  private:
+    void build_call_graph();
+    void find_sccs(Function *func);
+    void run_on_caller(Function *caller);
+    bool is_inlinable(Function *caller, Function *callee);
+    void inline_call(CallInst *call);
+
+    unsigned threshold_;
+    std::unordered_map<Function *, std::vector<Function *>> callees_;
+    std::unordered_set<Function *> recursive_;
+    // Tarjan 算法的状态, 强连通分量按逆拓扑序 (被调用者在前) 放入 bottom_up_
+    std::unordered_map<Function *, unsigned> index_, low_;
+    std::vector<Function *> stack_;
+    std::unordered_set<Function *> on_stack_;
+    std::vector<Function *> bottom_up_;
+
+    int inlined_{0}; // 内联的调用处数
+};
@@ -4,21 +4,27 @@
 #include <memory>
 #include <unordered_map>
 
-class LoopInvariantCodeMotion : public Pass {
+class LoopInvariantCodeMotion : public FunctionPass {
   public:
-    LoopInvariantCodeMotion(Module *m) : Pass(m) {}
+    LoopInvariantCodeMotion(Module *m) : FunctionPass(m) {}
     ~LoopInvariantCodeMotion() = default;
 
-    void run() override;
+    std::string get_name() const override { return "licm"; }
+    void initialize() override;
+    void run_on_function(Function *func) override;
+    // 会插入 preheader, 只有纯函数信息不受影响
+    PreservedAnalyses get_preserved() const override {
+        return PreservedAnalyses::none().preserve(AnalysisID::func_info);
+    }
 
   private:
     std::unordered_map<std::shared_ptr<Loop>, bool> is_loop_done_;
-    std::unique_ptr<LoopDetection> loop_detection_;
-    std::unique_ptr<FuncInfo> func_info_;
+    FuncInfo *func_info_{nullptr};
+    Dominators *dominators_{nullptr};
     void traverse_loop(std::shared_ptr<Loop> loop);
     void run_on_loop(std::shared_ptr<Loop> loop);
     void collect_loop_info(std::shared_ptr<Loop> loop,
-                          std::set<Value *> &loop_instructions,
-                          std::set<Value *> &updated_global,
+                          std::set<Value *, CreationOrder> &loop_instructions,
+                          std::set<Value *> &stored_ptrs,
                           bool &contains_impure_call);
 };
\ No newline at end of file
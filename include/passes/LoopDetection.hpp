@@ -11,7 +11,7 @@ class Dominators;
 class Function;
 class Module;
 
-using BBset = std::set<BasicBlock *>;
+using BBset = std::set<BasicBlock *, CreationOrder>;
 using BBvec = std::vector<BasicBlock *>;
 class Loop {
   private:
@@ -46,7 +46,7 @@ class Loop {
 class LoopDetection : public Pass {
   private:
     Function *func_;
-    std::unique_ptr<Dominators> dominators_;
+    Dominators *dominators_{nullptr};
     std::vector<std::shared_ptr<Loop>> loops_;
     // map from header to loop
     std::unordered_map<BasicBlock *, std::shared_ptr<Loop>> bb_to_loop_;
@@ -58,7 +58,8 @@ class LoopDetection : public Pass {
     ~LoopDetection() = default;
 
     void run() override;
-    void run_on_func(Function *f);
+    std::string get_name() const override { return "loop-detection"; }
+    void run_on_func(Function *f, Dominators &dominators);
     void print() ;
     std::vector<std::shared_ptr<Loop>> &get_loops() { return loops_; }
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Cloning.hpp"
+#include "Dominators.hpp"
+#include "LoopDetection.hpp"
+#include "PassManager.hpp"
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 循环展开, 只处理最内层的计数循环:
+ *   循环头的 phi i 为归纳变量, 经唯一的回边流入 i + c (c 为非零常数),
+ *   循环头以 i < n (或 <=, >, >=, 与 c 的符号一致, n 在循环外定义) 决定进入循环体还是离开循环。
+ * 循环体中的其他出口 (负下标异常后的 return) 不能有 phi;
+ * 循环外对循环内定义的值的使用只能位于循环头的出口之后。
+ *
+ * 完全展开: 初值与 n 都是常数且迭代次数较少时, 依次复制各次迭代, 去掉循环条件与回边。
+ * 部分展开: 把 factor 份循环体串成新的循环, 每轮开头只判断一次剩余的迭代是否还有 factor 次,
+ *   不足时进入原来的循环执行余下的迭代。
+ * 副本中不再使用的比较由之后的 DeadCode 删除。
+ */
+class LoopUnroll : public FunctionPass {
+  public:
+    LoopUnroll(Module *m, unsigned factor) : FunctionPass(m), factor_(factor) {}
+
+    std::string get_name() const override { return "loop-unroll"; }
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override;
+    Statistics get_statistics() const override {
+        return {{"fully_unrolled_loops", full_},
+                {"partially_unrolled_loops", partial_}};
+    }
+    PreservedAnalyses get_preserved() const override {
+        return full_ or partial_ ? PreservedAnalyses::none()
+                                 : PreservedAnalyses::all();
+    }
+
+  private:
+    struct CountedLoop {
+        BasicBlock *preheader; // 循环头在循环外的唯一前驱
+        BasicBlock *header;
+        BasicBlock *latch;
+        BasicBlock *body; // 循环头在循环内的后继
+        BasicBlock *exit; // 循环头在循环外的后继
+        std::vector<BasicBlock *> blocks; // 按在函数中的顺序, 循环头在最前
+        std::unordered_set<BasicBlock *> block_set;
+        std::vector<PhiInst *> phis;    // 循环头的 phi
+        std::vector<Value *> init_vals; // 来自 preheader 的值
+        std::vector<Value *> next_vals; // 来自 latch 的值
+        unsigned iv;                    // 归纳变量在 phis 中的下标
+        int step;
+        Instruction::OpID pred; // 继续循环的条件: iv pred bound
+        Value *bound;
+        unsigned size; // 指令数
+    };
+
+    bool analyze(Loop *loop, CountedLoop &cl);
+    bool check_outside_uses(const CountedLoop &cl);
+    // 迭代次数, 不是常数或超过完全展开的上限时为 -1
+    int64_t get_trip_count(const CountedLoop &cl);
+
+    /* 复制一次迭代, 循环头的 phi 取 phi_vals 中的值, 循环头副本直接跳到循环体副本;
+     * header_only 时只复制循环头, 副本跳到出口 */
+    ValueMap clone_iteration(const CountedLoop &cl,
+                             const std::vector<Value *> &phi_vals,
+                             bool header_only);
+    void full_unroll(const CountedLoop &cl, unsigned trip_count);
+    bool partial_unroll(const CountedLoop &cl, unsigned factor);
+
+    unsigned factor_;
+    Dominators *dominators_{nullptr};
+    std::vector<BasicBlock *> new_blocks_; // 本次展开新建的块, 按创建顺序
+
+    int full_{0};    // 完全展开的循环数
+    int partial_{0}; // 部分展开的循环数
+};
@@ -8,10 +8,10 @@
 #include <memory>
 #include <stack>
 
-class Mem2Reg : public Pass {
+class Mem2Reg : public FunctionPass {
   private:
     Function *func_;
-    std::unique_ptr<Dominators> dominators_;
+    Dominators *dominators_{nullptr};
     std::map<Value *, Value *> phi_map;
     // TODO 添加需要的变量
 
@@ -23,20 +23,25 @@ class Mem2Reg : public Pass {
     std::vector<Value *> wait_delete_val;
 
   public:
-    Mem2Reg(Module *m) : Pass(m) {}
+    Mem2Reg(Module *m) : FunctionPass(m) {}
     ~Mem2Reg() = default;
 
-    void run() override;
+    std::string get_name() const override { return "mem2reg"; }
+    void run_on_function(Function *func) override;
+    // 只插入 phi, 删除 load/store, 不改变控制流
+    PreservedAnalyses get_preserved() const override {
+        return PreservedAnalyses::cfg();
+    }
 
     void generate_phi();
     void rename(BasicBlock *bb);
     void erase();
 
     static inline bool is_global_variable(Value *l_val) {
-        return dynamic_cast<GlobalVariable *>(l_val) != nullptr;
+        return l_val->is<GlobalVariable>();
     }
     static inline bool is_gep_instr(Value *l_val) {
-        return dynamic_cast<GetElementPtrInst *>(l_val) != nullptr;
+        return l_val->is<GetElementPtrInst>();
     }
 
     static inline bool is_valid_ptr(Value *l_val) {
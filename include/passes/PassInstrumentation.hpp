@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 模块中 IR 的规模
+struct IRCounts {
+    unsigned instructions{0};
+    unsigned blocks{0};
+    unsigned phis{0};
+    unsigned loads{0};
+    unsigned stores{0};
+
+    static IRCounts of(Module *m);
+};
+
+/**
+ * 编译各阶段的耗时与 IR 统计 (-time-passes / -stats):
+ * 用 start/stop 括住一个阶段 (解析, 各 Pass, 代码生成, 输出等), 记录它的墙钟时间,
+ * CPU 时间 (包括所有线程), 峰值内存 (RSS) 的增量, 以及传入模块时阶段前后的 IR 规模。
+ * Pass 自己的计数器 (折叠的指令数等) 在阶段结束后用 add_counter 记到该阶段上。
+ * 阶段不嵌套, 按开始的顺序报告。
+ */
+class PassInstrumentation {
+  public:
+    // 开始一个阶段; m 不为空时记录阶段开始时的 IR 规模
+    void start(std::string name, Module *m = nullptr);
+    // 结束当前阶段; m 不为空时记录阶段结束时的 IR 规模
+    void stop(Module *m = nullptr);
+    // 给最近的阶段添加一个计数器
+    void add_counter(std::string name, long value);
+
+    // 人类可读的表格: 耗时与内存 / IR 规模的变化
+    void print_timing(std::ostream &os) const;
+    void print_stats(std::ostream &os) const;
+    // 包含全部数据的 JSON
+    void print_json(std::ostream &os) const;
+
+  private:
+    struct Sample {
+        std::chrono::steady_clock::time_point wall;
+        double cpu;     // 秒
+        long peak_rss;  // KB
+    };
+    struct Record {
+        std::string name;
+        double wall{0};          // 秒
+        double cpu{0};           // 秒
+        long peak_rss_delta{0};  // KB
+        bool has_before{false};
+        bool has_after{false};
+        IRCounts before;
+        IRCounts after;
+        std::vector<std::pair<std::string, long>> counters;
+    };
+
+    static Sample sample();
+
+    std::vector<Record> records_;
+    Sample started_{};
+    bool running_{false};
+};
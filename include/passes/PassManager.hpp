@@ -2,35 +2,134 @@
 
 #include "Module.hpp"
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+class AnalysisManager;
+class PassInstrumentation;
+class ThreadPool;
+
+// 可由 AnalysisManager 缓存的分析
+enum class AnalysisID : unsigned {
+    dominators, // 支配树, 按函数缓存
+    loops,      // 循环, 按函数缓存, 依赖支配树
+    func_info,  // 纯函数信息, 模块级
+};
+
+// 一个 Pass 运行之后仍然有效的分析
+class PreservedAnalyses {
+  public:
+    // 没有修改 IR
+    static PreservedAnalyses all() { return PreservedAnalyses(~0u); }
+    // 可能修改了任何东西
+    static PreservedAnalyses none() { return PreservedAnalyses(0); }
+    // 只改动了指令, 没有增删基本块或改变跳转, 因此支配树与循环仍然有效
+    static PreservedAnalyses cfg() {
+        return none().preserve(AnalysisID::dominators).preserve(
+            AnalysisID::loops);
+    }
+
+    PreservedAnalyses &preserve(AnalysisID id) {
+        mask_ |= bit(id);
+        return *this;
+    }
+    bool is_preserved(AnalysisID id) const { return mask_ & bit(id); }
+
+  private:
+    explicit PreservedAnalyses(unsigned mask) : mask_(mask) {}
+    static unsigned bit(AnalysisID id) {
+        return 1u << static_cast<unsigned>(id);
+    }
+
+    unsigned mask_;
+};
+
 class Pass {
   public:
     Pass(Module *m) : m_(m) {}
     virtual ~Pass() = default;
     virtual void run() = 0;
+    // 在 -time-passes / -stats 的报告中使用的名字
+    virtual std::string get_name() const = 0;
+
+    // -stats 报告中的计数器 (名字, 值), 在 run 之后读取
+    using Statistics = std::vector<std::pair<std::string, long>>;
+    virtual Statistics get_statistics() const { return {}; }
+
+    // run 之后仍然有效的分析, 默认认为全部失效
+    virtual PreservedAnalyses get_preserved() const {
+        return PreservedAnalyses::none();
+    }
+
+    // 由 PassManager 在运行前设置, Pass 通过它获取分析结果
+    void set_analysis_manager(AnalysisManager *am) { am_ = am; }
 
   protected:
     Module *m_;
+    AnalysisManager *am_{nullptr};
+};
+
+/**
+ * 以函数为单位的 Pass: 对各函数的变换互不影响, 只通过共享的值 (函数, 全局变量,
+ * 常量) 发生联系, 因此 PassManager 可以在多个线程上同时处理不同的函数。
+ * 并行时每个线程使用一个独立的实例, 实例的成员只需在单个函数内保持一致。
+ */
+class FunctionPass : public Pass {
+  public:
+    FunctionPass(Module *m) : Pass(m) {}
+
+    // 依次处理模块中每个有定义的函数
+    void run() final;
+
+    // 处理任何函数之前调用, 用于获取模块级的分析等, 总在单线程中执行
+    virtual void initialize() {}
+    virtual void run_on_function(Function *func) = 0;
+    // 并行运行后把其他实例的统计 (影响 get_preserved 的状态) 合并到本实例
+    virtual void merge(const FunctionPass &) {}
+    // 所有函数处理完毕后调用, 总在单线程中执行
+    virtual void finalize() {}
 };
 
 class PassManager {
   public:
-    PassManager(Module *m) : m_(m) {}
+    // pool 不为空且有多个线程时, FunctionPass 在其上并行运行
+    PassManager(Module *m, ThreadPool *pool = nullptr);
+    ~PassManager();
 
     template <typename PassType, typename... Args>
     void add_pass(Args &&...args) {
-        passes_.emplace_back(new PassType(m_, std::forward<Args>(args)...));
-    }
-
-    void run() {
-        for (auto &pass : passes_) {
-            pass->run();
+        passes_.emplace_back(new PassType(m_, args...));
+        if constexpr (std::is_base_of<FunctionPass, PassType>::value) {
+            // 并行时为其余线程创建相同参数的实例
+            clone_.emplace_back([m = m_, args...]() {
+                return std::unique_ptr<FunctionPass>(new PassType(m, args...));
+            });
+        } else {
+            clone_.emplace_back(nullptr);
         }
     }
 
+    // 依次运行各 Pass, 每个 Pass 之后按其声明丢弃失效的分析
+    void run();
+
+    AnalysisManager &get_analysis_manager() { return *am_; }
+
+    // 不为空时记录每个 Pass 的耗时与前后的 IR 规模
+    void set_instrumentation(PassInstrumentation *pi) { pi_ = pi; }
+
   private:
+    using CloneFn = std::function<std::unique_ptr<FunctionPass>()>;
+
+    void run_parallel(FunctionPass &pass, const CloneFn &clone);
+
     std::vector<std::unique_ptr<Pass>> passes_;
+    std::vector<CloneFn> clone_; // 与 passes_ 一一对应, 非 FunctionPass 为空
     Module *m_;
+    ThreadPool *pool_;
+    PassInstrumentation *pi_{nullptr};
+    std::unique_ptr<AnalysisManager> am_;
 };
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Constant.hpp"
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * 稀疏条件常量传播 (Sparse Conditional Constant Propagation):
+ * 参见 Wegman & Zadeck, Constant Propagation with Conditional Branches。
+ * 只沿可执行的控制流边传播常量, 同时求出哪些边与基本块可能执行:
+ * 折叠整数/浮点运算, 比较与类型转换, 把条件为常量的 br 改为无条件跳转,
+ * 并删除不可达的基本块 (同时维护前驱/后继列表与 phi 的来源)。
+ */
+class SCCP : public FunctionPass {
+  public:
+    SCCP(Module *m) : FunctionPass(m) {}
+
+    std::string get_name() const override { return "sccp"; }
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override;
+    Statistics get_statistics() const override {
+        return {{"folded_instructions", folded_},
+                {"resolved_branches", branches_},
+                {"removed_blocks", blocks_}};
+    }
+    // 只折叠了指令时控制流不变
+    PreservedAnalyses get_preserved() const override {
+        if (branches_ or blocks_)
+            return PreservedAnalyses::none();
+        return folded_ ? PreservedAnalyses::cfg() : PreservedAnalyses::all();
+    }
+
+  private:
+    // 格: undef (尚未确定) > 常量 > overdefined (不是常量), 值只会向下移动
+    struct LatticeVal {
+        enum Kind { undef, constant, overdefined };
+        Kind kind{undef};
+        Constant *val{nullptr};
+
+        bool operator==(const LatticeVal &other) const {
+            return kind == other.kind and val == other.val;
+        }
+    };
+    using Edge = std::pair<BasicBlock *, BasicBlock *>;
+
+    // 求解
+    void solve();
+    void mark_edge(BasicBlock *from, BasicBlock *to);
+    void visit(Instruction *inst);
+    void visit_phi(PhiInst *phi);
+    void visit_br(BranchInst *br);
+    LatticeVal get_lattice(Value *val);
+    void set_lattice(Instruction *inst, LatticeVal val);
+    // 所有操作数都是常量时计算指令的结果, 不能折叠时返回 nullptr
+    Constant *fold(Instruction *inst, const std::vector<Constant *> &ops);
+    // 条件为 undef 的 br 不会标记任何出边, 把这些条件视为 overdefined 后重新求解
+    bool resolve_undef_branches(Function *func);
+
+    // 变换
+    void replace_constants(Function *func);
+    void rewrite_branches(Function *func);
+    void remove_dead_blocks(Function *func);
+
+    std::unordered_map<Value *, LatticeVal> lattice_;
+    std::set<Edge> executable_edges_;
+    std::unordered_set<BasicBlock *> executable_blocks_;
+    std::vector<Edge> cfg_work_list_;
+    std::vector<Instruction *> ssa_work_list_;
+
+    int folded_{0};   // 被替换为常量的指令数
+    int branches_{0}; // 改为无条件跳转的条件分支数
+    int blocks_{0};   // 删除的不可达基本块数
+};
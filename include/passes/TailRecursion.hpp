@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+#include <vector>
+
+/**
+ * 尾递归消除: 把自身的尾调用 (call 之后紧跟 ret 其结果) 改写为跳回函数开头的循环。
+ * 原入口块成为循环头, 参数由循环头的 phi 代替, 其来源为进入函数时的实参与每个尾调用的实参;
+ * 入口块中的 alloca 移入新建的入口块, 保证每次迭代不重复分配。
+ * 含数组 alloca 的函数不做变换: 被调用者可能通过指针访问调用者的数组, 迭代之间不能共用。
+ */
+class TailRecursionElim : public FunctionPass {
+  public:
+    TailRecursionElim(Module *m) : FunctionPass(m) {}
+
+    std::string get_name() const override { return "tail-recursion"; }
+    void run_on_function(Function *func) override;
+    void merge(const FunctionPass &other) override {
+        eliminated_ += static_cast<const TailRecursionElim &>(other).eliminated_;
+    }
+    Statistics get_statistics() const override {
+        return {{"eliminated_tail_calls", eliminated_}};
+    }
+    PreservedAnalyses get_preserved() const override {
+        return eliminated_ ? PreservedAnalyses::none()
+                           : PreservedAnalyses::all();
+    }
+
+  private:
+    int eliminated_{0};
+};
@@ -327,7 +327,7 @@ Value *CminusfBuilder::visit(ASTVar &node) {
         builder->create_cond_br(is_neg, exceptBB, contBB);
         builder->set_insert_point(exceptBB);
         auto *neg_idx_except_fun = scope.find("neg_idx_except");
-        builder->create_call(dynamic_cast<Function *>(neg_idx_except_fun), {});
+        builder->create_call(neg_idx_except_fun->as<Function>(), {});
         if (context.func->get_return_type()->is_void_type()) {
             builder->create_void_ret();
         } else if (context.func->get_return_type()->is_float_type()) {
@@ -487,7 +487,7 @@ Value *CminusfBuilder::visit(ASTTerm &node) {
 }
 
 Value *CminusfBuilder::visit(ASTCall &node) {
-    auto *func = dynamic_cast<Function *>(scope.find(node.id));
+    auto *func = scope.find(node.id)->as<Function>();
     std::vector<Value *> args;
     auto param_type = func->get_function_type()->param_begin();
     for (auto &arg : node.args) {
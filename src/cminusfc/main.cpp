@@ -4,11 +4,21 @@
 #include "ast.hpp"
 #include "cminusf_builder.hpp"
 #include "CodeGen.hpp"
+#include "Peephole.hpp"
 #include "PassManager.hpp"
 #include "DeadCode.hpp"
+#include "GVN.hpp"
+#include "GraphDump.hpp"
+#include "IndexCheckElim.hpp"
+#include "Inline.hpp"
 #include "Mem2Reg.hpp"
 #include "LoopDetection.hpp"
 #include "LICM.hpp"
+#include "LoopUnroll.hpp"
+#include "PassInstrumentation.hpp"
+#include "SCCP.hpp"
+#include "TailRecursion.hpp"
+#include "ThreadPool.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -27,8 +37,31 @@ struct Config {
     bool emitasm{false};
     bool emitllvm{false};
     // optization conifg
+    bool inline_calls{false};
+    unsigned inline_threshold{40}; // 被调用者不计 alloca 的指令数上限
     bool mem2reg{false};
     bool licm{false};
+    bool unroll{false};
+    unsigned unroll_factor{4}; // 部分展开时复制的循环体份数
+    bool sccp{false}; // 稀疏条件常量传播
+    bool gvn{false};  // 全局值编号与冗余 load 消除
+    bool check_elim{false}; // 消除可证明不会触发的负下标检查
+    bool tail_call{false}; // 尾递归消除与尾调用
+    // -O1: mem2reg + 尾调用 + 线性扫描 + 窥孔; -O2: mem2reg + 尾调用 + 图着色 + 窥孔
+    int opt_level{0};
+    // codegen config
+    RegAllocKind regalloc{RegAllocKind::stack};
+    bool regalloc_set{false}; // 显式指定的 -regalloc 优先于 -O
+    bool peephole{false};
+    bool peephole_stats{false}; // 向 stderr 输出窥孔优化各模式的命中次数
+    // 并行处理函数的线程数, 输出与单线程时逐字节相同
+    unsigned jobs{1};
+    // 各阶段的耗时 / IR 规模报告, 前两者输出到 stderr
+    bool time_passes{false};
+    bool stats{false};
+    std::filesystem::path stats_json; // 不为空时把完整报告以 JSON 写入该文件
+    // 优化后各函数的控制流图 / 支配树, 以 .dot 文本写入目录 (默认当前目录)
+    GraphDumpOptions graph_dump;
 
     Config(int argc, char **argv) : argc(argc), argv(argv) {
         parse_cmd_line();
@@ -40,6 +73,9 @@ struct Config {
     char **argv{nullptr};
 
     void parse_cmd_line();
+    void parse_jobs(const string &num);
+    void parse_inline_threshold(const string &num);
+    void parse_unroll_factor(const string &num);
     void check();
     // print helper infomation and exit
     void print_help() const;
@@ -49,43 +85,125 @@ struct Config {
 int main(int argc, char **argv) {
     Config config(argc, argv);
 
+    std::unique_ptr<PassInstrumentation> pi;
+    if (config.time_passes or config.stats or not config.stats_json.empty())
+        pi = std::make_unique<PassInstrumentation>();
+    auto start = [&](const char *phase, Module *m = nullptr) {
+        if (pi)
+            pi->start(phase, m);
+    };
+    auto stop = [&](Module *m = nullptr) {
+        if (pi)
+            pi->stop(m);
+    };
+
+    start("parse");
     auto syntax_tree = parse(config.input_file.c_str());
+    stop();
+    start("ast");
     auto ast = AST(syntax_tree);
+    stop();
 
     if (config.emitast) { // if emit ast (lab1), print ast and return
+        start("print");
         ASTPrinter printer;
         ast.run_visitor(printer);
+        stop();
     } else {
         std::unique_ptr<Module> m;
+        start("builder");
         CminusfBuilder builder;
         ast.run_visitor(builder);
         m = builder.getModule();
+        stop(m.get());
 
-        PassManager PM(m.get());
+        ThreadPool pool(config.jobs);
+        PassManager PM(m.get(), &pool);
+        PM.set_instrumentation(pi.get());
         // optimization 
+        if (config.inline_calls) {
+            PM.add_pass<Inliner>(config.inline_threshold);
+        }
         if(config.mem2reg) {
             PM.add_pass<Mem2Reg>();
             PM.add_pass<DeadCode>();
         }
+        if (config.sccp) {
+            PM.add_pass<SCCP>();
+            PM.add_pass<DeadCode>();
+        }
+        if (config.gvn) {
+            PM.add_pass<GVN>();
+            PM.add_pass<DeadCode>();
+        }
+        if (config.check_elim) {
+            PM.add_pass<IndexCheckElim>();
+            PM.add_pass<DeadCode>();
+        }
+        if (config.tail_call) {
+            PM.add_pass<TailRecursionElim>();
+        }
         if(config.licm) {
             PM.add_pass<LoopInvariantCodeMotion>();
             PM.add_pass<DeadCode>();
         }
+        if (config.unroll) {
+            PM.add_pass<LoopUnroll>(config.unroll_factor);
+            PM.add_pass<DeadCode>();
+        }
         PM.run();
 
+        if (config.graph_dump.enabled()) {
+            start("dump-graphs");
+            bool ok = dump_graphs(m.get(), config.graph_dump);
+            stop();
+            if (not ok) {
+                std::cout << config.exe_name << ": cannot write graphs to "
+                          << config.graph_dump.dir << std::endl;
+                return -1;
+            }
+        }
+
         std::ofstream output_stream(config.output_file);
         if (config.emitllvm) {
+            start("print");
             auto abs_path = std::filesystem::canonical(config.input_file);
             output_stream << "; ModuleID = 'cminus'\n";
             output_stream << "source_filename = " << abs_path << "\n\n";
             output_stream << m->print();
+            stop();
         } else if (config.emitasm) {
-            CodeGen codegen(m.get());
+            start("codegen", m.get());
+            CodeGen codegen(m.get(), config.regalloc, config.tail_call,
+                            &pool);
             codegen.run();
+            stop(m.get());
+            if (config.peephole) {
+                start("peephole");
+                Peephole peephole;
+                peephole.run(codegen.get_machine_module());
+                stop();
+                if (config.peephole_stats) {
+                    for (auto &[pattern, hits] : peephole.get_counters())
+                        std::cerr << "peephole." << pattern << ": " << hits
+                                  << std::endl;
+                }
+            }
+            start("print");
             output_stream << codegen.print();
+            stop();
         }
     }
 
+    if (config.time_passes)
+        pi->print_timing(std::cerr);
+    if (config.stats)
+        pi->print_stats(std::cerr);
+    if (not config.stats_json.empty()) {
+        std::ofstream json(config.stats_json);
+        pi->print_json(json);
+    }
+
     return 0;
 }
 
@@ -107,11 +225,73 @@ void Config::parse_cmd_line() {
             emitasm = true;
         } else if (argv[i] == "-emit-llvm"s) {
             emitllvm = true;
+        } else if (argv[i] == "-inline"s) {
+            inline_calls = true;
+        } else if (string(argv[i]).rfind("-inline-threshold=", 0) == 0) {
+            inline_calls = true;
+            parse_inline_threshold(argv[i] + "-inline-threshold="s.size());
         } else if (argv[i] == "-mem2reg"s) {
             mem2reg = true;
         } else if (argv[i] == "-licm"s) {
             licm = true;
-        }else {
+        } else if (argv[i] == "-unroll"s) {
+            unroll = true;
+        } else if (string(argv[i]).rfind("-unroll-factor=", 0) == 0) {
+            unroll = true;
+            parse_unroll_factor(argv[i] + "-unroll-factor="s.size());
+        } else if (argv[i] == "-sccp"s) {
+            sccp = true;
+        } else if (argv[i] == "-gvn"s) {
+            gvn = true;
+        } else if (argv[i] == "-check-elim"s) {
+            check_elim = true;
+        } else if (argv[i] == "-tail-call"s) {
+            tail_call = true;
+        } else if (argv[i] == "-O0"s) {
+            opt_level = 0;
+        } else if (argv[i] == "-O1"s) {
+            opt_level = 1;
+        } else if (argv[i] == "-O2"s) {
+            opt_level = 2;
+        } else if (argv[i] == "-peephole"s) {
+            peephole = true;
+        } else if (argv[i] == "-peephole-stats"s) {
+            peephole = true;
+            peephole_stats = true;
+        } else if (argv[i] == "-j"s) {
+            if (i + 1 < argc) {
+                parse_jobs(argv[i + 1]);
+                i += 1;
+            } else {
+                print_err("missing number of jobs");
+            }
+        } else if (string(argv[i]).rfind("-j", 0) == 0) {
+            parse_jobs(argv[i] + 2);
+        } else if (argv[i] == "-time-passes"s) {
+            time_passes = true;
+        } else if (argv[i] == "-stats"s) {
+            stats = true;
+        } else if (string(argv[i]).rfind("-stats-json=", 0) == 0) {
+            stats_json = argv[i] + "-stats-json="s.size();
+            if (stats_json.empty())
+                print_err("bad stats file");
+        } else if (string(argv[i]).rfind("-dump-cfg=", 0) == 0) {
+            graph_dump.cfg = true;
+            graph_dump.dir = argv[i] + "-dump-cfg="s.size();
+            if (graph_dump.dir.empty())
+                print_err("bad graph directory");
+        } else if (argv[i] == "-dump-domtree"s) {
+            graph_dump.domtree = true;
+        } else if (argv[i] == "-regalloc=stack"s) {
+            regalloc = RegAllocKind::stack;
+            regalloc_set = true;
+        } else if (argv[i] == "-regalloc=linear"s) {
+            regalloc = RegAllocKind::linear;
+            regalloc_set = true;
+        } else if (argv[i] == "-regalloc=graph"s) {
+            regalloc = RegAllocKind::graph;
+            regalloc_set = true;
+        } else {
             if (input_file.empty()) {
                 input_file = argv[i];
             } else {
@@ -123,7 +303,61 @@ void Config::parse_cmd_line() {
     }
 }
 
+void Config::parse_jobs(const string &num) {
+    std::size_t pos = 0;
+    unsigned long val = 0;
+    try {
+        val = std::stoul(num, &pos);
+    } catch (const std::exception &) {
+        pos = 0;
+    }
+    if (pos == 0 or pos != num.size() or val == 0 or val > 256) {
+        print_err("bad number of jobs \'"s + num + "\'"s);
+    }
+    jobs = static_cast<unsigned>(val);
+}
+
+void Config::parse_inline_threshold(const string &num) {
+    std::size_t pos = 0;
+    unsigned long val = 0;
+    try {
+        val = std::stoul(num, &pos);
+    } catch (const std::exception &) {
+        pos = 0;
+    }
+    if (pos == 0 or pos != num.size() or val > 10000) {
+        print_err("bad inline threshold \'"s + num + "\'"s);
+    }
+    inline_threshold = static_cast<unsigned>(val);
+}
+
+void Config::parse_unroll_factor(const string &num) {
+    std::size_t pos = 0;
+    unsigned long val = 0;
+    try {
+        val = std::stoul(num, &pos);
+    } catch (const std::exception &) {
+        pos = 0;
+    }
+    if (pos == 0 or pos != num.size() or val < 1 or val > 64) {
+        print_err("bad unroll factor \'"s + num + "\'"s);
+    }
+    unroll_factor = static_cast<unsigned>(val);
+}
+
 void Config::check() {
+    if (opt_level >= 1) {
+        mem2reg = true;
+        tail_call = true;
+        peephole = true;
+    }
+    if (not regalloc_set) {
+        if (opt_level == 1) {
+            regalloc = RegAllocKind::linear;
+        } else if (opt_level >= 2) {
+            regalloc = RegAllocKind::graph;
+        }
+    }
     if (input_file.empty()) {
         print_err("no input file");
     }
@@ -136,9 +370,15 @@ void Config::check() {
     if (not emitllvm and not emitasm and not emitast) {
         print_err("not supported: generate executable file directly");
     }
+    if (graph_dump.enabled() and emitast) {
+        print_err("dump graphs and emit ast both set");
+    }
     if (licm and not mem2reg) {
         print_err("licm must be used with mem2reg");
     }
+    if (unroll and not mem2reg) {
+        print_err("unroll must be used with mem2reg");
+    }
     if (output_file.empty()) {
         output_file = input_file.stem();
         if (emitllvm) {
@@ -152,7 +392,12 @@ void Config::check() {
 void Config::print_help() const {
     std::cout << "Usage: " << exe_name
               << " [-h|--help] [-o <target-file>] [-emit-llvm] [-S] [-dump-json]"
-                 "[-mem2reg] [-licm]"
+                 " [-inline] [-inline-threshold=<N>] [-mem2reg] [-licm] "
+                 "[-unroll] [-unroll-factor=<N>] [-sccp] [-gvn] "
+                 "[-check-elim] [-tail-call] [-O0|-O1|-O2] "
+                 "[-regalloc=<stack|linear|graph>] [-peephole] "
+                 "[-peephole-stats] [-j <N>] [-time-passes] [-stats] "
+                 "[-stats-json=<file>] [-dump-cfg=<dir>] [-dump-domtree] "
                  "<input-file>"
               << std::endl;
     exit(0);
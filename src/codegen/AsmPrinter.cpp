@@ -0,0 +1,57 @@
+#include "AsmPrinter.hpp"
+
+namespace {
+
+std::string attribute(const std::string &content) {
+    return "\t" + content + "\n";
+}
+
+std::string label(const std::string &name) { return name + ":\n"; }
+
+} // namespace
+
+std::string AsmPrinter::print() const {
+    std::string result;
+    /* 使用 GNU 伪指令为全局变量分配空间
+     * 虽然 `.text` 加 `.section` 两条伪指令可以简化为一条 `.bss` 伪指令,
+     * 但是我们还是选择使用 `.section` 将全局变量放到可执行文件的 BSS 段, 原因如下:
+     * - 尽可能对齐交叉编译器 loongarch64-unknown-linux-gnu-gcc 的行为
+     * - 支持更旧版本的 GNU 汇编器, 因为 `.bss` 伪指令是应该相对较新的指令,
+     *   GNU 汇编器在 2023 年 2 月的 2.37 版本才将其引入
+     */
+    if (not module_.get_globals().empty()) {
+        result += "# Global variables\n";
+        result += attribute(".text");
+        result += attribute(".section .bss, \"aw\", @nobits");
+        for (auto &global : module_.get_globals()) {
+            auto size = std::to_string(global.size);
+            result += attribute(".globl " + global.name);
+            result += attribute(".type " + global.name + ", @object");
+            result += attribute(".size " + global.name + ", " + size);
+            result += label(global.name);
+            result += attribute(".space " + size);
+        }
+    }
+
+    // 函数代码段
+    result += attribute(".text");
+    for (auto &func : module_.get_functions())
+        result += print_function(func);
+    return result;
+}
+
+std::string AsmPrinter::print_function(const MachineFunction &func) const {
+    std::string result;
+    result += attribute(".globl " + func.get_name());
+    result += attribute(".type " + func.get_name() + ", @function");
+    for (auto &mbb : func.get_blocks()) {
+        result += label(mbb.get_label());
+        for (auto &inst : mbb.get_instrs()) {
+            if (inst.is_comment())
+                result += inst.print() + "\n";
+            else
+                result += "\t" + inst.print() + "\n";
+        }
+    }
+    return result;
+}
@@ -0,0 +1,56 @@
+#include "BranchFusion.hpp"
+
+#include "Constant.hpp"
+
+#include <algorithm>
+
+namespace {
+
+bool only_used_by(Instruction *inst, Instruction *user) {
+    auto uses = inst->get_use_list();
+    return uses.size() == 1 and uses.front().val_ == user and
+           inst->get_parent() == user->get_parent();
+}
+
+bool is_zero(Value *val) {
+    auto *constant = val->dyn_cast<ConstantInt>();
+    return constant != nullptr and constant->get_value() == 0;
+}
+
+} // namespace
+
+std::vector<Instruction *> get_fused_cmp_chain(BasicBlock *bb) {
+    std::vector<Instruction *> chain;
+    auto *br = bb->get_terminator();
+    if (not br->is_br() or
+        not static_cast<BranchInst *>(br)->is_cond_br())
+        return chain;
+
+    auto *cond = br->get_operand(0)->dyn_cast<Instruction>();
+    if (cond == nullptr or not(cond->is_cmp() or cond->is_fcmp()) or
+        not only_used_by(cond, br))
+        return chain;
+    chain.push_back(cond);
+
+    // icmp ne (zext %c), 0 等价于 %c
+    if (cond->get_instr_type() == Instruction::ne and
+        is_zero(cond->get_operand(1))) {
+        auto *zext = cond->get_operand(0)->dyn_cast<Instruction>();
+        if (zext != nullptr and zext->is_zext() and only_used_by(zext, cond)) {
+            auto *inner = zext->get_operand(0)->dyn_cast<Instruction>();
+            if (inner != nullptr and (inner->is_cmp() or inner->is_fcmp()) and
+                only_used_by(inner, zext)) {
+                chain.push_back(zext);
+                chain.push_back(inner);
+            }
+        }
+    }
+    return chain;
+}
+
+bool is_fused_into_br(Instruction *inst) {
+    if (not(inst->is_cmp() or inst->is_fcmp() or inst->is_zext()))
+        return false;
+    auto chain = get_fused_cmp_chain(inst->get_parent());
+    return std::find(chain.begin(), chain.end(), inst) != chain.end();
+}
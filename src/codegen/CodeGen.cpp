@@ -1,15 +1,149 @@
 #include "CodeGen.hpp"
 
+#include "AsmPrinter.hpp"
+#include "BranchFusion.hpp"
 #include "CodeGenUtil.hpp"
+#include "PhiElimination.hpp"
+#include "ThreadPool.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <unordered_map>
 
+using MI = MachineInstr;
+
+namespace {
+
+MachineOperand imm(int64_t val) { return MachineOperand::imm(val); }
+
+MachineOperand label(std::string name) {
+    return MachineOperand::label(std::move(name));
+}
+
+// 按数据类型选择访存指令
+MI::OpID load_op(Type *type) {
+    if (type->is_int1_type())
+        return MI::LD_B;
+    if (type->is_int32_type())
+        return MI::LD_W;
+    if (type->is_float_type())
+        return MI::FLD_S;
+    return MI::LD_D; // Pointer
+}
+
+// x 为 2 的幂时返回其指数, 否则返回 -1
+int exact_log2(int64_t x) {
+    if (x <= 0 or (x & (x - 1)) != 0)
+        return -1;
+    int k = 0;
+    while ((int64_t{1} << k) != x)
+        k++;
+    return k;
+}
+
+MI::OpID store_op(Type *type) {
+    if (type->is_int1_type())
+        return MI::ST_B;
+    if (type->is_int32_type())
+        return MI::ST_W;
+    if (type->is_float_type())
+        return MI::FST_S;
+    return MI::ST_D; // Pointer
+}
+
+} // namespace
+
+/**
+ * @brief 计算有符号 32 位除以常量 d 所需的魔数与移位量
+ *
+ * 参见 Granlund & Montgomery 及 Hacker's Delight 10-1,
+ * 要求 2 <= |d| 且 d 不是 2 的幂 (2 的幂另行处理)。
+ */
+std::pair<int32_t, int> signed_div_magic(int32_t d) {
+    const uint32_t two31 = 0x80000000;
+    uint32_t ad = d < 0 ? -static_cast<uint32_t>(d) : d;
+    uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+    uint32_t anc = t - 1 - t % ad; // |nc|
+    int p = 31;
+    uint32_t q1 = two31 / anc;
+    uint32_t r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad;
+    uint32_t r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta or (q1 == delta and r1 == 0));
+    auto magic = static_cast<int32_t>(q2 + 1);
+    if (d < 0)
+        magic = -magic;
+    return {magic, p - 32};
+}
+
+CodeGen::CodeGen(Module *module, RegAllocKind regalloc_kind, bool tail_call,
+                 ThreadPool *pool)
+    : m(module), regalloc_kind(regalloc_kind), tail_call(tail_call),
+      pool(pool) {
+    switch (regalloc_kind) {
+    case RegAllocKind::stack:
+        break;
+    case RegAllocKind::linear:
+        regalloc = std::make_unique<LinearScan>();
+        break;
+    case RegAllocKind::graph:
+        regalloc = std::make_unique<GraphColoring>();
+        break;
+    }
+}
+
 void CodeGen::allocate() {
     // 备份 $ra $fp
     unsigned offset = PROLOGUE_OFFSET_BASE;
 
+    // 寄存器分配, 未分配到寄存器的定值仍放在栈上
+    if (regalloc) {
+        regalloc->run(context.func);
+        context.greg_map = regalloc->get_greg_map();
+        context.freg_map = regalloc->get_freg_map();
+        // 为用到的被调用者保存寄存器分配备份空间
+        for (auto reg : regalloc->get_used_callee_gregs()) {
+            offset += 8;
+            context.saved_gregs.emplace_back(reg, -static_cast<int>(offset));
+        }
+        for (auto reg : regalloc->get_used_callee_fregs()) {
+            offset += 8;
+            context.saved_fregs.emplace_back(reg, -static_cast<int>(offset));
+        }
+        append_comment(context.func->get_name() + ": " +
+                       std::to_string(regalloc->get_spill_count()) +
+                       " spilled values");
+    }
+    auto in_reg = [&](Value *val) {
+        return context.greg_map.count(val) or context.freg_map.count(val);
+    };
+
+    // 与其他定值共用栈槽的定值在最后处理
+    auto has_slot = [&](Value *val) {
+        return in_reg(val) or
+               (regalloc and regalloc->get_spill_alias().count(val));
+    };
+
     // 为每个参数分配栈空间
     for (auto &arg : context.func->get_args()) {
+        if (has_slot(&arg))
+            continue;
         auto size = arg.get_type()->get_size();
         offset = offset + size;
         context.offset_map[&arg] = -static_cast<int>(offset);
@@ -18,8 +152,9 @@ void CodeGen::allocate() {
     // 为指令结果分配栈空间
     for (auto &bb : context.func->get_basic_blocks()) {
         for (auto &instr : bb.get_instructions()) {
-            // 每个非 void 的定值都分配栈空间
-            if (not instr.is_void()) {
+            // 每个非 void 且未分配到寄存器的定值都分配栈空间, 融合进 br 的比较不产生定值
+            if (not instr.is_void() and not has_slot(&instr) and
+                not is_fused_into_br(&instr)) {
                 auto size = instr.get_type()->get_size();
                 offset = offset + size;
                 context.offset_map[&instr] = -static_cast<int>(offset);
@@ -29,38 +164,120 @@ void CodeGen::allocate() {
                 auto *alloca_inst = static_cast<AllocaInst *>(&instr);
                 auto alloc_size = alloca_inst->get_alloca_type()->get_size();
                 offset += alloc_size;
+                context.alloca_map[&instr] = -static_cast<int>(offset);
             }
         }
     }
 
+    if (regalloc) {
+        for (auto [val, alias] : regalloc->get_spill_alias())
+            context.offset_map[val] = context.offset_map.at(alias);
+    }
+
+    for (auto &bb : context.func->get_basic_blocks()) {
+        for (auto &instr : bb.get_instructions())
+            context.has_call |= instr.is_call() and not is_sibling_call(&instr);
+    }
+    // 不含调用且所有定值都在寄存器中的叶函数不需要栈帧
+    context.frameless = not context.has_call and context.offset_map.empty() and
+                        context.alloca_map.empty() and
+                        context.saved_gregs.empty() and
+                        context.saved_fregs.empty();
+
     // 分配栈空间，需要是 16 的整数倍
-    context.frame_size = ALIGN(offset, PROLOGUE_ALIGN);
+    context.frame_size =
+        context.frameless ? 0 : ALIGN(offset, PROLOGUE_ALIGN);
 }
 
+/**
+ * @brief 为后继块的 phi 生成拷贝
+ *
+ * 同一条边上的 phi 拷贝是并行的: 所有来源都在任何目的被写入之前读取。
+ * 串行化时反复发射目的不再被其余拷贝读取的拷贝, 剩下的拷贝只会构成环 (比如交换),
+ * 这时把环上一个目的的旧值暂存到 $a1/$fa1 来打破环。
+ * 目的与来源位于同一位置 (寄存器合并或共用栈槽) 的拷贝直接省去。
+ */
 void CodeGen::copy_stmt() {
-    for (auto &succ : context.bb->get_succ_basic_blocks()) {
+    // 定值所在的位置, 常量与全局变量没有位置
+    auto loc_of = [&](Value *val) -> std::pair<int, int> {
+        if (context.greg_map.count(val))
+            return {1, static_cast<int>(context.greg_map.at(val))};
+        if (context.freg_map.count(val))
+            return {2, static_cast<int>(context.freg_map.at(val))};
+        if (context.offset_map.count(val))
+            return {3, context.offset_map.at(val)};
+        return {0, 0};
+    };
+
+    struct Copy {
+        Value *dst;
+        Value *src;
+        bool from_tmp; // 来源的旧值已被暂存
+    };
+    std::vector<Copy> copies;
+    for (auto *succ : context.bb->get_succ_basic_blocks()) {
         for (auto &inst : succ->get_instructions()) {
-            if (inst.is_phi()) {
-                // 遍历后继块中 phi 的定值 bb
-                for (unsigned i = 1; i < inst.get_operands().size(); i += 2) {
-                    // phi 的定值 bb 是当前翻译块
-                    if (inst.get_operand(i) == context.bb) {
-                        auto *lvalue = inst.get_operand(i - 1);
-                        if (lvalue->get_type()->is_float_type()) {
-                            load_to_freg(lvalue, FReg::fa(0));
-                            store_from_freg(&inst, FReg::fa(0));
-                        } else {
-                            load_to_greg(lvalue, Reg::a(0));
-                            store_from_greg(&inst, Reg::a(0));
-                        }
-                        break;
-                    }
-                    // 如果没有找到当前翻译块，说明是 undef，无事可做
+            if (not inst.is_phi())
+                break;
+            auto *phi = static_cast<PhiInst *>(&inst);
+            // 没有来自当前块的入边时说明是 undef, 无事可做
+            for (auto &[val, pre] : phi->get_phi_pairs()) {
+                if (pre == context.bb) {
+                    if (loc_of(val) != loc_of(phi))
+                        copies.push_back({phi, val, false});
+                    break;
                 }
+            }
+        }
+    }
+
+    auto reads = [&](const Copy &copy, std::pair<int, int> loc) {
+        return not copy.from_tmp and loc_of(copy.src) == loc;
+    };
+    while (not copies.empty()) {
+        auto ready =
+            std::find_if(copies.begin(), copies.end(), [&](const Copy &copy) {
+                auto loc = loc_of(copy.dst);
+                return std::none_of(
+                    copies.begin(), copies.end(),
+                    [&](const Copy &other) { return reads(other, loc); });
+            });
+        if (ready == copies.end()) {
+            // 只剩下环, 暂存其中一个目的的旧值
+            auto *dst = copies.front().dst;
+            auto loc = loc_of(dst);
+            assert(std::none_of(copies.begin(), copies.end(),
+                                [](const Copy &copy) { return copy.from_tmp; }));
+            if (dst->get_type()->is_float_type())
+                load_to_freg(dst, FReg::fa(1));
+            else
+                load_to_greg(dst, Reg::a(1));
+            for (auto &copy : copies) {
+                if (reads(copy, loc))
+                    copy.from_tmp = true;
+            }
+            continue;
+        }
+
+        auto *dst = ready->dst;
+        if (dst->get_type()->is_float_type()) {
+            if (ready->from_tmp) {
+                store_from_freg(dst, FReg::fa(1));
             } else {
-                break;
+                auto reg = def_freg(dst, FReg::fa(0));
+                load_to_freg(ready->src, reg);
+                store_from_freg(dst, reg);
+            }
+        } else {
+            if (ready->from_tmp) {
+                store_from_greg(dst, Reg::a(1));
+            } else {
+                auto reg = def_greg(dst, Reg::a(0));
+                load_to_greg(ready->src, reg);
+                store_from_greg(dst, reg);
             }
         }
+        copies.erase(ready);
     }
 }
 
@@ -68,25 +285,59 @@ void CodeGen::load_to_greg(Value *val, const Reg &reg) {
     assert(val->get_type()->is_integer_type() ||
            val->get_type()->is_pointer_type());
 
-    if (auto *constant = dynamic_cast<ConstantInt *>(val)) {
+    if (auto *constant = val->dyn_cast<ConstantInt>()) {
         int32_t val = constant->get_value();
         if (IS_IMM_12(val)) {
-            append_inst(ADDI WORD, {reg.print(), "$zero", std::to_string(val)});
+            append_inst(MI::ADDI_W, {reg, Reg::zero(), imm(val)});
         } else {
             load_large_int32(val, reg);
         }
-    } else if (auto *global = dynamic_cast<GlobalVariable *>(val)) {
-        append_inst(LOAD_ADDR, {reg.print(), global->get_name()});
+    } else if (auto *global = val->dyn_cast<GlobalVariable>()) {
+        append_inst(MI::LA_LOCAL, {reg, label(global->get_name())});
+    } else if (context.greg_map.count(val)) {
+        auto src = Reg(context.greg_map.at(val));
+        if (src != reg)
+            append_inst(MI::MOVE, {reg, src});
     } else {
         load_from_stack_to_greg(val, reg);
     }
 }
 
+Reg CodeGen::use_greg(Value *val, const Reg &tmp) {
+    if (auto *constant = val->dyn_cast<ConstantInt>()) {
+        if (constant->get_value() == 0)
+            return Reg::zero();
+    }
+    if (context.greg_map.count(val))
+        return Reg(context.greg_map.at(val));
+    load_to_greg(val, tmp);
+    return tmp;
+}
+
+FReg CodeGen::use_freg(Value *val, const FReg &tmp) {
+    if (context.freg_map.count(val))
+        return FReg(context.freg_map.at(val));
+    load_to_freg(val, tmp);
+    return tmp;
+}
+
+Reg CodeGen::def_greg(Value *val, const Reg &tmp) {
+    if (context.greg_map.count(val))
+        return Reg(context.greg_map.at(val));
+    return tmp;
+}
+
+FReg CodeGen::def_freg(Value *val, const FReg &tmp) {
+    if (context.freg_map.count(val))
+        return FReg(context.freg_map.at(val));
+    return tmp;
+}
+
 void CodeGen::load_large_int32(int32_t val, const Reg &reg) {
     int32_t high_20 = val >> 12; // si20
     uint32_t low_12 = val & LOW_12_MASK;
-    append_inst(LU12I_W, {reg.print(), std::to_string(high_20)});
-    append_inst(ORI, {reg.print(), reg.print(), std::to_string(low_12)});
+    append_inst(MI::LU12I_W, {reg, imm(high_20)});
+    append_inst(MI::ORI, {reg, reg, imm(low_12)});
 }
 
 void CodeGen::load_large_int64(int64_t val, const Reg &reg) {
@@ -96,77 +347,59 @@ void CodeGen::load_large_int64(int64_t val, const Reg &reg) {
     auto high_32 = static_cast<int32_t>(val >> 32);
     int32_t high_32_low_20 = (high_32 << 12) >> 12; // si20
     int32_t high_32_high_12 = high_32 >> 20;        // si12
-    append_inst(LU32I_D, {reg.print(), std::to_string(high_32_low_20)});
-    append_inst(LU52I_D,
-                {reg.print(), reg.print(), std::to_string(high_32_high_12)});
+    append_inst(MI::LU32I_D, {reg, imm(high_32_low_20)});
+    append_inst(MI::LU52I_D, {reg, reg, imm(high_32_high_12)});
 }
 
 void CodeGen::load_from_stack_to_greg(Value *val, const Reg &reg) {
     auto offset = context.offset_map.at(val);
-    auto offset_str = std::to_string(offset);
-    auto *type = val->get_type();
+    auto op = load_op(val->get_type());
     if (IS_IMM_12(offset)) {
-        if (type->is_int1_type()) {
-            append_inst(LOAD BYTE, {reg.print(), "$fp", offset_str});
-        } else if (type->is_int32_type()) {
-            append_inst(LOAD WORD, {reg.print(), "$fp", offset_str});
-        } else { // Pointer
-            append_inst(LOAD DOUBLE, {reg.print(), "$fp", offset_str});
-        }
+        append_inst(op, {reg, Reg::fp(), imm(offset)});
     } else {
         load_large_int64(offset, reg);
-        append_inst(ADD DOUBLE, {reg.print(), "$fp", reg.print()});
-        if (type->is_int1_type()) {
-            append_inst(LOAD BYTE, {reg.print(), reg.print(), "0"});
-        } else if (type->is_int32_type()) {
-            append_inst(LOAD WORD, {reg.print(), reg.print(), "0"});
-        } else { // Pointer
-            append_inst(LOAD DOUBLE, {reg.print(), reg.print(), "0"});
-        }
+        append_inst(MI::ADD_D, {reg, Reg::fp(), reg});
+        append_inst(op, {reg, reg, imm(0)});
     }
 }
 
 void CodeGen::store_from_greg(Value *val, const Reg &reg) {
+    if (context.greg_map.count(val)) {
+        auto dst = Reg(context.greg_map.at(val));
+        if (dst != reg)
+            append_inst(MI::MOVE, {dst, reg});
+        return;
+    }
     auto offset = context.offset_map.at(val);
-    auto offset_str = std::to_string(offset);
-    auto *type = val->get_type();
+    auto op = store_op(val->get_type());
     if (IS_IMM_12(offset)) {
-        if (type->is_int1_type()) {
-            append_inst(STORE BYTE, {reg.print(), "$fp", offset_str});
-        } else if (type->is_int32_type()) {
-            append_inst(STORE WORD, {reg.print(), "$fp", offset_str});
-        } else { // Pointer
-            append_inst(STORE DOUBLE, {reg.print(), "$fp", offset_str});
-        }
+        append_inst(op, {reg, Reg::fp(), imm(offset)});
     } else {
         auto addr = Reg::t(8);
         load_large_int64(offset, addr);
-        append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-        if (type->is_int1_type()) {
-            append_inst(STORE BYTE, {reg.print(), addr.print(), "0"});
-        } else if (type->is_int32_type()) {
-            append_inst(STORE WORD, {reg.print(), addr.print(), "0"});
-        } else { // Pointer
-            append_inst(STORE DOUBLE, {reg.print(), addr.print(), "0"});
-        }
+        append_inst(MI::ADD_D, {addr, Reg::fp(), addr});
+        append_inst(op, {reg, addr, imm(0)});
     }
 }
 
 void CodeGen::load_to_freg(Value *val, const FReg &freg) {
     assert(val->get_type()->is_float_type());
-    if (auto *constant = dynamic_cast<ConstantFP *>(val)) {
+    if (auto *constant = val->dyn_cast<ConstantFP>()) {
         float val = constant->get_value();
         load_float_imm(val, freg);
+    } else if (context.freg_map.count(val)) {
+        auto src = FReg(context.freg_map.at(val));
+        if (src != freg)
+            append_inst(MI::FMOV_S, {freg, src});
     } else {
         auto offset = context.offset_map.at(val);
-        auto offset_str = std::to_string(offset);
         if (IS_IMM_12(offset)) {
-            append_inst(FLOAD SINGLE, {freg.print(), "$fp", offset_str});
+            append_inst(MI::FLD_S, {freg, Reg::fp(), imm(offset)});
         } else {
             auto addr = Reg::t(8);
             load_large_int64(offset, addr);
-            append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-            append_inst(FLOAD SINGLE, {freg.print(), addr.print(), "0"});
+            append_inst(MI::ADD_D, {addr, Reg::fp(), addr});
+            append_inst(MI::FLD_S, {freg, addr, imm(0)});
         }
     }
 }
@@ -174,35 +407,53 @@ void CodeGen::load_to_freg(Value *val, const FReg &freg) {
 void CodeGen::load_float_imm(float val, const FReg &r) {
     int32_t bytes = *reinterpret_cast<int32_t *>(&val);
     load_large_int32(bytes, Reg::t(8));
-    append_inst(GR2FR WORD, {r.print(), Reg::t(8).print()});
+    append_inst(MI::MOVGR2FR_W, {r, Reg::t(8)});
 }
 
 void CodeGen::store_from_freg(Value *val, const FReg &r) {
+    if (context.freg_map.count(val)) {
+        auto dst = FReg(context.freg_map.at(val));
+        if (dst != r)
+            append_inst(MI::FMOV_S, {dst, r});
+        return;
+    }
     auto offset = context.offset_map.at(val);
     if (IS_IMM_12(offset)) {
-        auto offset_str = std::to_string(offset);
-        append_inst(FSTORE SINGLE, {r.print(), "$fp", offset_str});
+        append_inst(MI::FST_S, {r, Reg::fp(), imm(offset)});
     } else {
         auto addr = Reg::t(8);
         load_large_int64(offset, addr);
-        append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-        append_inst(FSTORE SINGLE, {r.print(), addr.print(), "0"});
+        append_inst(MI::ADD_D, {addr, Reg::fp(), addr});
+        append_inst(MI::FST_S, {r, addr, imm(0)});
     }
 }
 
 void CodeGen::gen_prologue() {
-    if (IS_IMM_12(-static_cast<int>(context.frame_size))) {
-        append_inst("st.d $ra, $sp, -8");
-        append_inst("st.d $fp, $sp, -16");
-        append_inst("addi.d $fp, $sp, 0");
-        append_inst("addi.d $sp, $sp, " +
-                    std::to_string(-static_cast<int>(context.frame_size)));
+    auto frame_size = static_cast<int>(context.frame_size);
+    if (context.frameless) {
+        // 叶函数不建立栈帧, 参数直接搬入分配到的寄存器
+    } else if (IS_IMM_12(-frame_size)) {
+        // 只有存在调用时 $ra 才会被改写
+        if (context.has_call)
+            append_inst(MI::ST_D, {Reg::ra(), Reg::sp(), imm(-8)});
+        append_inst(MI::ST_D, {Reg::fp(), Reg::sp(), imm(-16)});
+        append_inst(MI::ADDI_D, {Reg::fp(), Reg::sp(), imm(0)});
+        append_inst(MI::ADDI_D, {Reg::sp(), Reg::sp(), imm(-frame_size)});
     } else {
-        load_large_int64(context.frame_size, Reg::t(0));
-        append_inst("st.d $ra, $sp, -8");
-        append_inst("st.d $fp, $sp, -16");
-        append_inst("sub.d $sp, $sp, $t0");
-        append_inst("add.d $fp, $sp, $t0");
+        load_large_int64(frame_size, Reg::t(0));
+        if (context.has_call)
+            append_inst(MI::ST_D, {Reg::ra(), Reg::sp(), imm(-8)});
+        append_inst(MI::ST_D, {Reg::fp(), Reg::sp(), imm(-16)});
+        append_inst(MI::SUB_D, {Reg::sp(), Reg::sp(), Reg::t(0)});
+        append_inst(MI::ADD_D, {Reg::fp(), Reg::sp(), Reg::t(0)});
+    }
+
+    // 备份用到的被调用者保存寄存器
+    for (auto &[reg, offset] : context.saved_gregs) {
+        append_inst(MI::ST_D, {Reg(reg), Reg::fp(), imm(offset)});
+    }
+    for (auto &[reg, offset] : context.saved_fregs) {
+        append_inst(MI::FST_D, {FReg(reg), Reg::fp(), imm(offset)});
     }
 
     int garg_cnt = 0;
@@ -218,29 +469,42 @@ void CodeGen::gen_prologue() {
 
 void CodeGen::gen_epilogue() {
     // TODO 根据你的理解设定函数的 epilogue
-    if (IS_IMM_12(-static_cast<int>(context.frame_size))) {
-        append_inst("addi.d $sp, $sp, " +
-                    std::to_string(static_cast<int>(context.frame_size)));
-        append_inst("ld.d $ra, $sp, -8");
-        append_inst("ld.d $fp, $sp, -16");
-        append_inst("jr $ra");
-    } else {
-        load_large_int64(context.frame_size, Reg::t(0));
-        append_inst("addi.d $sp, $sp, $t0");
-        append_inst("ld.d $ra, $sp, -8");
-        append_inst("ld.d $fp, $sp, -16");
-        append_inst("jr $ra");
-        
+    restore_frame();
+    append_inst(MI::JR, {Reg::ra()});
+}
 
+void CodeGen::restore_frame() {
+    if (context.frameless)
+        return;
+    // 恢复被调用者保存寄存器
+    for (auto &[reg, offset] : context.saved_gregs) {
+        append_inst(MI::LD_D, {Reg(reg), Reg::fp(), imm(offset)});
+    }
+    for (auto &[reg, offset] : context.saved_fregs) {
+        append_inst(MI::FLD_D, {FReg(reg), Reg::fp(), imm(offset)});
+    }
+    auto frame_size = static_cast<int>(context.frame_size);
+    if (IS_IMM_12(-frame_size)) {
+        append_inst(MI::ADDI_D, {Reg::sp(), Reg::sp(), imm(frame_size)});
+    } else {
+        load_large_int64(frame_size, Reg::t(0));
+        append_inst(MI::ADD_D, {Reg::sp(), Reg::sp(), Reg::t(0)});
     }
+    if (context.has_call)
+        append_inst(MI::LD_D, {Reg::ra(), Reg::sp(), imm(-8)});
+    append_inst(MI::LD_D, {Reg::fp(), Reg::sp(), imm(-16)});
 }
 
-
 void CodeGen::gen_ret() {
     // TODO 函数返回，思考如何处理返回值、寄存器备份，如何返回调用者地址
     auto *retInst = static_cast<ReturnInst *>(context.inst);
+    // 尾调用已经直接跳转到被调用者, 由它返回到调用者
+    auto it = retInst->getIterator();
+    if (it != context.bb->get_instructions().begin() and
+        is_sibling_call(&*std::prev(it)))
+        return;
     if (retInst->is_void_ret()) {
-        append_inst("addi.d $a0, $zero, 0");
+        append_inst(MI::ADDI_D, {Reg::a(0), Reg::zero(), imm(0)});
     }
     else 
     {
@@ -252,71 +516,228 @@ void CodeGen::gen_ret() {
             load_to_greg(retInst->get_operand(0), Reg::a(0));
         }
     }
-    append_inst("b " + func_exit_label_name(context.func));
+    // 每个返回点直接生成 epilogue 并返回, 不再跳转到公共出口
+    gen_epilogue();
 
 }
 
 void CodeGen::gen_br() {
     auto *branchInst = static_cast<BranchInst *>(context.inst);
-    if (branchInst->is_cond_br()) {
-        // TODO 补全条件跳转的情况
-        load_to_greg(branchInst->get_operand(0), Reg::t(0));
+    auto chain = get_fused_cmp_chain(context.bb);
+    if (not chain.empty()) {
+        gen_fused_br(chain.back());
+    } else if (branchInst->is_cond_br()) {
+        // icmp/fcmp 的结果只会是 0 或 1
+        auto cond = use_greg(branchInst->get_operand(0), Reg::t(0));
         auto *truebb = static_cast<BasicBlock *>(branchInst->get_operand(1));
         auto *falsebb = static_cast<BasicBlock *>(branchInst->get_operand(2));
-        append_inst("bstrpick.d $t0, $t0, 0, 0");
-        append_inst("bnez $t0, " + label_name(truebb));
-        append_inst("b "+label_name(falsebb));
+        append_inst(MI::BNEZ, {cond, label(label_name(truebb))});
+        append_inst(MI::B, {label(label_name(falsebb))});
 
     } else {
         auto *branchbb = static_cast<BasicBlock *>(branchInst->get_operand(0));
-        append_inst("b " + label_name(branchbb));
+        append_inst(MI::B, {label(label_name(branchbb))});
+    }
+}
+
+void CodeGen::gen_fused_br(Instruction *cmp) {
+    auto *branchInst = static_cast<BranchInst *>(context.inst);
+    auto truebb = label(label_name(
+        static_cast<BasicBlock *>(branchInst->get_operand(1))));
+    auto falsebb = label(label_name(
+        static_cast<BasicBlock *>(branchInst->get_operand(2))));
+    if (cmp->is_fcmp()) {
+        auto lhs = use_freg(cmp->get_operand(0), FReg::ft(0));
+        auto rhs = use_freg(cmp->get_operand(1), FReg::ft(1));
+        switch (cmp->get_instr_type()) {
+        case Instruction::fge:
+            append_inst(MI::FCMP_SLE_S, {CFReg(0), rhs, lhs});
+            break;
+        case Instruction::fgt:
+            append_inst(MI::FCMP_SLT_S, {CFReg(0), rhs, lhs});
+            break;
+        case Instruction::fle:
+            append_inst(MI::FCMP_SLE_S, {CFReg(0), lhs, rhs});
+            break;
+        case Instruction::flt:
+            append_inst(MI::FCMP_SLT_S, {CFReg(0), lhs, rhs});
+            break;
+        case Instruction::feq:
+            append_inst(MI::FCMP_SEQ_S, {CFReg(0), lhs, rhs});
+            break;
+        case Instruction::fne:
+            append_inst(MI::FCMP_SNE_S, {CFReg(0), lhs, rhs});
+            break;
+        default:
+            assert(false);
+        }
+        append_inst(MI::BCNEZ, {CFReg(0), truebb});
+    } else {
+        auto lhs = use_greg(cmp->get_operand(0), Reg::t(0));
+        auto rhs = use_greg(cmp->get_operand(1), Reg::t(1));
+        switch (cmp->get_instr_type()) {
+        case Instruction::ge:
+            append_inst(MI::BGE, {lhs, rhs, truebb});
+            break;
+        case Instruction::gt:
+            append_inst(MI::BLT, {rhs, lhs, truebb});
+            break;
+        case Instruction::le:
+            append_inst(MI::BGE, {rhs, lhs, truebb});
+            break;
+        case Instruction::lt:
+            append_inst(MI::BLT, {lhs, rhs, truebb});
+            break;
+        case Instruction::eq:
+            append_inst(MI::BEQ, {lhs, rhs, truebb});
+            break;
+        case Instruction::ne:
+            append_inst(MI::BNE, {lhs, rhs, truebb});
+            break;
+        default:
+            assert(false);
+        }
     }
+    append_inst(MI::B, {falsebb});
 }
 
 void CodeGen::gen_binary() {
-    load_to_greg(context.inst->get_operand(0), Reg::t(0));
-    load_to_greg(context.inst->get_operand(1), Reg::t(1));
-    switch (context.inst->get_instr_type()) {
+    auto *lhs_val = context.inst->get_operand(0);
+    auto *rhs_val = context.inst->get_operand(1);
+    auto op = context.inst->get_instr_type();
+    // 可交换的运算把常量换到右侧
+    if ((op == Instruction::add or op == Instruction::mul) and
+        lhs_val->is<ConstantInt>() and
+        not rhs_val->is<ConstantInt>())
+        std::swap(lhs_val, rhs_val);
+
+    auto lhs = use_greg(lhs_val, Reg::t(0));
+    auto dst = def_greg(context.inst, Reg::t(2));
+    // 右侧为常量时尽量使用立即数或移位指令
+    if (auto *constant = rhs_val->dyn_cast<ConstantInt>()) {
+        int val = constant->get_value();
+        if (op == Instruction::add and IS_IMM_12(val)) {
+            append_inst(MI::ADDI_W, {dst, lhs, imm(val)});
+            store_from_greg(context.inst, dst);
+            return;
+        }
+        if (op == Instruction::sub and val != INT32_MIN and IS_IMM_12(-val)) {
+            append_inst(MI::ADDI_W, {dst, lhs, imm(-val)});
+            store_from_greg(context.inst, dst);
+            return;
+        }
+        if (op == Instruction::sdiv and val != 0) {
+            gen_sdiv_imm(lhs, dst, val);
+            store_from_greg(context.inst, dst);
+            return;
+        }
+        if (op == Instruction::mul) {
+            auto shift = exact_log2(val);
+            auto alsl_shift = exact_log2(static_cast<int64_t>(val) - 1);
+            if (shift >= 0) {
+                append_inst(MI::SLLI_W, {dst, lhs, imm(shift)});
+                store_from_greg(context.inst, dst);
+                return;
+            }
+            if (1 <= alsl_shift and alsl_shift <= 4) {
+                // x * (2^k + 1) = (x << k) + x
+                append_inst(MI::ALSL_W, {dst, lhs, lhs, imm(alsl_shift)});
+                store_from_greg(context.inst, dst);
+                return;
+            }
+        }
+    }
+
+    auto rhs = use_greg(rhs_val, Reg::t(1));
+    switch (op) {
     case Instruction::add:
-        output.emplace_back("add.w $t2, $t0, $t1");
+        append_inst(MI::ADD_W, {dst, lhs, rhs});
         break;
     case Instruction::sub:
-        output.emplace_back("sub.w $t2, $t0, $t1");
+        append_inst(MI::SUB_W, {dst, lhs, rhs});
         break;
     case Instruction::mul:
-        output.emplace_back("mul.w $t2, $t0, $t1");
+        append_inst(MI::MUL_W, {dst, lhs, rhs});
         break;
     case Instruction::sdiv:
-        output.emplace_back("div.w $t2, $t0, $t1");
+        append_inst(MI::DIV_W, {dst, lhs, rhs});
         break;
     default:
         assert(false);
     }
-    store_from_greg(context.inst, Reg::t(2));
+    store_from_greg(context.inst, dst);
+}
+
+/* 有符号除以常量, 结果向零取整:
+ * - |d| = 2^k: 负数先加上偏置 2^k - 1 再算术右移
+ * - 其他: q = mulh(n, magic) (+/- n), 再算术右移并加上 q 的符号位
+ * 计算过程只使用 $t1 与 $t8, dst 与 n 可以是同一寄存器
+ */
+void CodeGen::gen_sdiv_imm(const Reg &n, const Reg &dst, int32_t d) {
+    auto tmp = Reg::t(1);
+    if (d == 1 or d == -1) {
+        if (d == 1)
+            append_inst(MI::ADDI_W, {dst, n, imm(0)});
+        else
+            append_inst(MI::SUB_W, {dst, Reg::zero(), n});
+        return;
+    }
+
+    auto abs_d = d < 0 ? -static_cast<int64_t>(d) : static_cast<int64_t>(d);
+    auto k = exact_log2(abs_d);
+    if (k > 0) {
+        if (k == 1) {
+            append_inst(MI::SRLI_W, {tmp, n, imm(31)});
+        } else {
+            append_inst(MI::SRAI_W, {tmp, n, imm(31)});
+            append_inst(MI::SRLI_W, {tmp, tmp, imm(32 - k)});
+        }
+        append_inst(MI::ADD_W, {tmp, tmp, n});
+        if (d > 0) {
+            append_inst(MI::SRAI_W, {dst, tmp, imm(k)});
+        } else {
+            append_inst(MI::SRAI_W, {tmp, tmp, imm(k)});
+            append_inst(MI::SUB_W, {dst, Reg::zero(), tmp});
+        }
+        return;
+    }
+
+    auto [magic, shift] = signed_div_magic(d);
+    load_to_greg(ConstantInt::get(magic, m), tmp);
+    append_inst(MI::MULH_W, {tmp, n, tmp});
+    if (d > 0 and magic < 0)
+        append_inst(MI::ADD_W, {tmp, tmp, n});
+    else if (d < 0 and magic > 0)
+        append_inst(MI::SUB_W, {tmp, tmp, n});
+    if (shift > 0)
+        append_inst(MI::SRAI_W, {tmp, tmp, imm(shift)});
+    append_inst(MI::SRLI_W, {Reg::t(8), tmp, imm(31)});
+    append_inst(MI::ADD_W, {dst, tmp, Reg::t(8)});
 }
 
 void CodeGen::gen_float_binary() {
     // TODO 浮点类型的二元指令
-    load_to_freg(context.inst->get_operand(0), FReg::ft(0));
-    load_to_freg(context.inst->get_operand(1), FReg::ft(1));
+    auto lhs = use_freg(context.inst->get_operand(0), FReg::ft(0));
+    auto rhs = use_freg(context.inst->get_operand(1), FReg::ft(1));
+    auto dst = def_freg(context.inst, FReg::ft(2));
     switch (context.inst->get_instr_type()) {
     case Instruction::fadd:
-        output.emplace_back("fadd.s $ft2, $ft0, $ft1");
+        append_inst(MI::FADD_S, {dst, lhs, rhs});
         break;
     case Instruction::fsub:
-        output.emplace_back("fsub.s $ft2, $ft0, $ft1");
+        append_inst(MI::FSUB_S, {dst, lhs, rhs});
         break;
     case Instruction::fmul:
-        output.emplace_back("fmul.s $ft2, $ft0, $ft1");
+        append_inst(MI::FMUL_S, {dst, lhs, rhs});
         break;
     case Instruction::fdiv:
-        output.emplace_back("fdiv.s $ft2, $ft0, $ft1");
+        append_inst(MI::FDIV_S, {dst, lhs, rhs});
         break;
     default:
         assert(false);
     
     }
-    store_from_freg(context.inst, FReg::ft(2));
+    store_from_freg(context.inst, dst);
 }
 
 void CodeGen::gen_alloca() {
@@ -324,248 +745,163 @@ void CodeGen::gen_alloca() {
      * 指令自身产生的定值，即指向 alloca 空间起始地址的指针
      */
     // TODO 将 alloca 出空间的起始地址保存在栈帧上
-    auto offset = context.offset_map.at(context.inst);
-    auto *alloca_inst=static_cast<AllocaInst*>(context.inst);
-    auto size= static_cast<int>(alloca_inst->get_alloca_type()->get_size());
-    auto alloca_addr=offset-size;
-    append_inst("addi.d $t1, $fp , " + std::to_string(alloca_addr));
-    append_inst("st.d $t1 ,$fp , "+std::to_string(offset));
-    
-
+    auto alloca_addr = context.alloca_map.at(context.inst);
+    auto dst = def_greg(context.inst, Reg::t(1));
+    if (IS_IMM_12(alloca_addr)) {
+        append_inst(MI::ADDI_D, {dst, Reg::fp(), imm(alloca_addr)});
+    } else {
+        load_large_int64(alloca_addr, dst);
+        append_inst(MI::ADD_D, {dst, Reg::fp(), dst});
+    }
+    store_from_greg(context.inst, dst);
 }
 
 void CodeGen::gen_load() {
     auto *ptr = context.inst->get_operand(0);
     auto *type = context.inst->get_type();
-    load_to_greg(ptr, Reg::t(0));
+    auto addr = use_greg(ptr, Reg::t(0));
 
     if (type->is_float_type()) {
-        append_inst("fld.s $ft0, $t0, 0");
-        store_from_freg(context.inst, FReg::ft(0));
+        auto dst = def_freg(context.inst, FReg::ft(0));
+        append_inst(MI::FLD_S, {dst, addr, imm(0)});
+        store_from_freg(context.inst, dst);
     } else {
         // TODO load 整数类型的数据
-        if(type->is_int1_type()){
-            append_inst("ld.b $t1, $t0, 0");
-            store_from_greg(context.inst, Reg::t(1));
-        }
-        else if (type->is_int32_type())
-        {
-            append_inst("ld.w $t1, $t0, 0");
-            store_from_greg(context.inst, Reg::t(1));
-        }
-        else{
-            append_inst("ld.d $t1, $t0, 0");
-            store_from_greg(context.inst, Reg::t(1));
-        }
+        auto dst = def_greg(context.inst, Reg::t(1));
+        append_inst(load_op(type), {dst, addr, imm(0)});
+        store_from_greg(context.inst, dst);
     }
 }
 
 void CodeGen::gen_store() {
     // TODO 翻译 store 指令
-    load_to_greg(context.inst->get_operand(1), Reg::t(0));
-    auto *type= context.inst->get_operand(0)->get_type();
+    auto addr = use_greg(context.inst->get_operand(1), Reg::t(0));
+    auto *type = context.inst->get_operand(0)->get_type();
     if (type->is_float_type()) {
-        load_to_freg(context.inst->get_operand(0), FReg::ft(0));
-        append_inst("fst.s $ft0, $t0, 0");
-    }
-    else {
-        if(type->is_int1_type()){
-            load_to_greg(context.inst->get_operand(0), Reg::t(1));
-            append_inst("st.b $t1, $t0, 0");
-        }
-        else if(type->is_int32_type()){
-            {
-                load_to_greg(context.inst->get_operand(0), Reg::t(1));
-                append_inst("st.w $t1, $t0, 0");
-            }
-        }
-        else
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(1));
-            append_inst("st.d $t1, $t0, 0");
-        }
+        auto val = use_freg(context.inst->get_operand(0), FReg::ft(0));
+        append_inst(MI::FST_S, {val, addr, imm(0)});
+    } else {
+        auto val = use_greg(context.inst->get_operand(0), Reg::t(1));
+        append_inst(store_op(type), {val, addr, imm(0)});
     }
-
 }
 
 void CodeGen::gen_icmp() {
-    // TODO 处理各种整数比较的情况
+    // 比较结果为 0 或 1
+    auto lhs = use_greg(context.inst->get_operand(0), Reg::t(0));
+    auto rhs = use_greg(context.inst->get_operand(1), Reg::t(1));
+    auto dst = def_greg(context.inst, Reg::t(2));
     switch (context.inst->get_instr_type()) {
-    {
     case Instruction::ge:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t0, $t1");
-            append_inst("orn $t3, $zero, $t2");
-            store_from_greg(context.inst, Reg::t(3));
-            break;
-        }
+        append_inst(MI::SLT, {dst, lhs, rhs});
+        append_inst(MI::XORI, {dst, dst, imm(1)});
+        break;
     case Instruction::gt:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t1, $t0");
-            store_from_greg(context.inst, Reg::t(2));
-            break;
-        }
+        append_inst(MI::SLT, {dst, rhs, lhs});
+        break;
     case Instruction::le:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t1, $t0");
-            append_inst("orn $t3, $zero, $t2");
-            store_from_greg(context.inst, Reg::t(3));
-            break;
-        }
+        append_inst(MI::SLT, {dst, rhs, lhs});
+        append_inst(MI::XORI, {dst, dst, imm(1)});
+        break;
     case Instruction::lt:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t0, $t1");
-            store_from_greg(context.inst, Reg::t(2));
-            break;
-        }
+        append_inst(MI::SLT, {dst, lhs, rhs});
+        break;
     case Instruction::eq:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t0, $t1");
-            append_inst("slt $t3, $t1, $t0");
-            append_inst("nor $t4, $t2, $t3");
-            store_from_greg(context.inst, Reg::t(4));
-            break;
-        }
+        append_inst(MI::XOR, {dst, lhs, rhs});
+        append_inst(MI::SLTUI, {dst, dst, imm(1)});
+        break;
     case Instruction::ne:
-        {
-            load_to_greg(context.inst->get_operand(0), Reg::t(0));
-            load_to_greg(context.inst->get_operand(1), Reg::t(1));
-            append_inst("slt $t2, $t0, $t1");
-            append_inst("slt $t3, $t1, $t0");
-            append_inst("or $t4, $t2, $t3");
-            store_from_greg(context.inst, Reg::t(4));
-            break;
-        }
-        
-    
+        append_inst(MI::XOR, {dst, lhs, rhs});
+        append_inst(MI::SLTU, {dst, Reg::zero(), dst});
+        break;
     default:
         assert(false);
-        
-    }
     }
+    store_from_greg(context.inst, dst);
 }
 
 void CodeGen::gen_fcmp() {
-    // TODO 处理各种浮点数比较的情况
-    load_to_freg(context.inst->get_operand(0), FReg::ft(0));
-    load_to_freg(context.inst->get_operand(1), FReg::ft(1));
-    switch(context.inst->get_instr_type()) {
-    case Instruction::ge:
-        append_inst("fcmp.slt.s $fcc0, $ft0, $ft1");
-        append_inst("bcnez $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    // 比较结果写入 $fcc0, 再搬运到通用寄存器中
+    auto lhs = use_freg(context.inst->get_operand(0), FReg::ft(0));
+    auto rhs = use_freg(context.inst->get_operand(1), FReg::ft(1));
+    switch (context.inst->get_instr_type()) {
+    case Instruction::fge:
+        append_inst(MI::FCMP_SLE_S, {CFReg(0), rhs, lhs});
         break;
-    case Instruction::gt:
-        append_inst("fcmp.sle.s $fcc0, $ft0, $ft1");
-        append_inst("bcnez $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    case Instruction::fgt:
+        append_inst(MI::FCMP_SLT_S, {CFReg(0), rhs, lhs});
         break;
-    case Instruction::le:
-        append_inst("fcmp.sle.s $fcc0, $ft0, $ft1");
-        append_inst("bceqz $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    case Instruction::fle:
+        append_inst(MI::FCMP_SLE_S, {CFReg(0), lhs, rhs});
         break;
-    case Instruction::lt:
-        append_inst("fcmp.slt.s $fcc0, $ft0, $ft1");
-        append_inst("bceqz $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    case Instruction::flt:
+        append_inst(MI::FCMP_SLT_S, {CFReg(0), lhs, rhs});
         break;
-    case Instruction::eq:
-        append_inst("fcmp.seq.s $fcc0, $ft0, $ft1");
-        append_inst("bceqz $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    case Instruction::feq:
+        append_inst(MI::FCMP_SEQ_S, {CFReg(0), lhs, rhs});
         break;
-    case Instruction::ne:
-        append_inst("fcmp.sne.s $fcc0, $ft0, $ft1");
-        append_inst("bceqz $fcc0,.false_label");
-        append_inst(".true_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 1");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst("b",{".exit"+std::to_string(context.num)+":"});
-        append_inst(".false_label"+std::to_string(context.num)+":",ASMInstruction::Label);
-        append_inst("addi.w $t0, $zero, 0");
-        store_from_greg(context.inst, Reg::t(0));
-        append_inst(".exit"+std::to_string(context.num)+":",ASMInstruction::Label);
-        context.num++;
+    case Instruction::fne:
+        append_inst(MI::FCMP_SNE_S, {CFReg(0), lhs, rhs});
         break;
     default:
         assert(false);
     }
-    
+    auto dst = def_greg(context.inst, Reg::t(0));
+    append_inst(MI::MOVCF2GR, {dst, CFReg(0)});
+    store_from_greg(context.inst, dst);
 }
 
 void CodeGen::gen_zext() {
     // TODO 将窄位宽的整数数据进行零扩展
-    load_to_greg(context.inst->get_operand(0), Reg::t(0));
-    append_inst("bstrpick.w $t1, $t0, 0, 0");
-    store_from_greg(context.inst, Reg::t(1));
-    
+    auto src = use_greg(context.inst->get_operand(0), Reg::t(0));
+    auto dst = def_greg(context.inst, Reg::t(1));
+    append_inst(MI::BSTRPICK_W, {dst, src, imm(0), imm(0)});
+    store_from_greg(context.inst, dst);
+}
+
+/**
+ * @brief 判断调用能否作为尾调用翻译
+ *
+ * 要求调用之后紧跟 ret, 且没有实参指向当前栈帧中的数组,
+ * 因为跳转到被调用者之前当前栈帧就已经被释放。
+ */
+bool CodeGen::is_sibling_call(Instruction *inst) const {
+    if (not tail_call or not inst->is_call() or
+        not static_cast<CallInst *>(inst)->is_tail_call())
+        return false;
+    for (unsigned i = 1; i < inst->get_num_operand(); i++) {
+        auto *arg = inst->get_operand(i);
+        while (auto *gep = arg->dyn_cast<GetElementPtrInst>())
+            arg = gep->get_operand(0);
+        if (arg->is<AllocaInst>())
+            return false;
+    }
+    return true;
 }
 
 void CodeGen::gen_call() {
     // TODO 函数调用，注意我们只需要通过寄存器传递参数，即不需考虑栈上传参的情况
-    const std::vector<Value *> args=context.inst->get_operands();
-    for (int i=1;i<args.size();i++){
+    // 整数与浮点参数分别依次使用 $a* 与 $fa*
+    const auto &args=context.inst->get_operands();
+    int garg_cnt = 0;
+    int farg_cnt = 0;
+    for (unsigned i = 1; i < args.size(); i++) {
         if(args[i]->get_type()->is_float_type()){
-            load_to_freg(args[i],FReg::fa(i-1));
+            load_to_freg(args[i], FReg::fa(farg_cnt++));
         }
         else{
-            load_to_greg(args[i],Reg::a(i-1));
+            load_to_greg(args[i], Reg::a(garg_cnt++));
         }
         
     }
     auto *func=static_cast<Function *>(args[0]);
-    append_inst("bl "+func->get_name());
+    // 尾调用复用调用者的返回地址: 拆除当前栈帧后直接跳转
+    if (is_sibling_call(context.inst)) {
+        restore_frame();
+        append_inst(MI::B, {label(func->get_name())});
+        return;
+    }
+    append_inst(MI::BL, {label(func->get_name())});
     if (func->get_return_type()->is_float_type()){
         store_from_freg(context.inst, FReg::fa(0));
     }
@@ -607,186 +943,188 @@ void CodeGen::gen_call() {
 void CodeGen::gen_gep() {
     // TODO 计算内存地址
     auto *gep_inst=static_cast<GetElementPtrInst *>(context.inst);
-    if(context.inst->get_operands().size()==3){
-        load_to_greg(context.inst->get_operand(0),Reg::t(0));
-        load_to_greg(context.inst->get_operand(2),Reg::t(1));
-        auto size=ConstantInt::get(static_cast<int>(gep_inst->get_element_type()->get_size()),m);
-        load_to_greg(size,Reg::t(2));
-        append_inst("mul.w $t3,$t1,$t2");
-        append_inst("add.d $t3,$t0,$t3");
-        store_from_greg(context.inst,Reg::t(3));
-    }
-    else{
-        load_to_greg(context.inst->get_operand(0),Reg::t(0));
-        load_to_greg(context.inst->get_operand(1),Reg::t(1));
-        auto size=ConstantInt::get(static_cast<int>(gep_inst->get_element_type()->get_size()),m);
-        load_to_greg(size,Reg::t(2));
-        append_inst("mul.w $t3,$t1,$t2");
-        append_inst("add.d $t3,$t0,$t3");
-        store_from_greg(context.inst,Reg::t(3));
+    // 两种形式的 gep 都只有最后一个下标需要参与计算
+    auto *idx_val = gep_inst->get_operand(gep_inst->get_num_operand() - 1);
+    auto size = static_cast<int64_t>(gep_inst->get_element_type()->get_size());
+    auto shift = exact_log2(size);
+    auto base = use_greg(gep_inst->get_operand(0), Reg::t(0));
+    auto dst = def_greg(context.inst, Reg::t(2));
+
+    auto *constant = idx_val->dyn_cast<ConstantInt>();
+    if (constant and IS_IMM_12(constant->get_value() * size)) {
+        // 下标为常量, 偏移直接作为立即数
+        append_inst(MI::ADDI_D, {dst, base, imm(constant->get_value() * size)});
+    } else if (shift == 0) {
+        auto idx = use_greg(idx_val, Reg::t(1));
+        append_inst(MI::ADD_D, {dst, base, idx});
+    } else if (1 <= shift and shift <= 4) {
+        // dst = (idx << shift) + base
+        auto idx = use_greg(idx_val, Reg::t(1));
+        append_inst(MI::ALSL_D, {dst, idx, base, imm(shift)});
+    } else if (shift > 4) {
+        auto idx = use_greg(idx_val, Reg::t(1));
+        append_inst(MI::SLLI_D, {Reg::t(1), idx, imm(shift)});
+        append_inst(MI::ADD_D, {dst, base, Reg::t(1)});
+    } else {
+        auto idx = use_greg(idx_val, Reg::t(1));
+        load_to_greg(ConstantInt::get(static_cast<int>(size), m), Reg::t(2));
+        append_inst(MI::MUL_W, {Reg::t(2), idx, Reg::t(2)});
+        append_inst(MI::ADD_D, {dst, base, Reg::t(2)});
     }
+    store_from_greg(context.inst, dst);
 }
 
 void CodeGen::gen_sitofp() {
     // TODO 整数转向浮点数
-    load_to_greg(context.inst->get_operand(0),Reg::t(0));
-    append_inst("movgr2fr.w $ft0,$t0");
-    append_inst("ffint.s.w $ft1, $ft0");
-    store_from_freg(context.inst,FReg::ft(1));
+    auto src = use_greg(context.inst->get_operand(0), Reg::t(0));
+    auto dst = def_freg(context.inst, FReg::ft(1));
+    append_inst(MI::MOVGR2FR_W, {FReg::ft(0), src});
+    append_inst(MI::FFINT_S_W, {dst, FReg::ft(0)});
+    store_from_freg(context.inst, dst);
 }
 
 void CodeGen::gen_fptosi() {
     // TODO 浮点数转向整数，注意向下取整(round to zero)
-    load_to_freg(context.inst->get_operand(0),FReg::ft(0));
-    append_inst("ftintrz.w.s $ft1, $ft0");
-    append_inst("movfr2gr.s $t0,$ft1");
-    store_from_greg(context.inst,Reg::t(0));
+    auto src = use_freg(context.inst->get_operand(0), FReg::ft(0));
+    auto dst = def_greg(context.inst, Reg::t(0));
+    append_inst(MI::FTINTRZ_W_S, {FReg::ft(1), src});
+    append_inst(MI::MOVFR2GR_S, {dst, FReg::ft(1)});
+    store_from_greg(context.inst, dst);
 }
 
 void CodeGen::run() {
+    // phi 拷贝需要放在关键边上, 先拆分关键边
+    for (auto &func : m->get_functions())
+        split_critical_edges(&func);
     // 确保每个函数中基本块的名字都被设置好
     m->set_print_name();
 
-    /* 使用 GNU 伪指令为全局变量分配空间
+    /* 为全局变量分配空间, 具体的伪指令由 AsmPrinter 生成
      * 你可以使用 `la.local` 指令将标签 (全局变量) 的地址载入寄存器中, 比如
      * 要将 `a` 的地址载入 $t0, 只需要 `la.local $t0, a`
      */
-    if (!m->get_global_variable().empty()) {
-        append_inst("Global variables", ASMInstruction::Comment);
-        /* 虽然下面两条伪指令可以简化为一条 `.bss` 伪指令, 但是我们还是选择使用
-         * `.section` 将全局变量放到可执行文件的 BSS 段, 原因如下:
-         * - 尽可能对齐交叉编译器 loongarch64-unknown-linux-gnu-gcc 的行为
-         * - 支持更旧版本的 GNU 汇编器, 因为 `.bss` 伪指令是应该相对较新的指令,
-         *   GNU 汇编器在 2023 年 2 月的 2.37 版本才将其引入
-         */
-        append_inst(".text", ASMInstruction::Atrribute);
-        append_inst(".section", {".bss", "\"aw\"", "@nobits"},
-                    ASMInstruction::Atrribute);
-        for (auto &global : m->get_global_variable()) {
-            auto size =
-                global.get_type()->get_pointer_element_type()->get_size();
-            append_inst(".globl", {global.get_name()},
-                        ASMInstruction::Atrribute);
-            append_inst(".type", {global.get_name(), "@object"},
-                        ASMInstruction::Atrribute);
-            append_inst(".size", {global.get_name(), std::to_string(size)},
-                        ASMInstruction::Atrribute);
-            append_inst(global.get_name(), ASMInstruction::Label);
-            append_inst(".space", {std::to_string(size)},
-                        ASMInstruction::Atrribute);
-        }
+    for (auto &global : m->get_global_variable()) {
+        auto size = global.get_type()->get_pointer_element_type()->get_size();
+        mmodule.add_global(global.get_name(), size);
     }
 
-    // 函数代码段
-    output.emplace_back(".text", ASMInstruction::Atrribute);
+    // 函数代码段: 先按顺序创建机器函数, 之后各函数的代码可以独立生成
+    std::vector<std::pair<Function *, MachineFunction *>> funcs;
     for (auto &func : m->get_functions()) {
-        if (not func.is_declaration()) {
-            // 更新 context
-            context.clear();
-            context.func = &func;
-
-            // 函数信息
-            append_inst(".globl", {func.get_name()}, ASMInstruction::Atrribute);
-            append_inst(".type", {func.get_name(), "@function"},
-                        ASMInstruction::Atrribute);
-            append_inst(func.get_name(), ASMInstruction::Label);
-
-            // 分配函数栈帧
-            allocate();
-            // 生成 prologue
-            gen_prologue();
-
-            for (auto &bb : func.get_basic_blocks()) {
-                context.bb = &bb;
-                append_inst(label_name(context.bb), ASMInstruction::Label);
-                for (auto &instr : bb.get_instructions()) {
-                    // For debug
-                    append_inst(instr.print(), ASMInstruction::Comment);
-                    context.inst = &instr; // 更新 context
-                    switch (instr.get_instr_type()) {
-                    case Instruction::ret:
-                        gen_ret();
-                        break;
-                    case Instruction::br:
-                        copy_stmt();
-                        gen_br();
-                        break;
-                    case Instruction::add:
-                    case Instruction::sub:
-                    case Instruction::mul:
-                    case Instruction::sdiv:
-                        gen_binary();
-                        break;
-                    case Instruction::fadd:
-                    case Instruction::fsub:
-                    case Instruction::fmul:
-                    case Instruction::fdiv:
-                        gen_float_binary();
-                        break;
-                    case Instruction::alloca:
-                        /* 对于 alloca 指令，我们已经为 alloca
-                         * 的内容分配空间，在此我们还需保存 alloca
-                         * 指令自身产生的定值，即指向 alloca 空间起始地址的指针
-                         */
-                        gen_alloca();
-                        break;
-                    case Instruction::load:
-                        gen_load();
-                        break;
-                    case Instruction::store:
-                        gen_store();
-                        break;
-                    case Instruction::ge:
-                    case Instruction::gt:
-                    case Instruction::le:
-                    case Instruction::lt:
-                    case Instruction::eq:
-                    case Instruction::ne:
-                        gen_icmp();
-                        break;
-                    case Instruction::fge:
-                    case Instruction::fgt:
-                    case Instruction::fle:
-                    case Instruction::flt:
-                    case Instruction::feq:
-                    case Instruction::fne:
-                        gen_fcmp();
-                        break;
-                    case Instruction::phi:
-                        /* for phi, just convert to a series of
-                         * copy-stmts */
-                        /* we can collect all phi and deal them at
-                         * the end */
-                        break;
-                    case Instruction::call:
-                        gen_call();
-                        break;
-                    case Instruction::getelementptr:
-                        gen_gep();
-                        break;
-                    case Instruction::zext:
-                        gen_zext();
-                        break;
-                    case Instruction::fptosi:
-                        gen_fptosi();
-                        break;
-                    case Instruction::sitofp:
-                        gen_sitofp();
-                        break;
-                    }
-                }
-            }
-            // 生成 epilogue
-            append_inst(func_exit_label_name(context.func), ASMInstruction::Label);
-            gen_epilogue();
-        }
+        if (not func.is_declaration())
+            funcs.emplace_back(&func, mmodule.create_function(&func));
+    }
+    if (pool == nullptr or pool->get_num_threads() == 1) {
+        for (auto [func, mfunc] : funcs)
+            gen_function(func, mfunc);
+        return;
     }
+    // 0 号线程使用本对象, 其余线程各用一个 CodeGen 维护自己的 context 与寄存器分配
+    std::vector<std::unique_ptr<CodeGen>> workers;
+    for (unsigned i = 1; i < pool->get_num_threads(); ++i)
+        workers.push_back(
+            std::make_unique<CodeGen>(m, regalloc_kind, tail_call));
+    pool->parallel_for(funcs.size(), [&](std::size_t idx, unsigned worker) {
+        auto *codegen = worker == 0 ? this : workers[worker - 1].get();
+        codegen->gen_function(funcs[idx].first, funcs[idx].second);
+    });
 }
 
-std::string CodeGen::print() const {
-    std::string result;
-    for (const auto &inst : output) {
-        result += inst.format();
+void CodeGen::gen_function(Function *func, MachineFunction *mfunc) {
+    // 更新 context
+    context.clear();
+    context.func = func;
+    context.mfunc = mfunc;
+    context.mbb = context.mfunc->create_block(func->get_name());
+
+    // 分配函数栈帧
+    allocate();
+    // 生成 prologue
+    gen_prologue();
+
+    for (auto &bb : func->get_basic_blocks()) {
+        context.bb = &bb;
+        context.mbb = context.mfunc->create_block(label_name(context.bb), &bb);
+        for (auto &instr : bb.get_instructions()) {
+            // For debug
+            append_comment(instr.print());
+            context.inst = &instr; // 更新 context
+            // 与 br 融合的比较链在 gen_br 中一并翻译
+            if (is_fused_into_br(&instr))
+                continue;
+            switch (instr.get_instr_type()) {
+            case Instruction::ret:
+                gen_ret();
+                break;
+            case Instruction::br:
+                copy_stmt();
+                gen_br();
+                break;
+            case Instruction::add:
+            case Instruction::sub:
+            case Instruction::mul:
+            case Instruction::sdiv:
+                gen_binary();
+                break;
+            case Instruction::fadd:
+            case Instruction::fsub:
+            case Instruction::fmul:
+            case Instruction::fdiv:
+                gen_float_binary();
+                break;
+            case Instruction::alloca:
+                /* 对于 alloca 指令，我们已经为 alloca
+                 * 的内容分配空间，在此我们还需保存 alloca
+                 * 指令自身产生的定值，即指向 alloca 空间起始地址的指针
+                 */
+                gen_alloca();
+                break;
+            case Instruction::load:
+                gen_load();
+                break;
+            case Instruction::store:
+                gen_store();
+                break;
+            case Instruction::ge:
+            case Instruction::gt:
+            case Instruction::le:
+            case Instruction::lt:
+            case Instruction::eq:
+            case Instruction::ne:
+                gen_icmp();
+                break;
+            case Instruction::fge:
+            case Instruction::fgt:
+            case Instruction::fle:
+            case Instruction::flt:
+            case Instruction::feq:
+            case Instruction::fne:
+                gen_fcmp();
+                break;
+            case Instruction::phi:
+                /* for phi, just convert to a series of
+                 * copy-stmts */
+                /* we can collect all phi and deal them at
+                 * the end */
+                break;
+            case Instruction::call:
+                gen_call();
+                break;
+            case Instruction::getelementptr:
+                gen_gep();
+                break;
+            case Instruction::zext:
+                gen_zext();
+                break;
+            case Instruction::fptosi:
+                gen_fptosi();
+                break;
+            case Instruction::sitofp:
+                gen_sitofp();
+                break;
+            }
+        }
     }
-    return result;
 }
+
+std::string CodeGen::print() const { return AsmPrinter(mmodule).print(); }
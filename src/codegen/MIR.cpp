@@ -0,0 +1,236 @@
+#include "MIR.hpp"
+
+#include <cassert>
+
+bool MachineOperand::operator==(const MachineOperand &other) const {
+    if (kind_ != other.kind_)
+        return false;
+    switch (kind_) {
+    case GRegKind:
+    case FRegKind:
+    case CFRegKind:
+        return reg_ == other.reg_;
+    case ImmKind:
+        return imm_ == other.imm_;
+    case LabelKind:
+        return label_ == other.label_;
+    }
+    assert(false && "unreachable");
+}
+
+std::string MachineOperand::print() const {
+    switch (kind_) {
+    case GRegKind:
+        return get_greg().print();
+    case FRegKind:
+        return get_freg().print();
+    case CFRegKind:
+        return get_cfreg().print();
+    case ImmKind:
+        return std::to_string(imm_);
+    case LabelKind:
+        return label_;
+    }
+    assert(false && "unreachable");
+}
+
+std::string MachineInstr::get_opcode_name(OpID op) {
+    switch (op) {
+    case ADD_W:
+        return "add.w";
+    case ADD_D:
+        return "add.d";
+    case SUB_W:
+        return "sub.w";
+    case SUB_D:
+        return "sub.d";
+    case MUL_W:
+        return "mul.w";
+    case MULH_W:
+        return "mulh.w";
+    case DIV_W:
+        return "div.w";
+    case ADDI_W:
+        return "addi.w";
+    case ADDI_D:
+        return "addi.d";
+    case ALSL_W:
+        return "alsl.w";
+    case ALSL_D:
+        return "alsl.d";
+    case SLLI_W:
+        return "slli.w";
+    case SLLI_D:
+        return "slli.d";
+    case SRLI_W:
+        return "srli.w";
+    case SRAI_W:
+        return "srai.w";
+    case ORI:
+        return "ori";
+    case XOR:
+        return "xor";
+    case XORI:
+        return "xori";
+    case SLT:
+        return "slt";
+    case SLTU:
+        return "sltu";
+    case SLTUI:
+        return "sltui";
+    case BSTRPICK_W:
+        return "bstrpick.w";
+    case BSTRPICK_D:
+        return "bstrpick.d";
+    case MOVE:
+        return "move";
+    case LU12I_W:
+        return "lu12i.w";
+    case LU32I_D:
+        return "lu32i.d";
+    case LU52I_D:
+        return "lu52i.d";
+    case LD_B:
+        return "ld.b";
+    case LD_W:
+        return "ld.w";
+    case LD_D:
+        return "ld.d";
+    case ST_B:
+        return "st.b";
+    case ST_W:
+        return "st.w";
+    case ST_D:
+        return "st.d";
+    case FLD_S:
+        return "fld.s";
+    case FLD_D:
+        return "fld.d";
+    case FST_S:
+        return "fst.s";
+    case FST_D:
+        return "fst.d";
+    case FADD_S:
+        return "fadd.s";
+    case FSUB_S:
+        return "fsub.s";
+    case FMUL_S:
+        return "fmul.s";
+    case FDIV_S:
+        return "fdiv.s";
+    case FMOV_S:
+        return "fmov.s";
+    case FCMP_SLT_S:
+        return "fcmp.slt.s";
+    case FCMP_SLE_S:
+        return "fcmp.sle.s";
+    case FCMP_SEQ_S:
+        return "fcmp.seq.s";
+    case FCMP_SNE_S:
+        return "fcmp.sne.s";
+    case FFINT_S_W:
+        return "ffint.s.w";
+    case FTINTRZ_W_S:
+        return "ftintrz.w.s";
+    case MOVGR2FR_W:
+        return "movgr2fr.w";
+    case MOVFR2GR_S:
+        return "movfr2gr.s";
+    case MOVCF2GR:
+        return "movcf2gr";
+    case LA_LOCAL:
+        return "la.local";
+    case B:
+        return "b";
+    case BNEZ:
+        return "bnez";
+    case BEQ:
+        return "beq";
+    case BNE:
+        return "bne";
+    case BLT:
+        return "blt";
+    case BGE:
+        return "bge";
+    case BCNEZ:
+        return "bcnez";
+    case BL:
+        return "bl";
+    case JR:
+        return "jr";
+    case COMMENT:
+        return "#";
+    }
+    assert(false && "unreachable");
+}
+
+bool MachineInstr::is_load() const {
+    switch (op_id_) {
+    case LD_B:
+    case LD_W:
+    case LD_D:
+    case FLD_S:
+    case FLD_D:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool MachineInstr::is_store() const {
+    switch (op_id_) {
+    case ST_B:
+    case ST_W:
+    case ST_D:
+    case FST_S:
+    case FST_D:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool MachineInstr::is_terminator() const {
+    switch (op_id_) {
+    case B:
+    case BNEZ:
+    case BEQ:
+    case BNE:
+    case BLT:
+    case BGE:
+    case BCNEZ:
+    case JR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool MachineInstr::has_def() const {
+    if (is_store() or is_comment() or is_call() or is_terminator())
+        return false;
+    return not operands_.empty() and not operands_[0].is_imm() and
+           not operands_[0].is_label();
+}
+
+std::vector<MachineOperand> MachineInstr::get_uses() const {
+    std::vector<MachineOperand> uses;
+    if (is_comment())
+        return uses;
+    for (unsigned i = has_def() ? 1 : 0; i < operands_.size(); i++) {
+        if (not operands_[i].is_imm() and not operands_[i].is_label())
+            uses.push_back(operands_[i]);
+    }
+    return uses;
+}
+
+std::string MachineInstr::print() const {
+    if (is_comment())
+        return "# " + operands_.at(0).get_label();
+    auto content = get_opcode_name(op_id_);
+    for (unsigned i = 0; i < operands_.size(); i++) {
+        content += i == 0 ? " " : ", ";
+        content += operands_[i].print();
+    }
+    return content;
+}
@@ -0,0 +1,221 @@
+#include "Peephole.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using MI = MachineInstr;
+
+namespace {
+
+// 访存宽度 (字节)
+unsigned access_size(MI::OpID op) {
+    switch (op) {
+    case MI::LD_B:
+    case MI::ST_B:
+        return 1;
+    case MI::LD_W:
+    case MI::ST_W:
+    case MI::FLD_S:
+    case MI::FST_S:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+// 与 store 对应的 load, 二者读写的数据格式完全一致
+MI::OpID matching_load(MI::OpID store) {
+    switch (store) {
+    case MI::ST_B:
+        return MI::LD_B;
+    case MI::ST_W:
+        return MI::LD_W;
+    case MI::ST_D:
+        return MI::LD_D;
+    case MI::FST_S:
+        return MI::FLD_S;
+    case MI::FST_D:
+        return MI::FLD_D;
+    default:
+        return store;
+    }
+}
+
+/* CodeGen 只在单条 IR 指令的翻译过程中使用的临时寄存器,
+ * 它们的值不会跨越基本块 */
+bool is_scratch(const MachineOperand &op) {
+    if (not op.is_greg())
+        return false;
+    auto reg = op.get_greg();
+    return reg == Reg::t(0) or reg == Reg::t(1) or reg == Reg::t(2) or
+           reg == Reg::t(8);
+}
+
+bool is_zero_remat(const MachineInstr &inst) {
+    return inst.get_opcode() == MI::ADDI_W and
+           inst.get_operand(1) == MachineOperand(Reg::zero());
+}
+
+} // namespace
+
+void Peephole::run(MachineModule &module) {
+    for (auto &func : module.get_functions())
+        run(func);
+}
+
+void Peephole::run(MachineFunction &func) {
+    for (auto &mbb : func.get_blocks()) {
+        forward_stores(mbb);
+        remove_remats(mbb);
+    }
+}
+
+/**
+ * @brief store 到 load 的转发
+ *
+ * 记录块内每条 store 写入的地址 (基址寄存器 + 偏移) 与来源寄存器,
+ * 之后读取同一地址且格式相同的 load 直接使用来源寄存器。
+ * 以 $fp 为基址的是定值的栈上位置, 不会被指针访问, 只与重叠的 $fp 访存冲突;
+ * 其余 store 可能写入任意地址, 会使其它非 $fp 记录失效。
+ */
+void Peephole::forward_stores(MachineBasicBlock &mbb) {
+    struct Avail {
+        MachineOperand base;
+        int64_t offset;
+        MI::OpID store;
+        MachineOperand src;
+    };
+    std::vector<Avail> avail;
+    const MachineOperand fp(Reg::fp());
+
+    auto overlap = [](const Avail &entry, int64_t offset, unsigned size) {
+        auto entry_size = access_size(entry.store);
+        return entry.offset < offset + size and
+               offset < entry.offset + entry_size;
+    };
+
+    auto &instrs = mbb.get_instrs();
+    for (auto it = instrs.begin(); it != instrs.end();) {
+        auto &inst = *it;
+        if (inst.is_comment()) {
+            ++it;
+            continue;
+        }
+
+        if (inst.is_load()) {
+            auto &dst = inst.get_operand(0);
+            auto &base = inst.get_operand(1);
+            auto offset = inst.get_operand(2).get_imm();
+            auto match = std::find_if(
+                avail.begin(), avail.end(), [&](const Avail &entry) {
+                    return entry.base == base and entry.offset == offset and
+                           matching_load(entry.store) == inst.get_opcode();
+                });
+            // 双精度的浮点访存只用于备份被调用者保存寄存器, 不做转发
+            if (match != avail.end() and match->store != MI::FST_D) {
+                if (match->src == dst) {
+                    counters_["reload-removed"]++;
+                    it = instrs.erase(it);
+                    continue;
+                }
+                // 64 位通用寄存器中的 i1/i32 始终保持符号扩展, move 与 load 等价
+                auto op = dst.is_freg() ? MI::FMOV_S : MI::MOVE;
+                inst = MachineInstr(op, {dst, match->src});
+                counters_["load-forwarded"]++;
+            }
+        }
+
+        if (inst.is_store()) {
+            auto &base = inst.get_operand(1);
+            auto offset = inst.get_operand(2).get_imm();
+            auto size = access_size(inst.get_opcode());
+            avail.erase(std::remove_if(avail.begin(), avail.end(),
+                                       [&](const Avail &entry) {
+                                           if (base != fp)
+                                               return entry.base != fp;
+                                           return entry.base == fp and
+                                                  overlap(entry, offset, size);
+                                       }),
+                        avail.end());
+            avail.push_back(
+                {base, offset, inst.get_opcode(), inst.get_operand(0)});
+        } else if (inst.is_call()) {
+            // 被调用者可能修改内存与调用者保存寄存器
+            avail.clear();
+        } else if (inst.has_def()) {
+            auto &def = inst.get_def();
+            avail.erase(std::remove_if(avail.begin(), avail.end(),
+                                       [&](const Avail &entry) {
+                                           return entry.base == def or
+                                                  entry.src == def;
+                                       }),
+                        avail.end());
+        }
+        ++it;
+    }
+}
+
+void Peephole::remove_remats(MachineBasicBlock &mbb) {
+    auto &instrs = mbb.get_instrs();
+
+    // 寄存器中已有相同的常量
+    std::vector<std::pair<MachineOperand, int64_t>> consts;
+    auto forget = [&](const MachineOperand &reg) {
+        consts.erase(std::remove_if(consts.begin(), consts.end(),
+                                    [&](auto &entry) {
+                                        return entry.first == reg;
+                                    }),
+                     consts.end());
+    };
+    for (auto it = instrs.begin(); it != instrs.end();) {
+        auto &inst = *it;
+        if (inst.is_call()) {
+            consts.clear();
+        } else if (is_zero_remat(inst)) {
+            auto &dst = inst.get_operand(0);
+            auto val = inst.get_operand(2).get_imm();
+            auto known = std::find_if(consts.begin(), consts.end(),
+                                      [&](auto &entry) {
+                                          return entry.first == dst;
+                                      });
+            if (known != consts.end() and known->second == val) {
+                counters_["remat-removed"]++;
+                it = instrs.erase(it);
+                continue;
+            }
+            forget(dst);
+            consts.emplace_back(dst, val);
+        } else if (inst.has_def()) {
+            forget(inst.get_def());
+        }
+        ++it;
+    }
+
+    // 被覆盖前未被读取的临时寄存器常量, 块末尾所有临时寄存器都不再活跃
+    std::vector<MachineOperand> dead = {Reg::t(0), Reg::t(1), Reg::t(2),
+                                        Reg::t(8)};
+    auto is_dead = [&](const MachineOperand &reg) {
+        return std::find(dead.begin(), dead.end(), reg) != dead.end();
+    };
+    for (auto it = instrs.end(); it != instrs.begin();) {
+        --it;
+        auto &inst = *it;
+        if (inst.is_comment())
+            continue;
+        if (is_zero_remat(inst) and is_dead(inst.get_operand(0))) {
+            counters_["remat-removed"]++;
+            it = instrs.erase(it);
+            continue;
+        }
+        if (inst.is_call()) {
+            dead = {Reg::t(0), Reg::t(1), Reg::t(2), Reg::t(8)};
+            continue;
+        }
+        if (inst.has_def() and is_scratch(inst.get_def()) and
+            not is_dead(inst.get_def()))
+            dead.push_back(inst.get_def());
+        for (auto &use : inst.get_uses()) {
+            dead.erase(std::remove(dead.begin(), dead.end(), use), dead.end());
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include "PhiElimination.hpp"
+
+#include "BasicBlock.hpp"
+#include "Instruction.hpp"
+
+#include <vector>
+
+namespace {
+
+bool has_phi(BasicBlock *bb) {
+    return not bb->empty() and bb->get_instructions().front().is_phi();
+}
+
+/**
+ * @brief 在 pred 的第 idx 个跳转目标 succ 之前插入新块
+ *
+ * 新块紧跟在 pred 之后, 只含 `br succ`; succ 中 phi 来自 pred 的入边改为来自新块。
+ */
+void split_edge(BasicBlock *pred, unsigned idx, BasicBlock *succ) {
+    auto *func = pred->get_parent();
+    auto *mid = BasicBlock::create(func->get_parent(), "", func);
+    auto &bbs = func->get_basic_blocks();
+    bbs.remove(mid);
+    bbs.insert(std::next(pred->getIterator()), mid);
+
+    auto *br = pred->get_terminator();
+    br->set_operand(idx, mid);
+    pred->remove_succ_basic_block(succ);
+    pred->add_succ_basic_block(mid);
+    succ->remove_pre_basic_block(pred);
+    mid->add_pre_basic_block(pred);
+    BranchInst::create_br(succ, mid);
+
+    for (auto &inst : succ->get_instructions()) {
+        if (not inst.is_phi())
+            break;
+        for (unsigned i = 1; i < inst.get_num_operand(); i += 2) {
+            if (inst.get_operand(i) == pred)
+                inst.set_operand(i, mid);
+        }
+    }
+}
+
+} // namespace
+
+void split_critical_edges(Function *func) {
+    std::vector<BasicBlock *> preds;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (bb.get_succ_basic_blocks().size() > 1)
+            preds.push_back(&bb);
+    }
+    for (auto *pred : preds) {
+        auto *br = pred->get_terminator();
+        if (not br->is_br() or
+            not static_cast<BranchInst *>(br)->is_cond_br())
+            continue;
+        auto *truebb = static_cast<BasicBlock *>(br->get_operand(1));
+        auto *falsebb = static_cast<BasicBlock *>(br->get_operand(2));
+        // 两个目标相同时拷贝在两条路径上都需要执行, 无需拆分
+        if (truebb == falsebb)
+            continue;
+        if (has_phi(truebb))
+            split_edge(pred, 1, truebb);
+        if (has_phi(falsebb))
+            split_edge(pred, 2, falsebb);
+    }
+}
@@ -0,0 +1,737 @@
+#include "RegAlloc.hpp"
+
+#include "BasicBlock.hpp"
+#include "BranchFusion.hpp"
+#include "Instruction.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <climits>
+
+const std::vector<unsigned> &RegAlloc::caller_saved_gregs() {
+    static const std::vector<unsigned> regs = {
+        Reg::t(3).id, Reg::t(4).id, Reg::t(5).id, Reg::t(6).id, Reg::t(7).id};
+    return regs;
+}
+
+const std::vector<unsigned> &RegAlloc::callee_saved_gregs() {
+    static const std::vector<unsigned> regs = [] {
+        std::vector<unsigned> res;
+        for (unsigned i = 0; i <= 8; i++)
+            res.push_back(Reg::s(i).id);
+        return res;
+    }();
+    return regs;
+}
+
+const std::vector<unsigned> &RegAlloc::caller_saved_fregs() {
+    static const std::vector<unsigned> regs = [] {
+        std::vector<unsigned> res;
+        for (unsigned i = 3; i <= 15; i++)
+            res.push_back(FReg::ft(i).id);
+        return res;
+    }();
+    return regs;
+}
+
+const std::vector<unsigned> &RegAlloc::callee_saved_fregs() {
+    static const std::vector<unsigned> regs = [] {
+        std::vector<unsigned> res;
+        for (unsigned i = 0; i <= 7; i++)
+            res.push_back(FReg::fs(i).id);
+        return res;
+    }();
+    return regs;
+}
+
+bool RegAlloc::is_callee_saved_greg(unsigned id) {
+    auto &regs = callee_saved_gregs();
+    return std::find(regs.begin(), regs.end(), id) != regs.end();
+}
+
+bool RegAlloc::is_callee_saved_freg(unsigned id) {
+    auto &regs = callee_saved_fregs();
+    return std::find(regs.begin(), regs.end(), id) != regs.end();
+}
+
+bool RegAlloc::is_allocatable(Value *val) {
+    if (auto *inst = val->dyn_cast<Instruction>())
+        return not inst->is_void() and not is_fused_into_br(inst);
+    return val->is<Argument>();
+}
+
+std::vector<Value *> RegAlloc::get_operands(Instruction *inst) {
+    if (inst->is_br()) {
+        auto chain = get_fused_cmp_chain(inst->get_parent());
+        if (not chain.empty()) {
+            auto &ops = chain.back()->get_operands();
+            return {ops.begin(), ops.end()};
+        }
+    } else if (is_fused_into_br(inst)) {
+        return {};
+    }
+    auto &ops = inst->get_operands();
+    return {ops.begin(), ops.end()};
+}
+
+void RegAlloc::run(Function *func) {
+    inst_pos_.clear();
+    bb_range_.clear();
+    call_pos_.clear();
+    live_in_.clear();
+    live_out_.clear();
+    greg_map_.clear();
+    freg_map_.clear();
+    used_callee_gregs_.clear();
+    used_callee_fregs_.clear();
+    spill_alias_.clear();
+    spill_count_ = 0;
+
+    compute_liveness(func);
+    allocate(func);
+    LOG_DEBUG << func->get_name() << ": " << greg_map_.size() << " gregs, "
+              << freg_map_.size() << " fregs, " << spill_count_ << " spills";
+}
+
+void RegAlloc::assign(Value *val, unsigned reg) {
+    if (is_float(val)) {
+        freg_map_.emplace(val, reg);
+        if (is_callee_saved_freg(reg))
+            used_callee_fregs_.insert(reg);
+    } else {
+        greg_map_.emplace(val, reg);
+        if (is_callee_saved_greg(reg))
+            used_callee_gregs_.insert(reg);
+    }
+}
+
+/**
+ * @brief 计算每个基本块入口与出口处的活跃定值
+ *
+ * phi 的操作数视作在对应前驱块末尾被使用, 因此只在该前驱块的出口活跃;
+ * phi 自身视作在其所在块内定值, 不会出现在该块的入口活跃集合中。
+ */
+void RegAlloc::compute_liveness(Function *func) {
+    int idx = 0;
+    for (auto &bb : func->get_basic_blocks()) {
+        int first = 2 * idx;
+        for (auto &inst : bb.get_instructions()) {
+            inst_pos_[&inst] = 2 * idx;
+            if (inst.is_call())
+                call_pos_.push_back(2 * idx);
+            idx++;
+        }
+        bb_range_[&bb] = {first, 2 * idx - 1};
+    }
+
+    std::map<BasicBlock *, std::set<Value *>> use, def, phi_use;
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (inst.is_phi()) {
+                auto *phi = static_cast<PhiInst *>(&inst);
+                for (auto &[val, pre] : phi->get_phi_pairs()) {
+                    if (is_allocatable(val))
+                        phi_use[pre].insert(val);
+                }
+            } else {
+                for (auto *op : get_operands(&inst)) {
+                    if (is_allocatable(op) and not def[&bb].count(op))
+                        use[&bb].insert(op);
+                }
+            }
+            if (is_allocatable(&inst))
+                def[&bb].insert(&inst);
+        }
+    }
+
+    std::vector<BasicBlock *> order;
+    for (auto &bb : func->get_basic_blocks())
+        order.push_back(&bb);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            auto *bb = *it;
+            std::set<Value *> out = phi_use[bb];
+            for (auto *succ : bb->get_succ_basic_blocks())
+                out.insert(live_in_[succ].begin(), live_in_[succ].end());
+            std::set<Value *> in = use[bb];
+            for (auto *val : out) {
+                if (not def[bb].count(val))
+                    in.insert(val);
+            }
+            if (in != live_in_[bb] or out != live_out_[bb]) {
+                live_in_[bb] = std::move(in);
+                live_out_[bb] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+}
+
+void LinearScan::allocate(Function *func) {
+    intervals_.clear();
+    build_intervals(func);
+    scan(false);
+    scan(true);
+}
+
+void LinearScan::build_intervals(Function *func) {
+    auto extend = [&](Value *val, int pos) {
+        auto iter = intervals_.find(val);
+        if (iter == intervals_.end()) {
+            intervals_.emplace(val, Interval{val, pos, pos, false});
+        } else {
+            iter->second.start = std::min(iter->second.start, pos);
+            iter->second.end = std::max(iter->second.end, pos);
+        }
+    };
+
+    // 参数在进入函数时即已定值
+    for (auto &arg : func->get_args())
+        extend(&arg, -1);
+
+    for (auto &bb : func->get_basic_blocks()) {
+        auto [first, last] = bb_range_.at(&bb);
+        for (auto *val : live_in_[&bb])
+            extend(val, first);
+        for (auto *val : live_out_[&bb])
+            extend(val, last);
+        for (auto &inst : bb.get_instructions()) {
+            int pos = inst_pos_.at(&inst);
+            if (not inst.is_phi()) {
+                for (auto *op : get_operands(&inst)) {
+                    if (is_allocatable(op))
+                        extend(op, pos);
+                }
+            }
+            if (is_allocatable(&inst))
+                extend(&inst, pos + 1);
+        }
+        // phi 的拷贝在前驱块的终结指令处进行, 与终结指令的操作数同时活跃
+        int term_pos = inst_pos_.at(bb.get_terminator());
+        for (auto *succ : bb.get_succ_basic_blocks()) {
+            for (auto &inst : succ->get_instructions()) {
+                if (not inst.is_phi())
+                    break;
+                extend(&inst, term_pos);
+                extend(&inst, last);
+            }
+        }
+    }
+
+    for (auto &[val, interval] : intervals_) {
+        for (auto pos : call_pos_) {
+            if (interval.start <= pos and pos < interval.end) {
+                interval.cross_call = true;
+                break;
+            }
+        }
+    }
+}
+
+void LinearScan::scan(bool is_float) {
+    // 参数排在最前, 其余按定值位置排序, 保证分配结果与指针地址无关
+    auto def_order = [&](Interval *interval) -> long {
+        if (auto *arg = interval->val->dyn_cast<Argument>())
+            return static_cast<long>(arg->get_arg_no()) - INT_MAX;
+        return inst_pos_.at(static_cast<Instruction *>(interval->val));
+    };
+    std::vector<Interval *> unhandled;
+    for (auto &[val, interval] : intervals_) {
+        if (RegAlloc::is_float(val) == is_float)
+            unhandled.push_back(&interval);
+    }
+    std::sort(unhandled.begin(), unhandled.end(),
+              [&](Interval *lhs, Interval *rhs) {
+                  if (lhs->start != rhs->start)
+                      return lhs->start < rhs->start;
+                  return def_order(lhs) < def_order(rhs);
+              });
+
+    auto &caller = is_float ? caller_saved_fregs() : caller_saved_gregs();
+    auto &callee = is_float ? callee_saved_fregs() : callee_saved_gregs();
+    std::set<unsigned> free_caller(caller.begin(), caller.end());
+    std::set<unsigned> free_callee(callee.begin(), callee.end());
+
+    std::vector<Interval *> active; // 按 end 升序
+    std::map<Interval *, unsigned> reg_of;
+    auto add_active = [&](Interval *interval) {
+        auto pos = std::upper_bound(active.begin(), active.end(), interval,
+                                    [](Interval *lhs, Interval *rhs) {
+                                        return lhs->end < rhs->end;
+                                    });
+        active.insert(pos, interval);
+    };
+
+    for (auto *cur : unhandled) {
+        // 释放已经结束的区间所占的寄存器
+        while (not active.empty() and active.front()->end < cur->start) {
+            auto reg = reg_of.at(active.front());
+            if (std::find(callee.begin(), callee.end(), reg) != callee.end())
+                free_callee.insert(reg);
+            else
+                free_caller.insert(reg);
+            active.erase(active.begin());
+        }
+
+        if (not cur->cross_call and not free_caller.empty()) {
+            reg_of[cur] = *free_caller.begin();
+            free_caller.erase(free_caller.begin());
+            add_active(cur);
+        } else if (not free_callee.empty()) {
+            reg_of[cur] = *free_callee.begin();
+            free_callee.erase(free_callee.begin());
+            add_active(cur);
+        } else {
+            spill_at_interval(cur, active, reg_of);
+        }
+    }
+
+    for (auto &[interval, reg] : reg_of)
+        assign(interval->val, reg);
+}
+
+/**
+ * @brief 寄存器不足时选择溢出的区间
+ *
+ * 在可以让出寄存器的活跃区间中选择结束最晚的一个,
+ * 若它比当前区间结束得更晚, 则溢出它并把寄存器交给当前区间, 否则溢出当前区间。
+ * 跨越 call 的区间只能接收被调用者保存寄存器。
+ */
+void LinearScan::spill_at_interval(Interval *cur,
+                                   std::vector<Interval *> &active,
+                                   std::map<Interval *, unsigned> &reg_of) {
+    auto &callee = RegAlloc::is_float(cur->val) ? callee_saved_fregs()
+                                                : callee_saved_gregs();
+    auto victim = active.rend();
+    for (auto it = active.rbegin(); it != active.rend(); ++it) {
+        auto reg = reg_of.at(*it);
+        if (cur->cross_call and
+            std::find(callee.begin(), callee.end(), reg) == callee.end())
+            continue;
+        victim = it;
+        break;
+    }
+    spill_count_++;
+    if (victim == active.rend() or (*victim)->end <= cur->end)
+        return;
+
+    auto *spilled = *victim;
+    reg_of[cur] = reg_of.at(spilled);
+    reg_of.erase(spilled);
+    active.erase(std::next(victim).base());
+    auto pos = std::upper_bound(active.begin(), active.end(), cur,
+                                [](Interval *lhs, Interval *rhs) {
+                                    return lhs->end < rhs->end;
+                                });
+    active.insert(pos, cur);
+}
+
+void GraphColoring::allocate(Function *func) {
+    build_graph(func);
+    color(false);
+    color(true);
+}
+
+void GraphColoring::add_edge(int u, int v) {
+    if (u == v or adj_[u].count(v))
+        return;
+    if (is_float(nodes_[u]) != is_float(nodes_[v]))
+        return;
+    adj_[u].insert(v);
+    adj_[v].insert(u);
+    degree_[u]++;
+    degree_[v]++;
+}
+
+/**
+ * @brief 建立冲突图
+ *
+ * 在每个基本块内自底向上扫描活跃集合。phi 拷贝在前驱块的终结指令之前并行进行,
+ * 因此后继块的 phi 定值只与其余 phi 以及拷贝之后仍然活跃的定值冲突,
+ * 只在拷贝处被读取的来源 (包括其余 phi 的来源) 都可以与它共用寄存器。
+ */
+void GraphColoring::build_graph(Function *func) {
+    nodes_.clear();
+    node_id_.clear();
+    moves_.clear();
+    auto add_node = [&](Value *val) {
+        node_id_[val] = static_cast<int>(nodes_.size());
+        nodes_.push_back(val);
+    };
+    for (auto &arg : func->get_args())
+        add_node(&arg);
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (is_allocatable(&inst))
+                add_node(&inst);
+        }
+    }
+    auto n = nodes_.size();
+    adj_.assign(n, {});
+    degree_.assign(n, 0);
+    cross_call_.assign(n, false);
+    spill_cost_.assign(n, 0);
+    move_list_.assign(n, {});
+
+    auto id = [&](Value *val) { return node_id_.at(val); };
+    auto interfere_all = [&](Value *val, const std::set<Value *> &live) {
+        for (auto *other : live)
+            add_edge(id(val), id(other));
+    };
+
+    // 参数在 prologue 中依次从 $a*/$fa* 搬入, 两两冲突
+    for (auto &arg : func->get_args()) {
+        for (auto &other : func->get_args())
+            add_edge(id(&arg), id(&other));
+    }
+
+    for (auto &bb : func->get_basic_blocks()) {
+        auto *term = bb.get_terminator();
+        std::set<Value *> live = live_out_[&bb];
+        for (auto *op : get_operands(term)) {
+            if (is_allocatable(op))
+                live.insert(op);
+        }
+
+        // phi 拷贝处, after_copy 为拷贝之后仍需使用的定值
+        std::set<Value *> after_copy;
+        for (auto *op : get_operands(term)) {
+            if (is_allocatable(op))
+                after_copy.insert(op);
+        }
+        std::vector<PhiInst *> phis;
+        for (auto *succ : bb.get_succ_basic_blocks()) {
+            after_copy.insert(live_in_[succ].begin(), live_in_[succ].end());
+            for (auto &inst : succ->get_instructions()) {
+                if (not inst.is_phi())
+                    break;
+                phis.push_back(static_cast<PhiInst *>(&inst));
+            }
+        }
+        for (auto *phi : phis) {
+            Value *src = nullptr;
+            for (auto &[val, pre] : phi->get_phi_pairs()) {
+                if (pre == &bb)
+                    src = val;
+            }
+            for (auto *other : phis)
+                add_edge(id(phi), id(other));
+            interfere_all(phi, after_copy);
+            if (src != nullptr and is_allocatable(src) and
+                is_float(src) == is_float(phi)) {
+                int move = static_cast<int>(moves_.size());
+                moves_.emplace_back(id(phi), id(src));
+                move_list_[id(phi)].push_back(move);
+                move_list_[id(src)].push_back(move);
+            }
+            spill_cost_[id(phi)]++;
+            if (src != nullptr and is_allocatable(src))
+                spill_cost_[id(src)]++;
+        }
+
+        auto &insts = bb.get_instructions();
+        for (auto it = insts.rbegin(); it != insts.rend(); ++it) {
+            auto *inst = &*it;
+            if (inst->is_phi())
+                break;
+            if (is_allocatable(inst)) {
+                interfere_all(inst, live);
+                live.erase(inst);
+                spill_cost_[id(inst)]++;
+            }
+            if (inst->is_call()) {
+                for (auto *val : live)
+                    cross_call_[id(val)] = true;
+            }
+            for (auto *op : get_operands(inst)) {
+                if (is_allocatable(op)) {
+                    live.insert(op);
+                    spill_cost_[id(op)]++;
+                }
+            }
+        }
+        // 块首的 phi 同时定值, 与块入口活跃的定值冲突
+        for (auto &inst : bb.get_instructions()) {
+            if (not inst.is_phi())
+                break;
+            live.insert(&inst);
+        }
+        for (auto &inst : bb.get_instructions()) {
+            if (not inst.is_phi())
+                break;
+            interfere_all(&inst, live);
+        }
+    }
+}
+
+unsigned GraphColoring::k_of(int n) const {
+    bool is_f = is_float(nodes_[n]);
+    auto callee = (is_f ? callee_saved_fregs() : callee_saved_gregs()).size();
+    auto caller = (is_f ? caller_saved_fregs() : caller_saved_gregs()).size();
+    return cross_call_[n] ? callee : callee + caller;
+}
+
+int GraphColoring::get_alias(int n) const {
+    while (node_state_[n] == NodeState::coalesced)
+        n = alias_[n];
+    return n;
+}
+
+std::vector<int> GraphColoring::adjacent(int n) const {
+    std::vector<int> res;
+    for (auto m : adj_[n]) {
+        if (node_state_[m] != NodeState::on_stack and
+            node_state_[m] != NodeState::coalesced)
+            res.push_back(m);
+    }
+    return res;
+}
+
+std::vector<int> GraphColoring::node_moves(int n) const {
+    std::vector<int> res;
+    for (auto m : move_list_[n]) {
+        if (move_state_[m] == MoveState::active or
+            move_state_[m] == MoveState::worklist)
+            res.push_back(m);
+    }
+    return res;
+}
+
+void GraphColoring::set_state(int n, NodeState state) {
+    worklists_[static_cast<int>(node_state_[n])].erase(n);
+    node_state_[n] = state;
+    worklists_[static_cast<int>(state)].insert(n);
+}
+
+int GraphColoring::pop_worklist(NodeState state) {
+    return *worklists_[static_cast<int>(state)].begin();
+}
+
+void GraphColoring::color(bool is_float) {
+    auto n = nodes_.size();
+    node_state_.assign(n, NodeState::initial);
+    worklists_.assign(static_cast<int>(NodeState::on_stack) + 1, {});
+    move_state_.assign(moves_.size(), MoveState::worklist);
+    worklist_moves_.clear();
+    alias_.assign(n, -1);
+    select_stack_.clear();
+    color_.assign(n, -1);
+
+    for (int i = 0; i < static_cast<int>(moves_.size()); i++) {
+        if (RegAlloc::is_float(nodes_[moves_[i].first]) == is_float)
+            worklist_moves_.insert(i);
+        else
+            move_state_[i] = MoveState::frozen;
+    }
+    for (int i = 0; i < static_cast<int>(n); i++) {
+        if (RegAlloc::is_float(nodes_[i]) == is_float)
+            worklists_[static_cast<int>(NodeState::initial)].insert(i);
+    }
+
+    make_worklist();
+    auto empty = [&](NodeState state) {
+        return worklists_[static_cast<int>(state)].empty();
+    };
+    while (true) {
+        if (not empty(NodeState::simplify))
+            simplify();
+        else if (not worklist_moves_.empty())
+            coalesce();
+        else if (not empty(NodeState::freeze))
+            freeze();
+        else if (not empty(NodeState::spill))
+            select_spill();
+        else
+            break;
+    }
+    assign_colors(is_float);
+}
+
+void GraphColoring::make_worklist() {
+    auto initial = worklists_[static_cast<int>(NodeState::initial)];
+    for (auto n : initial) {
+        if (degree_[n] >= k_of(n))
+            set_state(n, NodeState::spill);
+        else if (move_related(n))
+            set_state(n, NodeState::freeze);
+        else
+            set_state(n, NodeState::simplify);
+    }
+}
+
+void GraphColoring::simplify() {
+    int n = pop_worklist(NodeState::simplify);
+    set_state(n, NodeState::on_stack);
+    select_stack_.push_back(n);
+    for (auto m : adjacent(n))
+        decrement_degree(m);
+}
+
+void GraphColoring::decrement_degree(int m) {
+    auto d = degree_[m]--;
+    if (d == k_of(m) and node_state_[m] == NodeState::spill) {
+        enable_moves(m);
+        for (auto n : adjacent(m))
+            enable_moves(n);
+        if (move_related(m))
+            set_state(m, NodeState::freeze);
+        else
+            set_state(m, NodeState::simplify);
+    }
+}
+
+void GraphColoring::enable_moves(int n) {
+    for (auto m : node_moves(n)) {
+        if (move_state_[m] == MoveState::active) {
+            move_state_[m] = MoveState::worklist;
+            worklist_moves_.insert(m);
+        }
+    }
+}
+
+void GraphColoring::add_worklist(int u) {
+    if (node_state_[u] == NodeState::freeze and not move_related(u) and
+        degree_[u] < k_of(u))
+        set_state(u, NodeState::simplify);
+}
+
+/**
+ * @brief Briggs 保守合并条件
+ *
+ * 合并后的节点中度数不小于 k 的邻居少于 k 个时, 合并不会使图变得不可着色。
+ */
+bool GraphColoring::conservative(const std::vector<int> &nodes,
+                                 unsigned k) const {
+    unsigned cnt = 0;
+    for (auto n : nodes) {
+        if (degree_[n] >= k_of(n))
+            cnt++;
+    }
+    return cnt < k;
+}
+
+void GraphColoring::coalesce() {
+    int m = *worklist_moves_.begin();
+    worklist_moves_.erase(worklist_moves_.begin());
+    int u = get_alias(moves_[m].first);
+    int v = get_alias(moves_[m].second);
+    if (u > v)
+        std::swap(u, v);
+
+    if (u == v) {
+        move_state_[m] = MoveState::coalesced;
+        add_worklist(u);
+        return;
+    }
+    if (adj_[u].count(v)) {
+        move_state_[m] = MoveState::constrained;
+        add_worklist(u);
+        add_worklist(v);
+        return;
+    }
+    auto nodes = adjacent(u);
+    for (auto t : adjacent(v)) {
+        if (not adj_[u].count(t))
+            nodes.push_back(t);
+    }
+    auto k = std::min(k_of(u), k_of(v));
+    if (conservative(nodes, k)) {
+        move_state_[m] = MoveState::coalesced;
+        combine(u, v);
+        add_worklist(u);
+    } else {
+        move_state_[m] = MoveState::active;
+    }
+}
+
+void GraphColoring::combine(int u, int v) {
+    set_state(v, NodeState::coalesced);
+    alias_[v] = u;
+    move_list_[u].insert(move_list_[u].end(), move_list_[v].begin(),
+                         move_list_[v].end());
+    cross_call_[u] = cross_call_[u] or cross_call_[v];
+    spill_cost_[u] += spill_cost_[v];
+    enable_moves(v);
+    for (auto t : adjacent(v)) {
+        add_edge(t, u);
+        decrement_degree(t);
+    }
+    if (degree_[u] >= k_of(u) and node_state_[u] == NodeState::freeze)
+        set_state(u, NodeState::spill);
+}
+
+void GraphColoring::freeze() {
+    int u = pop_worklist(NodeState::freeze);
+    set_state(u, NodeState::simplify);
+    freeze_moves(u);
+}
+
+void GraphColoring::freeze_moves(int u) {
+    for (auto m : node_moves(u)) {
+        auto [x, y] = moves_[m];
+        int v = get_alias(y) == get_alias(u) ? get_alias(x) : get_alias(y);
+        if (move_state_[m] == MoveState::worklist)
+            worklist_moves_.erase(m);
+        move_state_[m] = MoveState::frozen;
+        if (not move_related(v) and degree_[v] < k_of(v) and
+            node_state_[v] == NodeState::freeze)
+            set_state(v, NodeState::simplify);
+    }
+}
+
+// 选择 使用次数/度数 最小的节点作为潜在溢出节点
+void GraphColoring::select_spill() {
+    auto &worklist = worklists_[static_cast<int>(NodeState::spill)];
+    int best = *worklist.begin();
+    for (auto n : worklist) {
+        // spill_cost_[n] / degree_[n] < spill_cost_[best] / degree_[best]
+        if (static_cast<unsigned long>(spill_cost_[n]) * degree_[best] <
+            static_cast<unsigned long>(spill_cost_[best]) * degree_[n])
+            best = n;
+    }
+    set_state(best, NodeState::simplify);
+    freeze_moves(best);
+}
+
+void GraphColoring::assign_colors(bool is_float) {
+    auto &caller = is_float ? caller_saved_fregs() : caller_saved_gregs();
+    auto &callee = is_float ? callee_saved_fregs() : callee_saved_gregs();
+    while (not select_stack_.empty()) {
+        int n = select_stack_.back();
+        select_stack_.pop_back();
+        std::vector<unsigned> ok_colors;
+        if (not cross_call_[n])
+            ok_colors.insert(ok_colors.end(), caller.begin(), caller.end());
+        ok_colors.insert(ok_colors.end(), callee.begin(), callee.end());
+        for (auto w : adj_[n]) {
+            auto a = get_alias(w);
+            if (node_state_[a] == NodeState::colored) {
+                ok_colors.erase(std::remove(ok_colors.begin(), ok_colors.end(),
+                                            static_cast<unsigned>(color_[a])),
+                                ok_colors.end());
+            }
+        }
+        if (ok_colors.empty()) {
+            set_state(n, NodeState::spilled);
+        } else {
+            set_state(n, NodeState::colored);
+            color_[n] = static_cast<int>(ok_colors.front());
+        }
+    }
+    for (int n = 0; n < static_cast<int>(nodes_.size()); n++) {
+        if (RegAlloc::is_float(nodes_[n]) != is_float)
+            continue;
+        auto a = get_alias(n);
+        if (node_state_[a] == NodeState::colored) {
+            assign(nodes_[n], color_[a]);
+        } else {
+            // 合并后的节点互不冲突, 溢出时也可以共用栈槽
+            if (a != n)
+                spill_alias_.emplace(nodes_[n], nodes_[a]);
+            spill_count_++;
+        }
+    }
+}
@@ -20,9 +20,15 @@ std::string Reg::print() const {
     if (12 <= id and id <= 20) {
         return "$t" + std::to_string(id - 12);
     }
+    if (id == 21) {
+        return "$r21";
+    }
     if (id == 22) {
         return "$fp";
     }
+    if (23 <= id and id <= 31) {
+        return "$s" + std::to_string(id - 23);
+    }
     assert(false);
 }
 
@@ -0,0 +1,116 @@
+#include "ThreadPool.hpp"
+
+#include <cassert>
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+    assert(num_threads >= 1 && "thread pool needs at least one thread");
+    for (unsigned i = 0; i < num_threads; ++i)
+        workers_.push_back(std::make_unique<Worker>());
+    for (unsigned i = 1; i < num_threads; ++i)
+        threads_.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+void ThreadPool::parallel_for(std::size_t n, const Task &task) {
+    if (n == 0)
+        return;
+    if (threads_.empty()) {
+        for (std::size_t i = 0; i < n; ++i)
+            task(i, 0);
+        return;
+    }
+
+    // 按连续的块分配, 相邻的下标大多由同一个线程处理
+    auto num_workers = workers_.size();
+    for (std::size_t w = 0; w < num_workers; ++w) {
+        auto &worker = *workers_[w];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (auto i = n * w / num_workers; i < n * (w + 1) / num_workers; ++i)
+            worker.tasks.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        failed_ = false;
+        error_ = nullptr;
+        busy_ = threads_.size();
+        generation_++;
+    }
+    start_cv_.notify_all();
+
+    run_tasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_ == 0; });
+    task_ = nullptr;
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+void ThreadPool::worker_loop(unsigned id) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock,
+                           [&] { return stop_ or generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+        }
+        run_tasks(id);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void ThreadPool::run_tasks(unsigned id) {
+    std::size_t index;
+    while (pop_task(id, index)) {
+        // 出错后只把剩余任务取出丢弃
+        if (failed_)
+            continue;
+        try {
+            (*task_)(index, id);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (not error_)
+                error_ = std::current_exception();
+            failed_ = true;
+        }
+    }
+}
+
+bool ThreadPool::pop_task(unsigned id, std::size_t &index) {
+    {
+        auto &own = *workers_[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (not own.tasks.empty()) {
+            index = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // 任务只在 parallel_for 开始时加入, 所有队列都空时本轮就没有任务了
+    for (std::size_t k = 1; k < workers_.size(); ++k) {
+        auto &victim = *workers_[(id + k) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (not victim.tasks.empty()) {
+            index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
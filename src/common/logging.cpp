@@ -7,11 +7,26 @@ void LogWriter::operator<(const LogStream &stream) {
 }
 
 void LogWriter::output_log(const std::ostringstream &msg) {
-    if (log_level_ >= env_log_level)
-        std::cout << "[" << level2string(log_level_) << "] "
-                  << "(" << location_.file_ << ":" << location_.line_ << "L  "
-                  << location_.func_ << ")" << msg.str() << std::endl;
+    // 整行先拼好再一次写出, 多个线程同时记录日志时各行不会互相穿插
+    std::ostringstream line;
+    line << "[" << level2string(log_level_) << "] "
+         << "(" << location_.file_ << ":" << location_.line_ << "L  "
+         << location_.func_ << ")" << msg.str() << "\n";
+    std::cout << line.str() << std::flush;
 }
+
+int env_log_level() {
+    static const int level = [] {
+        char *logv = std::getenv("LOGV");
+        if (not logv)
+            return ERROR + 1;
+        char *end;
+        long val = std::strtol(logv, &end, 10);
+        return end == logv ? ERROR + 1 : static_cast<int>(val);
+    }();
+    return level;
+}
+
 std::string level2string(LogLevel level) {
     switch (level) {
     case DEBUG:
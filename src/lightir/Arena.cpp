@@ -0,0 +1,48 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+Arena::~Arena() {
+    for (auto *slab : slabs_) {
+        std::free(slab);
+    }
+}
+
+namespace {
+char *align_up(char *ptr, std::size_t align) {
+    auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+    return reinterpret_cast<char *>((addr + align - 1) &
+                                    ~(std::uintptr_t(align) - 1));
+}
+} // namespace
+
+char *Arena::new_slab(std::size_t size) {
+    auto *slab = static_cast<char *>(std::malloc(size));
+    if (slab == nullptr) {
+        throw std::bad_alloc();
+    }
+    slabs_.push_back(slab);
+    return slab;
+}
+
+void *Arena::allocate(std::size_t size, std::size_t align) {
+    assert((align & (align - 1)) == 0 && "alignment must be a power of 2");
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_allocations_++;
+    bytes_allocated_ += size;
+    if (size + align > slab_size) {
+        // 大块单独占一个 slab, 不打断当前 slab 的切分
+        return align_up(new_slab(size + align), align);
+    }
+    auto *ptr = cur_ ? align_up(cur_, align) : nullptr;
+    if (ptr == nullptr or ptr + size > end_) {
+        cur_ = new_slab(slab_size);
+        end_ = cur_ + slab_size;
+        ptr = align_up(cur_, align);
+    }
+    cur_ = ptr + size;
+    return ptr;
+}
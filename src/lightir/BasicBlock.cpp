@@ -8,7 +8,7 @@
 
 BasicBlock::BasicBlock(Module *m, const std::string &name = "",
                        Function *parent = nullptr)
-    : Value(m->get_label_type(), name), parent_(parent) {
+    : Value(m->get_label_type(), BasicBlockVal, name), parent_(parent) {
     assert(parent && "currently parent should not be nullptr");
     parent_->add_basic_block(this);
 }
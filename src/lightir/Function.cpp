@@ -3,7 +3,7 @@
 #include "Module.hpp"
 
 Function::Function(FunctionType *ty, const std::string &name, Module *parent)
-    : Value(ty, name), parent_(parent), seq_cnt_(0) {
+    : Value(ty, FunctionVal, name), parent_(parent), seq_cnt_(0) {
     // num_args_ = ty->getNumParams();
     parent->add_function(this);
     // build args
@@ -13,7 +13,7 @@ Function::Function(FunctionType *ty, const std::string &name, Module *parent)
 }
 Function *Function::create(FunctionType *ty, const std::string &name,
                            Module *parent) {
-    return new Function(ty, name, parent);
+    return new (parent) Function(ty, name, parent);
 }
 
 FunctionType *Function::get_function_type() const {
@@ -3,7 +3,7 @@
 
 GlobalVariable::GlobalVariable(std::string name, Module *m, Type *ty,
                                bool is_const, Constant *init)
-    : User(ty, name), is_const_(is_const), init_val_(init) {
+    : User(ty, GlobalVariableVal, name), is_const_(is_const), init_val_(init) {
     m->add_global_variable(this);
     if (init) {
         this->add_operand(init);
@@ -13,7 +13,7 @@ GlobalVariable::GlobalVariable(std::string name, Module *m, Type *ty,
 GlobalVariable *GlobalVariable::create(std::string name, Module *m, Type *ty,
                                        bool is_const,
                                        Constant *init = nullptr) {
-    return new GlobalVariable(name, m, PointerType::get(ty), is_const, init);
+    return new (m) GlobalVariable(name, m, PointerType::get(ty), is_const, init);
 }
 
 std::string GlobalVariable::print() {
@@ -10,11 +10,11 @@ std::string print_as_op(Value *v, bool print_ty) {
         op_ir += " ";
     }
 
-    if (dynamic_cast<GlobalVariable *>(v)) {
+    if (v->is<GlobalVariable>()) {
         op_ir += "@" + v->get_name();
-    } else if (dynamic_cast<Function *>(v)) {
+    } else if (v->is<Function>()) {
         op_ir += "@" + v->get_name();
-    } else if (dynamic_cast<Constant *>(v)) {
+    } else if (v->is<Constant>()) {
         op_ir += v->print();
     } else {
         op_ir += "%" + v->get_name();
@@ -152,7 +152,7 @@ std::string CallInst::print() {
     instr_ir += this->get_function_type()->get_return_type()->print();
 
     instr_ir += " ";
-    assert(dynamic_cast<Function *>(this->get_operand(0)) &&
+    assert(this->get_operand(0)->is<Function>() &&
            "Wrong call operand function");
     instr_ir += print_as_op(this->get_operand(0), false);
     instr_ir += "(";
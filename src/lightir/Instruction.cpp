@@ -12,11 +12,13 @@
 #include <vector>
 
 Instruction::Instruction(Type *ty, OpID id, BasicBlock *parent)
-    : User(ty, ""), op_id_(id), parent_(parent) {
+    : User(ty, InstructionVal + id, ""), op_id_(id), parent_(parent) {
     if (parent)
         parent->add_instruction(this);
 }
 
+Module *Instruction::module_of(BasicBlock *bb) { return bb->get_module(); }
+
 Function *Instruction::get_function() { return parent_->get_parent(); }
 Module *Instruction::get_module() { return parent_->get_module(); }
 
@@ -144,6 +146,16 @@ FunctionType *CallInst::get_function_type() const {
     return static_cast<FunctionType *>(get_operand(0)->get_type());
 }
 
+bool CallInst::is_tail_call() {
+    auto next = std::next(getIterator());
+    if (next == get_parent()->get_instructions().end() or not next->is_ret())
+        return false;
+    auto *ret = static_cast<ReturnInst *>(&*next);
+    if (ret->is_void_ret())
+        return is_void();
+    return ret->get_operand(0) == this;
+}
+
 BranchInst::BranchInst(Value *cond, BasicBlock *if_true, BasicBlock *if_false,
                        BasicBlock *bb)
     : BaseInst<BranchInst>(bb->get_module()->get_void_type(), br, bb) {
@@ -168,6 +180,9 @@ BranchInst::BranchInst(Value *cond, BasicBlock *if_true, BasicBlock *if_false,
 }
 
 BranchInst::~BranchInst() {
+    // Module 析构时操作数已全部断开, 整个 CFG 随之销毁, 无需再维护
+    if (get_num_operand() == 0)
+        return;
     std::list<BasicBlock *> succs;
     if (is_cond_br()) {
         succs.push_back(static_cast<BasicBlock *>(get_operand(1)));
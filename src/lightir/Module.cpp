@@ -2,6 +2,8 @@
 #include "Function.hpp"
 #include "GlobalVariable.hpp"
 
+#include <cassert>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -13,6 +15,21 @@ Module::Module() {
     float32_ty_ = std::make_unique<FloatType>(this);
 }
 
+Module::~Module() {
+    /* 先断开所有操作数, 之后各结点析构时就不必再逐个维护 use 链表,
+     * 结点本身的内存随 arena_ 整块释放 */
+    for (auto &func : function_list_) {
+        for (auto &bb : func.get_basic_blocks()) {
+            for (auto &inst : bb.get_instructions()) {
+                inst.remove_all_operands();
+            }
+        }
+    }
+    for (auto &global : global_list_) {
+        global.remove_all_operands();
+    }
+}
+
 Type *Module::get_void_type() { return void_ty_.get(); }
 Type *Module::get_label_type() { return label_ty_.get(); }
 IntegerType *Module::get_int1_type() { return int1_ty_.get(); }
@@ -26,27 +43,74 @@ PointerType *Module::get_float_ptr_type() {
 }
 
 PointerType *Module::get_pointer_type(Type *contained) {
-    if (pointer_map_.find(contained) == pointer_map_.end()) {
-        pointer_map_[contained] = std::make_unique<PointerType>(contained);
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &ty = pointer_map_[contained];
+    if (ty == nullptr) {
+        ty = new PointerType(contained);
+        derived_types_.emplace_back(ty);
     }
-    return pointer_map_[contained].get();
+    return ty;
 }
 
 ArrayType *Module::get_array_type(Type *contained, unsigned num_elements) {
-    if (array_map_.find({contained, num_elements}) == array_map_.end()) {
-        array_map_[{contained, num_elements}] =
-            std::make_unique<ArrayType>(contained, num_elements);
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &ty = array_map_[{contained, num_elements}];
+    if (ty == nullptr) {
+        ty = new ArrayType(contained, num_elements);
+        derived_types_.emplace_back(ty);
     }
-    return array_map_[{contained, num_elements}].get();
+    return ty;
 }
 
 FunctionType *Module::get_function_type(Type *retty,
                                         std::vector<Type *> &args) {
-    if (not function_map_.count({retty, args})) {
-        function_map_[{retty, args}] =
-            std::make_unique<FunctionType>(retty, args);
-    }
-    return function_map_[{retty, args}].get();
+    // 与 Type::compute_hash 对函数类型的计算方式保持一致
+    auto hash = hash_combine(hash_mix(Type::FunctionTyID), retty->get_hash());
+    for (auto *arg : args)
+        hash = hash_combine(hash, arg->get_hash());
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    if (auto *ty = function_map_.find({retty, &args, hash}))
+        return *ty;
+    auto *ty = new FunctionType(retty, args);
+    derived_types_.emplace_back(ty);
+    assert(ty->get_hash() == hash && "function type hash mismatch");
+    // 表中的键引用新类型自己的参数数组, 不依赖调用者的 args
+    function_map_[{retty, &ty->get_params(), hash}] = ty;
+    return ty;
+}
+
+ConstantInt *Module::get_int_constant(int val) {
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &c = int_constants_[val];
+    if (c == nullptr)
+        c = new (this) ConstantInt(get_int32_type(), val);
+    return c;
+}
+
+ConstantInt *Module::get_bool_constant(bool val) {
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &c = bool_constants_[val];
+    if (c == nullptr)
+        c = new (this) ConstantInt(get_int1_type(), val ? 1 : 0);
+    return c;
+}
+
+ConstantFP *Module::get_float_constant(float val) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &c = float_constants_[bits];
+    if (c == nullptr)
+        c = new (this) ConstantFP(get_float_type(), val);
+    return c;
+}
+
+ConstantZero *Module::get_zero_constant(Type *ty) {
+    std::lock_guard<std::mutex> lock(uniquing_mutex_);
+    auto &c = zero_constants_[ty];
+    if (c == nullptr)
+        c = new (this) ConstantZero(ty);
+    return c;
 }
 
 void Module::add_function(Function *f) { function_list_.push_back(f); }
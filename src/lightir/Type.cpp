@@ -1,4 +1,5 @@
 #include "Type.hpp"
+#include "HashMap.hpp"
 #include "Module.hpp"
 
 #include <array>
@@ -8,6 +9,15 @@
 Type::Type(TypeID tid, Module *m) {
     tid_ = tid;
     m_ = m;
+    // 其余类型带有额外字段, 由子类构造函数在字段就绪后调用 cache_layout
+    if (tid == VoidTyID or tid == LabelTyID)
+        cache_layout();
+}
+
+void Type::cache_layout() {
+    size_ = compute_size();
+    name_ = compute_name();
+    hash_ = compute_hash();
 }
 
 bool Type::is_int1_type() const {
@@ -32,6 +42,12 @@ Type *Type::get_array_element_type() const {
 }
 
 unsigned Type::get_size() const {
+    assert(not is_void_type() and not is_label_type() and
+           not is_function_type() && "bad use on get_size()");
+    return size_;
+}
+
+unsigned Type::compute_size() const {
     switch (get_type_id()) {
     case IntegerTyID: {
         if (is_int1_type())
@@ -54,12 +70,12 @@ unsigned Type::get_size() const {
     case VoidTyID:
     case LabelTyID:
     case FunctionTyID:
-        assert(false && "bad use on get_size()");
+        return 0;
     }
     assert(false && "unreachable");
 }
 
-std::string Type::print() const {
+std::string Type::compute_name() const {
     std::string type_ir;
     switch (this->get_type_id()) {
     case VoidTyID:
@@ -110,13 +126,40 @@ std::string Type::print() const {
     return type_ir;
 }
 
+std::size_t Type::compute_hash() const {
+    auto hash = hash_mix(get_type_id());
+    switch (get_type_id()) {
+    case IntegerTyID:
+        return hash_combine(
+            hash, static_cast<const IntegerType *>(this)->get_num_bits());
+    case FunctionTyID: {
+        auto func_type = static_cast<const FunctionType *>(this);
+        hash = hash_combine(hash, func_type->get_return_type()->get_hash());
+        for (auto *param : func_type->get_params())
+            hash = hash_combine(hash, param->get_hash());
+        return hash;
+    }
+    case PointerTyID:
+        return hash_combine(hash, get_pointer_element_type()->get_hash());
+    case ArrayTyID: {
+        auto array_type = static_cast<const ArrayType *>(this);
+        hash = hash_combine(hash, array_type->get_element_type()->get_hash());
+        return hash_combine(hash, array_type->get_num_of_elements());
+    }
+    default:
+        return hash;
+    }
+}
+
 IntegerType::IntegerType(unsigned num_bits, Module *m)
-    : Type(Type::IntegerTyID, m), num_bits_(num_bits) {}
+    : Type(Type::IntegerTyID, m), num_bits_(num_bits) {
+    cache_layout();
+}
 
 unsigned IntegerType::get_num_bits() const { return num_bits_; }
 
 FunctionType::FunctionType(Type *result, std::vector<Type *> params)
-    : Type(Type::FunctionTyID, nullptr) {
+    : Type(Type::FunctionTyID, result->get_module()) {
     assert(is_valid_return_type(result) && "Invalid return type for function!");
     result_ = result;
 
@@ -125,6 +168,7 @@ FunctionType::FunctionType(Type *result, std::vector<Type *> params)
                "Not a valid type for function argument!");
         args_.push_back(p);
     }
+    cache_layout();
 }
 
 bool FunctionType::is_valid_return_type(Type *ty) {
@@ -152,6 +196,7 @@ ArrayType::ArrayType(Type *contained, unsigned num_elements)
     assert(is_valid_element_type(contained) &&
            "Not a valid type for array element!");
     contained_ = contained;
+    cache_layout();
 }
 
 bool ArrayType::is_valid_element_type(Type *ty) {
@@ -170,12 +215,13 @@ PointerType::PointerType(Type *contained)
     assert(std::find(allowed_elem_type.begin(), allowed_elem_type.end(),
                      elem_type_id) != allowed_elem_type.end() &&
            "Not allowed type for pointer");
+    cache_layout();
 }
 
 PointerType *PointerType::get(Type *contained) {
     return contained->get_module()->get_pointer_type(contained);
 }
 
-FloatType::FloatType(Module *m) : Type(Type::FloatTyID, m) {}
+FloatType::FloatType(Module *m) : Type(Type::FloatTyID, m) { cache_layout(); }
 
 FloatType *FloatType::get(Module *m) { return m->get_float_type(); }
@@ -1,41 +1,72 @@
 #include "User.hpp"
+#include "Module.hpp"
+#include "Type.hpp"
 
 #include <cassert>
 
+User::User(Type *ty, unsigned id, const std::string &name)
+    : Value(ty, id, name),
+      operands_(ArenaAllocator<Value *>(&ty->get_module()->get_arena())),
+      uses_(ArenaAllocator<Use>(&ty->get_module()->get_arena())) {}
+
 void User::set_operand(unsigned i, Value *v) {
     assert(i < operands_.size() && "set_operand out of index");
     if (operands_[i]) { // old operand
-        operands_[i]->remove_use(this, i);
+        operands_[i]->remove_use(uses_[i]);
     }
     if (v) { // new operand
-        v->add_use(this, i);
+        v->add_use(uses_[i]);
     }
     operands_[i] = v;
 }
 
+bool User::has_shared_operand() const {
+    for (auto *op : operands_) {
+        if (op and op->is_shared())
+            return true;
+    }
+    return false;
+}
+
 void User::add_operand(Value *v) {
     assert(v != nullptr && "bad use: add_operand(nullptr)");
-    v->add_use(this, operands_.size());
+    {
+        // 扩容时已有的 use 结点会被移动到新数组中
+        std::unique_lock<std::mutex> lock(shared_use_mutex(), std::defer_lock);
+        if (uses_.size() == uses_.capacity() and has_shared_operand())
+            lock.lock();
+        uses_.emplace_back(this, operands_.size());
+    }
     operands_.push_back(v);
+    v->add_use(uses_.back());
 }
 
 void User::remove_all_operands() {
     for (unsigned i = 0; i != operands_.size(); ++i) {
         if (operands_[i]) {
-            operands_[i]->remove_use(this, i);
+            operands_[i]->remove_use(uses_[i]);
         }
     }
     operands_.clear();
+    uses_.clear();
 }
 
 void User::remove_operand(unsigned idx) {
     assert(idx < operands_.size() && "remove_operand out of index");
-    // influence on other operands
-    for (unsigned i = idx + 1; i < operands_.size(); ++i) {
-        operands_[i]->remove_use(this, i);
-        operands_[i]->add_use(this, i - 1);
-    }
     // remove the designated operand
-    operands_[idx]->remove_use(this, idx);
+    if (operands_[idx]) {
+        operands_[idx]->remove_use(uses_[idx]);
+    }
     operands_.erase(operands_.begin() + idx);
+    {
+        // 之后的 use 结点会前移一位
+        std::unique_lock<std::mutex> lock(shared_use_mutex(), std::defer_lock);
+        if (has_shared_operand())
+            lock.lock();
+        uses_.erase(uses_.begin() + idx);
+    }
+    // influence on other operands: 结点仍挂在原来的链表上, 只需更新编号
+    for (unsigned i = idx; i < uses_.size(); ++i) {
+        uses_[i].arg_no_ = i;
+    }
 }
@@ -1,9 +1,25 @@
 #include "Value.hpp"
+#include "Module.hpp"
 #include "Type.hpp"
 #include "User.hpp"
 
+#include <atomic>
 #include <cassert>
 
+void *Value::operator new(std::size_t size, Module *m) {
+    return m->get_arena().allocate(size, alignof(std::max_align_t));
+}
+
+unsigned Value::next_creation_index() {
+    static std::atomic<unsigned> next{0};
+    return next++;
+}
+
+std::mutex &Value::shared_use_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
 bool Value::set_name(std::string name) {
     if (name_ == "") {
         name_ = name;
@@ -12,20 +28,36 @@ bool Value::set_name(std::string name) {
     return false;
 }
 
-void Value::add_use(User *user, unsigned arg_no) {
-    use_list_.emplace_back(user, arg_no);
-};
+void Value::add_use(Use &use) {
+    std::unique_lock<std::mutex> lock(shared_use_mutex(), std::defer_lock);
+    if (is_shared())
+        lock.lock();
+    assert(not use.is_linked() && "use is already linked");
+    use.prev_ = uses_.prev_;
+    use.next_ = &uses_;
+    uses_.prev_->next_ = &use;
+    uses_.prev_ = &use;
+    num_uses_++;
+}
 
-void Value::remove_use(User *user, unsigned arg_no) {
-    auto target_use = Use(user, arg_no);
-    use_list_.remove_if([&](const Use &use) { return use == target_use; });
+void Value::remove_use(Use &use) {
+    std::unique_lock<std::mutex> lock(shared_use_mutex(), std::defer_lock);
+    if (is_shared())
+        lock.lock();
+    // 其他线程断开相邻的 use 时会改写本结点的指针, 须在持锁后检查
+    assert(use.is_linked() && "use is not linked");
+    use.prev_->next_ = use.next_;
+    use.next_->prev_ = use.prev_;
+    use.prev_ = nullptr;
+    use.next_ = nullptr;
+    num_uses_--;
 }
 
 void Value::replace_all_use_with(Value *new_val) {
     if (this == new_val)
         return;
-    while (use_list_.size()) {
-        auto use = use_list_.begin();
+    while (num_uses_ != 0) {
+        auto *use = uses_.next_;
         use->val_->set_operand(use->arg_no_, new_val);
     }
 }
@@ -34,10 +66,10 @@ void Value::replace_use_with_if(Value *new_val,
                                 std::function<bool(Use *)> should_replace) {
     if (this == new_val)
         return;
-    for (auto iter = use_list_.begin(); iter != use_list_.end();) {
-        auto use = *iter++;
-        if (not should_replace(&use))
-            continue;
-        use.val_->set_operand(use.arg_no_, new_val);
+    for (auto *use = uses_.next_; use != &uses_;) {
+        auto *next = use->next_;
+        if (should_replace(use))
+            use->val_->set_operand(use->arg_no_, new_val);
+        use = next;
     }
 }
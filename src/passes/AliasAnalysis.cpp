@@ -0,0 +1,43 @@
+#include "AliasAnalysis.hpp"
+
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+Value *get_base(Value *ptr) {
+    while (auto gep = ptr->dyn_cast<GetElementPtrInst>())
+        ptr = gep->get_operand(0);
+    return ptr;
+}
+
+bool is_identified_object(Value *base) {
+    return base->is<AllocaInst>() or base->is<GlobalVariable>();
+}
+
+bool may_alias(Value *ptr1, Value *ptr2) {
+    if (ptr1 == ptr2)
+        return true;
+    if (ptr1->get_type() != ptr2->get_type())
+        return false;
+    auto base1 = get_base(ptr1);
+    auto base2 = get_base(ptr2);
+    if (base1 != base2) {
+        if (is_identified_object(base1) and is_identified_object(base2))
+            return false;
+        return not base1->is<AllocaInst>() and not base2->is<AllocaInst>();
+    }
+    auto gep1 = ptr1->dyn_cast<GetElementPtrInst>();
+    auto gep2 = ptr2->dyn_cast<GetElementPtrInst>();
+    if (gep1 == nullptr or gep2 == nullptr or
+        gep1->get_operand(0) != gep2->get_operand(0) or
+        gep1->get_num_operand() != gep2->get_num_operand())
+        return true;
+    for (unsigned i = 1; i < gep1->get_num_operand(); i++) {
+        auto idx1 = gep1->get_operand(i)->dyn_cast<ConstantInt>();
+        auto idx2 = gep2->get_operand(i)->dyn_cast<ConstantInt>();
+        if (idx1 and idx2 and idx1->get_value() != idx2->get_value())
+            return false;
+    }
+    return true;
+}
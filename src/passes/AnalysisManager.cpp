@@ -0,0 +1,42 @@
+#include "AnalysisManager.hpp"
+
+Dominators &AnalysisManager::get_dominators(Function *func) {
+    auto &dom = get_slot(dominators_, func);
+    if (not dom) {
+        dom = std::make_unique<Dominators>(m_);
+        dom->run_on_func(func);
+        compute_count_[static_cast<unsigned>(AnalysisID::dominators)]++;
+    }
+    return *dom;
+}
+
+LoopDetection &AnalysisManager::get_loops(Function *func) {
+    auto &loops = get_slot(loops_, func);
+    if (not loops) {
+        loops = std::make_unique<LoopDetection>(m_);
+        loops->run_on_func(func, get_dominators(func));
+        compute_count_[static_cast<unsigned>(AnalysisID::loops)]++;
+    }
+    return *loops;
+}
+
+FuncInfo &AnalysisManager::get_func_info() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (not func_info_) {
+        func_info_ = std::make_unique<FuncInfo>(m_);
+        func_info_->run();
+        compute_count_[static_cast<unsigned>(AnalysisID::func_info)]++;
+    }
+    return *func_info_;
+}
+
+void AnalysisManager::invalidate(const PreservedAnalyses &pa) {
+    if (not pa.is_preserved(AnalysisID::dominators))
+        dominators_.clear();
+    // 循环依赖于支配树, 支配树失效时一并丢弃
+    if (not pa.is_preserved(AnalysisID::loops) or
+        not pa.is_preserved(AnalysisID::dominators))
+        loops_.clear();
+    if (not pa.is_preserved(AnalysisID::func_info))
+        func_info_.reset();
+}
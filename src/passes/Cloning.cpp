@@ -0,0 +1,136 @@
+#include "Cloning.hpp"
+
+#include <utility>
+
+Instruction *clone_instruction(Instruction *inst, BasicBlock *bb) {
+    auto op = [&](unsigned i) { return inst->get_operand(i); };
+    auto rest = [&]() {
+        auto &ops = inst->get_operands();
+        return std::vector<Value *>(ops.begin() + 1, ops.end());
+    };
+    switch (inst->get_instr_type()) {
+    case Instruction::add:
+        return IBinaryInst::create_add(op(0), op(1), bb);
+    case Instruction::sub:
+        return IBinaryInst::create_sub(op(0), op(1), bb);
+    case Instruction::mul:
+        return IBinaryInst::create_mul(op(0), op(1), bb);
+    case Instruction::sdiv:
+        return IBinaryInst::create_sdiv(op(0), op(1), bb);
+    case Instruction::fadd:
+        return FBinaryInst::create_fadd(op(0), op(1), bb);
+    case Instruction::fsub:
+        return FBinaryInst::create_fsub(op(0), op(1), bb);
+    case Instruction::fmul:
+        return FBinaryInst::create_fmul(op(0), op(1), bb);
+    case Instruction::fdiv:
+        return FBinaryInst::create_fdiv(op(0), op(1), bb);
+    case Instruction::alloca:
+        return AllocaInst::create_alloca(
+            inst->as<AllocaInst>()->get_alloca_type(), bb);
+    case Instruction::load:
+        return LoadInst::create_load(op(0), bb);
+    case Instruction::store:
+        return StoreInst::create_store(op(0), op(1), bb);
+    case Instruction::ge:
+        return ICmpInst::create_ge(op(0), op(1), bb);
+    case Instruction::gt:
+        return ICmpInst::create_gt(op(0), op(1), bb);
+    case Instruction::le:
+        return ICmpInst::create_le(op(0), op(1), bb);
+    case Instruction::lt:
+        return ICmpInst::create_lt(op(0), op(1), bb);
+    case Instruction::eq:
+        return ICmpInst::create_eq(op(0), op(1), bb);
+    case Instruction::ne:
+        return ICmpInst::create_ne(op(0), op(1), bb);
+    case Instruction::fge:
+        return FCmpInst::create_fge(op(0), op(1), bb);
+    case Instruction::fgt:
+        return FCmpInst::create_fgt(op(0), op(1), bb);
+    case Instruction::fle:
+        return FCmpInst::create_fle(op(0), op(1), bb);
+    case Instruction::flt:
+        return FCmpInst::create_flt(op(0), op(1), bb);
+    case Instruction::feq:
+        return FCmpInst::create_feq(op(0), op(1), bb);
+    case Instruction::fne:
+        return FCmpInst::create_fne(op(0), op(1), bb);
+    case Instruction::call:
+        return CallInst::create_call(op(0)->as<Function>(), rest(), bb);
+    case Instruction::getelementptr:
+        return GetElementPtrInst::create_gep(op(0), rest(), bb);
+    case Instruction::zext:
+        return ZextInst::create_zext(op(0), inst->get_type(), bb);
+    case Instruction::fptosi:
+        return FpToSiInst::create_fptosi(op(0), inst->get_type(), bb);
+    case Instruction::sitofp:
+        return SiToFpInst::create_sitofp(op(0), bb);
+    default:
+        assert(false && "phi and terminators are cloned by clone_blocks");
+        return nullptr;
+    }
+}
+
+/**
+ * @brief 复制一组基本块
+ *
+ * 先创建全部的块与指令 (phi 为空, 其余指令暂用原操作数), 再统一映射操作数,
+ * 因此块之间的先后顺序不影响结果; 跳转在最后创建以维护前驱后继关系。
+ */
+std::vector<BasicBlock *> clone_blocks(const std::vector<BasicBlock *> &blocks,
+                                       Function *func, ValueMap &value_map) {
+    auto m = func->get_parent();
+    std::vector<BasicBlock *> new_blocks;
+    for (auto bb : blocks) {
+        auto new_bb = BasicBlock::create(m, "", func);
+        value_map[bb] = new_bb;
+        new_blocks.push_back(new_bb);
+    }
+
+    std::vector<std::pair<Instruction *, Instruction *>> cloned;
+    for (unsigned i = 0; i < blocks.size(); i++) {
+        for (auto &inst : blocks[i]->get_instructions()) {
+            if (inst.is_br() or inst.is_ret())
+                continue;
+            Instruction *copy;
+            if (inst.is_phi()) {
+                copy = PhiInst::create_phi(inst.get_type(), new_blocks[i]);
+                new_blocks[i]->add_instruction(copy);
+            } else {
+                copy = clone_instruction(&inst, new_blocks[i]);
+            }
+            value_map[&inst] = copy;
+            cloned.emplace_back(&inst, copy);
+        }
+    }
+
+    for (auto &[inst, copy] : cloned) {
+        if (inst->is_phi()) {
+            for (auto &[val, bb] : inst->as<PhiInst>()->get_phi_pairs())
+                copy->as<PhiInst>()->add_phi_pair_operand(
+                    map_value(value_map, val), map_value(value_map, bb));
+            continue;
+        }
+        for (unsigned i = 0; i < inst->get_num_operand(); i++) {
+            auto val = map_value(value_map, inst->get_operand(i));
+            if (val != inst->get_operand(i))
+                copy->set_operand(i, val);
+        }
+    }
+
+    for (unsigned i = 0; i < blocks.size(); i++) {
+        auto br = blocks[i]->get_terminator()->dyn_cast<BranchInst>();
+        if (br == nullptr)
+            continue;
+        auto target = [&](unsigned idx) {
+            return map_value(value_map, br->get_operand(idx))->as<BasicBlock>();
+        };
+        if (br->is_cond_br())
+            BranchInst::create_cond_br(map_value(value_map, br->get_condition()),
+                                       target(1), target(2), new_blocks[i]);
+        else
+            BranchInst::create_br(target(0), new_blocks[i]);
+    }
+    return new_blocks;
+}
@@ -0,0 +1,57 @@
+#include "CmpUtils.hpp"
+
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+
+Instruction::OpID negate_cmp(Instruction::OpID op) {
+    switch (op) {
+    case Instruction::lt:
+        return Instruction::ge;
+    case Instruction::le:
+        return Instruction::gt;
+    case Instruction::gt:
+        return Instruction::le;
+    case Instruction::ge:
+        return Instruction::lt;
+    case Instruction::eq:
+        return Instruction::ne;
+    default:
+        return Instruction::eq;
+    }
+}
+
+Instruction::OpID swap_cmp(Instruction::OpID op) {
+    switch (op) {
+    case Instruction::lt:
+        return Instruction::gt;
+    case Instruction::le:
+        return Instruction::ge;
+    case Instruction::gt:
+        return Instruction::lt;
+    case Instruction::ge:
+        return Instruction::le;
+    default:
+        return op;
+    }
+}
+
+bool get_branch_cmp(BranchInst *br, bool to_true, Value *&lhs,
+                    Instruction::OpID &op, Value *&rhs) {
+    auto cmp = br->get_condition()->dyn_cast<ICmpInst>();
+    if (cmp == nullptr)
+        return false;
+    auto zero = cmp->get_operand(1)->dyn_cast<ConstantInt>();
+    auto zext = cmp->get_operand(0)->dyn_cast<ZextInst>();
+    bool is_ne = cmp->get_instr_type() == Instruction::ne;
+    bool is_eq = cmp->get_instr_type() == Instruction::eq;
+    if ((is_ne or is_eq) and zero and zero->get_value() == 0 and zext) {
+        if (auto inner = zext->get_operand(0)->dyn_cast<ICmpInst>()) {
+            cmp = inner;
+            to_true = to_true == is_ne;
+        }
+    }
+    lhs = cmp->get_operand(0);
+    rhs = cmp->get_operand(1);
+    op = to_true ? cmp->get_instr_type() : negate_cmp(cmp->get_instr_type());
+    return true;
+}
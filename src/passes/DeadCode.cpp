@@ -1,21 +1,24 @@
 #include "DeadCode.hpp"
-#include "logging.hpp"
+#include "AnalysisManager.hpp"
 #include <vector>
 
+void DeadCode::initialize() { func_info = &am_->get_func_info(); }
+
 // 处理流程：两趟处理，mark 标记有用变量，sweep 删除无用指令
-void DeadCode::run() {
+void DeadCode::run_on_function(Function *func) {
     bool changed{};
-    func_info->run();
     do {
         changed = false;
-        for (auto &F : m_->get_functions()) {
-            auto func = &F;
-            changed |= clear_basic_blocks(func);
-            mark(func);
-            changed |= sweep(func);
-        }
+        changed |= clear_basic_blocks(func);
+        mark(func);
+        changed |= sweep(func);
     } while (changed);
-    LOG_INFO << "dead code pass erased " << ins_count << " instructions";
+}
+
+void DeadCode::merge(const FunctionPass &other) {
+    auto &dce = static_cast<const DeadCode &>(other);
+    ins_count += dce.ins_count;
+    erased_blocks_ |= dce.erased_blocks_;
 }
 
 bool DeadCode::clear_basic_blocks(Function *func) {
@@ -32,6 +35,7 @@ bool DeadCode::clear_basic_blocks(Function *func) {
         bb->erase_from_parent();
         delete bb;
     }
+    erased_blocks_ |= changed;
     return changed;
 }
 
@@ -58,7 +62,7 @@ void DeadCode::mark(Function *func) {
 
 void DeadCode::mark(Instruction *ins) {
     for (auto op : ins->get_operands()) {
-        auto def = dynamic_cast<Instruction *>(op);
+        auto def = op->dyn_cast<Instruction>();
         if (def == nullptr)
             continue;
         if (marked[def])
@@ -96,8 +100,8 @@ bool DeadCode::sweep(Function *func) {
 bool DeadCode::is_critical(Instruction *ins) {
     // 对纯函数的无用调用也可以在删除之列
     if (ins->is_call()) {
-        auto call_inst = dynamic_cast<CallInst *>(ins);
-        auto callee = dynamic_cast<Function *>(call_inst->get_operand(0));
+        auto call_inst = ins->as<CallInst>();
+        auto callee = call_inst->get_operand(0)->as<Function>();
         if (func_info->is_pure_function(callee))
             return false;
         return true;
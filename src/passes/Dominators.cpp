@@ -1,6 +1,5 @@
 #include "Dominators.hpp"
 #include "Function.hpp"
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include<map>
@@ -45,19 +44,11 @@ void Dominators::run_on_func(Function *f) {
         dom_tree_succ_blocks_.insert({bb, {}});
     }
     create_reverse_post_order(f);
-    create_dom_dfs_order(f);
-    
     create_idom(f);
-    
-    print_idom(f);
-    
-
     create_dominance_frontier(f);
     create_dom_tree_succ(f);
-    
-    dump_cfg(f);/*
-    dump_dominator_tree(f);
-    */
+    // 支配树的 dfs 序依赖上面建立的支配树后继
+    create_dom_dfs_order(f);
 }
 
 /**
@@ -250,7 +241,7 @@ void Dominators::create_dom_dfs_order(Function *f) {
  * 如果基本块没有直接支配者(如入口块)，则显示"null"。
  */
 void Dominators::print_idom(Function *f) {
-    f->get_parent()->set_print_name();
+    f->set_instr_name();
     int counter = 0;
     std::map<BasicBlock *, std::string> bb_id;
     for (auto &bb1 : f->get_basic_blocks()) {
@@ -261,18 +252,20 @@ void Dominators::print_idom(Function *f) {
             bb_id[bb] = bb->get_name();
         counter++;
     }
-    printf("Immediate dominance of function %s:\n", f->get_name().c_str());
+    // 整个函数的结果一次输出, 多个线程同时分析不同函数时不会交错
+    std::string output =
+        "Immediate dominance of function " + f->get_name() + ":\n";
     for (auto &bb1 : f->get_basic_blocks()) {
         auto bb = &bb1;
-        std::string output;
-        output = bb_id[bb] + ": ";
+        output += bb_id[bb] + ": ";
         if (get_idom(bb)) {
             output += bb_id[get_idom(bb)];
         } else {
             output += "null";
         }
-        printf("%s\n", output.c_str());
+        output += "\n";
     }
+    printf("%s", output.c_str());
 }
 
 /**
@@ -285,7 +278,7 @@ void Dominators::print_idom(Function *f) {
  * 如果基本块没有支配边界，则显示"null"。
  */
 void Dominators::print_dominance_frontier(Function *f) {
-    f->get_parent()->set_print_name();
+    f->set_instr_name();
     int counter = 0;
     std::map<BasicBlock *, std::string> bb_id;
     for (auto &bb1 : f->get_basic_blocks()) {
@@ -296,11 +289,11 @@ void Dominators::print_dominance_frontier(Function *f) {
             bb_id[bb] = bb->get_name();
         counter++;
     }
-    printf("Dominance Frontier of function %s:\n", f->get_name().c_str());
+    std::string output =
+        "Dominance Frontier of function " + f->get_name() + ":\n";
     for (auto &bb1 : f->get_basic_blocks()) {
         auto bb = &bb1;
-        std::string output;
-        output = bb_id[bb] + ": ";
+        output += bb_id[bb] + ": ";
         if (get_dominance_frontier(bb).empty()) {
             output += "null";
         } else {
@@ -314,97 +307,69 @@ void Dominators::print_dominance_frontier(Function *f) {
                 output += bb_id[df];
             }
         }
-        printf("%s\n", output.c_str());
+        output += "\n";
+    }
+    printf("%s", output.c_str());
+}
+
+namespace {
+
+// 把 edges 写成 .dot 的有向图; 没有边时单独写出入口块, 使只有一个基本块的函数也能显示
+void write_digraph(Function *f,
+                   const std::vector<std::pair<BasicBlock *, BasicBlock *>> &edges,
+                   std::ostream &os) {
+    auto id = [](BasicBlock *bb) { return '"' + bb->get_name() + '"'; };
+    os << "digraph \"" << f->get_name() << "\" {\n";
+    if (edges.empty() && !f->get_basic_blocks().empty()) {
+        os << '\t' << id(f->get_entry_block()) << ";\n";
+    }
+    for (auto &[from, to] : edges) {
+        os << '\t' << id(from) << " -> " << id(to) << ";\n";
     }
+    os << "}\n";
 }
 
+} // namespace
+
 /**
- * @brief 将函数的控制流图(CFG)导出为图形文件
+ * @brief 将函数的控制流图(CFG)以 DOT 格式写入 os
  * @param f 要导出的函数
- * 
- * 该函数生成函数的控制流图的DOT格式描述，并使用graphviz将其转换为PNG图像。
- * 生成两个文件：
- * - {函数名}_cfg.dot：DOT格式的图形描述
- * - {函数名}_cfg.png：可视化的控制流图
+ * @param os 输出流
+ *
+ * 只生成 DOT 文本, 不调用 graphviz 等外部程序。
  */
-void Dominators::dump_cfg(Function *f)
+void Dominators::dump_cfg(Function *f, std::ostream &os)
 {
-    f->get_parent()->set_print_name();
     if(f->is_declaration())
         return;
-    std::vector<std::string> edge_set;
-    bool has_edges = false;
+    f->set_instr_name();
+    std::vector<std::pair<BasicBlock *, BasicBlock *>> edges;
     for (auto &bb : f->get_basic_blocks()) {
-        auto succ_blocks = bb.get_succ_basic_blocks();
-        if(!succ_blocks.empty())
-            has_edges = true;
-        for (auto succ : succ_blocks) {
-            edge_set.push_back('\t' + bb.get_name() + "->" + succ->get_name() + ";\n");
-        }
-    }
-    std::string digraph = "digraph G {\n";
-    if (!has_edges && !f->get_basic_blocks().empty()) {
-        // 如果没有边且至少有一个基本块，添加一个自环以显示唯一的基本块
-        auto &bb = f->get_basic_blocks().front();
-        digraph += '\t' + bb.get_name() + ";\n";
-    } else {
-        for (auto &edge : edge_set) {
-            digraph += edge;
+        for (auto succ : bb.get_succ_basic_blocks()) {
+            edges.emplace_back(&bb, succ);
         }
     }
-    digraph += "}\n";
-    std::ofstream file_output;
-    file_output.open(f->get_name() + "_cfg.dot", std::ios::out);
-    file_output << digraph;
-    file_output.close();
-    std::string dot_cmd = "dot -Tpng " + f->get_name() + "_cfg.dot" + " -o " + f->get_name() + "_cfg.png";
-    std::system(dot_cmd.c_str());
+    write_digraph(f, edges, os);
 }
 
 /**
- * @brief 将函数的支配树导出为图形文件
- * @param f 要导出的函数
- * 
- * 该函数生成函数的支配树的DOT格式描述，并使用graphviz将其转换为PNG图像。
- * 生成两个文件：
- * - {函数名}_dom_tree.dot：DOT格式的图形描述
- * - {函数名}_dom_tree.png：可视化的支配树
+ * @brief 将函数的支配树以 DOT 格式写入 os
+ * @param f 要导出的函数, 需要先对它执行 run_on_func
+ * @param os 输出流
+ *
+ * 每条边从直接支配者指向被支配的基本块。
  */
-void Dominators::dump_dominator_tree(Function *f)
+void Dominators::dump_dominator_tree(Function *f, std::ostream &os)
 {
-    f->get_parent()->set_print_name();
     if(f->is_declaration())
         return;
-
-    std::vector<std::string> edge_set;
-    bool has_edges = false; // 用于检查是否有边存在
-
+    f->set_instr_name();
+    std::vector<std::pair<BasicBlock *, BasicBlock *>> edges;
     for (auto &b : f->get_basic_blocks()) {
-        if (idom_.find(&b) != idom_.end() && idom_[&b] != &b) {
-            edge_set.push_back('\t' + idom_[&b]->get_name() + "->" + b.get_name() + ";\n");
-            has_edges = true; // 如果存在支配边，标记为 true
-        }
-    }
-
-    std::string digraph = "digraph G {\n";
-
-    if (!has_edges && !f->get_basic_blocks().empty()) {
-        // 如果没有边且至少有一个基本块，直接添加该块以显示它
-        auto &b = f->get_basic_blocks().front();
-        digraph += '\t' + b.get_name() + ";\n";
-    } else {
-        for (auto &edge : edge_set) {
-            digraph += edge;
+        auto idom = get_idom(&b);
+        if (idom && idom != &b) {
+            edges.emplace_back(idom, &b);
         }
     }
-
-    digraph += "}\n";
-
-    std::ofstream file_output;
-    file_output.open(f->get_name() + "_dom_tree.dot", std::ios::out);
-    file_output << digraph;
-    file_output.close();
-
-    std::string dot_cmd = "dot -Tpng " + f->get_name() + "_dom_tree.dot" + " -o " + f->get_name() + "_dom_tree.png";
-    std::system(dot_cmd.c_str());
-}
\ No newline at end of file
+    write_digraph(f, edges, os);
+}
@@ -51,7 +51,7 @@ void FuncInfo::trivial_mark(Function *func) {
 void FuncInfo::process(Function *func) {
     for (auto &use : func->get_use_list()) {
         LOG_INFO << use.val_->print() << " uses func: " << func->get_name();
-        if (auto inst = dynamic_cast<Instruction *>(use.val_)) {
+        if (auto inst = use.val_->dyn_cast<Instruction>()) {
             auto func = (inst->get_parent()->get_parent());
             if (is_pure[func]) {
                 is_pure[func] = false;
@@ -65,12 +65,12 @@ void FuncInfo::process(Function *func) {
 // 对局部变量进行 store 没有副作用
 bool FuncInfo::is_side_effect_inst(Instruction *inst) {
     if (inst->is_store()) {
-        if (is_local_store(dynamic_cast<StoreInst *>(inst)))
+        if (is_local_store(inst->as<StoreInst>()))
             return false;
         return true;
     }
     if (inst->is_load()) {
-        if (is_local_load(dynamic_cast<LoadInst *>(inst)))
+        if (is_local_load(inst->as<LoadInst>()))
             return false;
         return true;
     }
@@ -80,20 +80,20 @@ bool FuncInfo::is_side_effect_inst(Instruction *inst) {
 
 bool FuncInfo::is_local_load(LoadInst *inst) {
     auto addr =
-        dynamic_cast<Instruction *>(get_first_addr(inst->get_operand(0)));
+        get_first_addr(inst->get_operand(0))->dyn_cast<Instruction>();
     if (addr and addr->is_alloca())
         return true;
     return false;
 }
 
 bool FuncInfo::is_local_store(StoreInst *inst) {
-    auto addr = dynamic_cast<Instruction *>(get_first_addr(inst->get_lval()));
+    auto addr = get_first_addr(inst->get_lval())->dyn_cast<Instruction>();
     if (addr and addr->is_alloca())
         return true;
     return false;
 }
 Value *FuncInfo::get_first_addr(Value *val) {
-    if (auto inst = dynamic_cast<Instruction *>(val)) {
+    if (auto inst = val->dyn_cast<Instruction>()) {
         if (inst->is_alloca())
             return inst;
         if (inst->is_gep())
@@ -0,0 +1,186 @@
+#include "GVN.hpp"
+
+#include "AliasAnalysis.hpp"
+#include "AnalysisManager.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "HashMap.hpp"
+
+#include <utility>
+
+std::size_t GVN::ExpressionHash::operator()(const Expression &expr) const {
+    auto seed = hash_combine(HashMix()(static_cast<unsigned>(expr.op)),
+                             HashMix()(expr.type));
+    for (auto op : expr.operands)
+        seed = hash_combine(seed, HashMix()(op));
+    return seed;
+}
+
+void GVN::initialize() { func_info_ = &am_->get_func_info(); }
+
+void GVN::run_on_function(Function *func) {
+    dominators_ = &am_->get_dominators(func);
+    compute_escaped_allocas(func);
+    visit(func->get_entry_block(), {});
+    for (auto inst : wait_delete_) {
+        inst->remove_all_operands();
+        inst->get_parent()->erase_instr(inst);
+    }
+    wait_delete_.clear();
+}
+
+void GVN::merge(const FunctionPass &other) {
+    auto &gvn = static_cast<const GVN &>(other);
+    eliminated_ += gvn.eliminated_;
+    loads_ += gvn.loads_;
+}
+
+/**
+ * @brief 处理 bb, 然后递归处理它在支配树中的子结点
+ * @param bb 当前基本块
+ * @param parent_loads 直接支配者结束时各地址上已知的值
+ */
+void GVN::visit(BasicBlock *bb, const AvailableLoads &parent_loads) {
+    AvailableLoads loads;
+    auto &pre_bbs = bb->get_pre_basic_blocks();
+    if (pre_bbs.size() == 1 and pre_bbs.front() == dominators_->get_idom(bb))
+        loads = parent_loads;
+
+    std::vector<Expression> inserted;
+    for (auto &inst1 : bb->get_instructions()) {
+        auto inst = &inst1;
+        if (inst->is_load()) {
+            auto ptr = inst->get_operand(0);
+            auto it = loads.find(ptr);
+            if (it != loads.end()) {
+                replace(inst, it->second);
+                loads_++;
+            } else {
+                loads[ptr] = inst;
+            }
+            continue;
+        }
+        if (inst->is_store()) {
+            auto store = inst->as<StoreInst>();
+            kill_aliasing(loads, store->get_lval());
+            loads[store->get_lval()] = store->get_rval();
+            continue;
+        }
+        if (not is_numbered(inst)) {
+            if (inst->is_call())
+                kill_on_call(loads);
+            continue;
+        }
+        auto expr = get_expression(inst);
+        auto it = table_.find(expr);
+        if (it != table_.end()) {
+            replace(inst, it->second);
+            eliminated_++;
+        } else {
+            table_.emplace(expr, inst);
+            inserted.push_back(std::move(expr));
+        }
+    }
+
+    for (auto succ : dominators_->get_dom_tree_succ_blocks(bb))
+        visit(succ, loads);
+    // 离开子树, 其中的指令不再支配之后访问的块
+    for (auto &expr : inserted)
+        table_.erase(expr);
+}
+
+// 纯函数不读写内存, 对它的调用与算术指令一样只取决于操作数
+bool GVN::is_numbered(Instruction *inst) {
+    if (inst->isBinary() or inst->is_cmp() or inst->is_fcmp() or
+        inst->is_gep() or inst->is_zext() or inst->is_fp2si() or
+        inst->is_si2fp())
+        return true;
+    if (inst->is_call() and not inst->is_void()) {
+        auto callee = inst->get_operand(0)->as<Function>();
+        return func_info_->is_pure_function(callee);
+    }
+    return false;
+}
+
+GVN::Expression GVN::get_expression(Instruction *inst) {
+    Expression expr{inst->get_instr_type(), inst->get_type(),
+                    {inst->get_operands().begin(), inst->get_operands().end()}};
+    auto &ops = expr.operands;
+    switch (expr.op) {
+    case Instruction::add:
+    case Instruction::mul:
+    case Instruction::fadd:
+    case Instruction::fmul:
+    case Instruction::eq:
+    case Instruction::ne:
+    case Instruction::feq:
+    case Instruction::fne:
+        if (CreationOrder()(ops[1], ops[0]))
+            std::swap(ops[0], ops[1]);
+        break;
+    case Instruction::gt:
+        expr.op = Instruction::lt;
+        std::swap(ops[0], ops[1]);
+        break;
+    case Instruction::ge:
+        expr.op = Instruction::le;
+        std::swap(ops[0], ops[1]);
+        break;
+    case Instruction::fgt:
+        expr.op = Instruction::flt;
+        std::swap(ops[0], ops[1]);
+        break;
+    case Instruction::fge:
+        expr.op = Instruction::fle;
+        std::swap(ops[0], ops[1]);
+        break;
+    default:
+        break;
+    }
+    return expr;
+}
+
+void GVN::replace(Instruction *inst, Value *leader) {
+    inst->replace_all_use_with(leader);
+    wait_delete_.push_back(inst);
+}
+
+// 地址被传给函数调用或被存入内存的 alloca, 调用可能读写它的内容
+void GVN::compute_escaped_allocas(Function *func) {
+    escaped_allocas_.clear();
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (inst.is_call()) {
+                for (unsigned i = 1; i < inst.get_num_operand(); i++) {
+                    auto arg = inst.get_operand(i);
+                    if (arg->get_type()->is_pointer_type())
+                        escaped_allocas_.insert(get_base(arg));
+                }
+            } else if (inst.is_store()) {
+                auto val = inst.as<StoreInst>()->get_rval();
+                if (val->get_type()->is_pointer_type())
+                    escaped_allocas_.insert(get_base(val));
+            }
+        }
+    }
+}
+
+void GVN::kill_aliasing(AvailableLoads &loads, Value *ptr) {
+    for (auto it = loads.begin(); it != loads.end();) {
+        if (may_alias(it->first, ptr))
+            it = loads.erase(it);
+        else
+            ++it;
+    }
+}
+
+// 非纯函数可能写入全局变量与传入的数组, 只有地址没有逃逸的 alloca 不受影响
+void GVN::kill_on_call(AvailableLoads &loads) {
+    for (auto it = loads.begin(); it != loads.end();) {
+        auto base = get_base(it->first);
+        if (base->is<AllocaInst>() and not escaped_allocas_.count(base))
+            ++it;
+        else
+            it = loads.erase(it);
+    }
+}
@@ -0,0 +1,47 @@
+#include "GraphDump.hpp"
+#include "Dominators.hpp"
+
+#include <fstream>
+#include <functional>
+#include <system_error>
+
+namespace {
+
+bool write_file(const std::filesystem::path &path,
+                const std::function<void(std::ostream &)> &write) {
+    std::ofstream file(path);
+    if (not file)
+        return false;
+    write(file);
+    return static_cast<bool>(file);
+}
+
+} // namespace
+
+bool dump_graphs(Module *m, const GraphDumpOptions &options) {
+    std::error_code ec;
+    std::filesystem::create_directories(options.dir, ec);
+    if (ec)
+        return false;
+    for (auto &func : m->get_functions()) {
+        auto f = &func;
+        if (f->is_declaration())
+            continue;
+        if (options.cfg and
+            not write_file(options.dir / (f->get_name() + "_cfg.dot"),
+                           [&](std::ostream &os) {
+                               Dominators::dump_cfg(f, os);
+                           }))
+            return false;
+        if (options.domtree) {
+            Dominators dom(m);
+            dom.run_on_func(f);
+            if (not write_file(options.dir / (f->get_name() + "_dom_tree.dot"),
+                               [&](std::ostream &os) {
+                                   dom.dump_dominator_tree(f, os);
+                               }))
+                return false;
+        }
+    }
+    return true;
+}
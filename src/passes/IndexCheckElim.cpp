@@ -0,0 +1,307 @@
+#include "IndexCheckElim.hpp"
+
+#include "AnalysisManager.hpp"
+#include "BasicBlock.hpp"
+#include "CmpUtils.hpp"
+#include "Function.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// 区间分析展开表达式的最大深度
+constexpr int max_depth = 16;
+
+// 经唯一前驱的条件分支进入 bb 时成立的整数比较 lhs op rhs
+bool get_edge_relation(BasicBlock *bb, Value *&lhs, Instruction::OpID &op,
+                       Value *&rhs) {
+    auto &pre_bbs = bb->get_pre_basic_blocks();
+    if (pre_bbs.size() != 1 or not pre_bbs.front()->is_terminated())
+        return false;
+    auto br = pre_bbs.front()->get_terminator()->dyn_cast<BranchInst>();
+    if (br == nullptr or not br->is_cond_br() or
+        br->get_operand(1) == br->get_operand(2))
+        return false;
+    return get_branch_cmp(br, br->get_operand(1) == bb, lhs, op, rhs);
+}
+
+} // namespace
+
+void IndexCheckElim::run_on_function(Function *func) {
+    dominators_ = &am_->get_dominators(func);
+    header_loop_.clear();
+    for (auto &loop : am_->get_loops(func).get_loops())
+        header_loop_[loop->get_header()] = loop.get();
+    facts_.clear();
+    range_cache_.clear();
+    visiting_.clear();
+    redundant_checks_.clear();
+
+    // 先在原来的控制流图上完成分析, 再统一改写
+    visit(func->get_entry_block());
+    if (redundant_checks_.empty())
+        return;
+    for (auto br : redundant_checks_)
+        eliminate(br);
+    remove_unreachable_blocks(func);
+}
+
+void IndexCheckElim::merge(const FunctionPass &other) {
+    eliminated_ += static_cast<const IndexCheckElim &>(other).eliminated_;
+}
+
+/**
+ * @brief 按支配树先序遍历, 记录支配当前块的分支给出的关系并判断块末尾的下标检查
+ * @param bb 当前基本块
+ */
+void IndexCheckElim::visit(BasicBlock *bb) {
+    std::vector<Value *> added;
+    collect_edge_facts(bb, added);
+
+    if (bb->is_terminated()) {
+        auto br = bb->get_terminator()->dyn_cast<BranchInst>();
+        auto cmp = br && br->is_cond_br()
+                       ? br->get_condition()->dyn_cast<ICmpInst>()
+                       : nullptr;
+        auto zero = cmp ? cmp->get_operand(1)->dyn_cast<ConstantInt>()
+                        : nullptr;
+        if (cmp and cmp->get_instr_type() == Instruction::lt and zero and
+            zero->get_value() == 0 and
+            get_range(cmp->get_operand(0), true).lo >= 0)
+            redundant_checks_.push_back(br);
+    }
+
+    for (auto succ : dominators_->get_dom_tree_succ_blocks(bb))
+        visit(succ);
+    for (auto val : added)
+        facts_[val].pop_back();
+}
+
+void IndexCheckElim::collect_edge_facts(BasicBlock *bb,
+                                        std::vector<Value *> &added) {
+    Value *lhs, *rhs;
+    Instruction::OpID op;
+    if (not get_edge_relation(bb, lhs, op, rhs))
+        return;
+    add_fact(lhs, op, rhs, added);
+    add_fact(rhs, swap_cmp(op), lhs, added);
+}
+
+void IndexCheckElim::add_fact(Value *val, Instruction::OpID op, Value *other,
+                              std::vector<Value *> &added) {
+    if (val->is<Constant>())
+        return;
+    facts_[val].push_back({op, other});
+    added.push_back(val);
+}
+
+IndexCheckElim::Range IndexCheckElim::get_range(Value *val, bool use_facts,
+                                                int depth) {
+    if (use_facts)
+        return compute_range(val, true, depth);
+    auto it = range_cache_.find(val);
+    if (it != range_cache_.end())
+        return it->second;
+    // 沿 phi 回到自身时不再展开
+    if (not visiting_.insert(val).second)
+        return Range::full();
+    auto range = compute_range(val, false, depth);
+    visiting_.erase(val);
+    range_cache_[val] = range;
+    return range;
+}
+
+IndexCheckElim::Range IndexCheckElim::compute_range(Value *val, bool use_facts,
+                                                    int depth) {
+    if (auto c = val->dyn_cast<ConstantInt>())
+        return {c->get_value(), c->get_value()};
+    auto range = Range::full();
+    auto inst = val->dyn_cast<Instruction>();
+    if (inst and depth < max_depth) {
+        auto operand = [&](unsigned i) {
+            return get_range(inst->get_operand(i), use_facts, depth + 1);
+        };
+        switch (inst->get_instr_type()) {
+        case Instruction::add: {
+            auto lhs = operand(0), rhs = operand(1);
+            range = {lhs.lo + rhs.lo, lhs.hi + rhs.hi};
+            break;
+        }
+        case Instruction::sub: {
+            auto lhs = operand(0), rhs = operand(1);
+            range = {lhs.lo - rhs.hi, lhs.hi - rhs.lo};
+            break;
+        }
+        case Instruction::mul: {
+            auto lhs = operand(0), rhs = operand(1);
+            int64_t corners[] = {lhs.lo * rhs.lo, lhs.lo * rhs.hi,
+                                 lhs.hi * rhs.lo, lhs.hi * rhs.hi};
+            range = {*std::min_element(corners, corners + 4),
+                     *std::max_element(corners, corners + 4)};
+            break;
+        }
+        case Instruction::sdiv: {
+            auto lhs = operand(0), rhs = operand(1);
+            if (rhs.lo == rhs.hi and rhs.lo > 0)
+                range = {lhs.lo / rhs.lo, lhs.hi / rhs.lo};
+            break;
+        }
+        case Instruction::zext:
+            range = {0, 1};
+            break;
+        case Instruction::phi: {
+            auto phi = inst->as<PhiInst>();
+            auto it = header_loop_.find(phi->get_parent());
+            if (it != header_loop_.end()) {
+                range = induction_range(phi, it->second);
+                break;
+            }
+            // 各来源值的并集, 来源值在前驱中取得, 不能使用当前位置的关系
+            range = {INT64_MAX, INT64_MIN};
+            for (auto &[in_val, in_bb] : phi->get_phi_pairs()) {
+                auto in_range = get_range(in_val, false, depth + 1);
+                range.lo = std::min(range.lo, in_range.lo);
+                range.hi = std::max(range.hi, in_range.hi);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        // 运算可能回绕时结果可以是任何值
+        if (not range.fits())
+            range = Range::full();
+    }
+    if (use_facts)
+        range = apply_facts(val, range);
+    return range;
+}
+
+/**
+ * @brief 循环头 phi 的取值范围
+ *
+ * 经回边流入的值都是 phi + c (c 为正常数), 且在加法处由循环条件可知 phi + c
+ * 不超过 INT32_MAX 时, phi 从入口值开始单调递增, 下界为入口值的下界。
+ */
+IndexCheckElim::Range IndexCheckElim::induction_range(PhiInst *phi,
+                                                      Loop *loop) {
+    int64_t lo = INT64_MAX;
+    for (auto &[in_val, in_bb] : phi->get_phi_pairs()) {
+        if (not loop->get_latches().count(in_bb)) {
+            lo = std::min(lo, get_range(in_val, false).lo);
+            continue;
+        }
+        auto inc = in_val->dyn_cast<IBinaryInst>();
+        if (inc == nullptr or not inc->is_add())
+            return Range::full();
+        auto step_val = inc->get_operand(0) == phi ? inc->get_operand(1)
+                                                   : inc->get_operand(0);
+        auto step = step_val->dyn_cast<ConstantInt>();
+        if ((inc->get_operand(0) != phi and inc->get_operand(1) != phi) or
+            step == nullptr or step->get_value() <= 0)
+            return Range::full();
+        if (upper_bound_at(phi, inc->get_parent(), loop->get_header()) +
+                step->get_value() >
+            INT32_MAX)
+            return Range::full();
+    }
+    return {lo, INT32_MAX};
+}
+
+IndexCheckElim::Range IndexCheckElim::apply_facts(Value *val, Range range) {
+    auto it = facts_.find(val);
+    if (it == facts_.end())
+        return range;
+    for (auto &fact : it->second) {
+        auto other = get_range(fact.other, false);
+        switch (fact.op) {
+        case Instruction::lt:
+            range.hi = std::min(range.hi, other.hi - 1);
+            break;
+        case Instruction::le:
+            range.hi = std::min(range.hi, other.hi);
+            break;
+        case Instruction::gt:
+            range.lo = std::max(range.lo, other.lo + 1);
+            break;
+        case Instruction::ge:
+            range.lo = std::max(range.lo, other.lo);
+            break;
+        case Instruction::eq:
+            range.lo = std::max(range.lo, other.lo);
+            range.hi = std::min(range.hi, other.hi);
+            break;
+        default:
+            break;
+        }
+    }
+    return range;
+}
+
+int64_t IndexCheckElim::upper_bound_at(Value *val, BasicBlock *bb,
+                                       BasicBlock *stop) {
+    int64_t hi = INT32_MAX;
+    for (auto cur = bb; cur and cur != stop; cur = dominators_->get_idom(cur)) {
+        Value *lhs, *rhs;
+        Instruction::OpID op;
+        if (not get_edge_relation(cur, lhs, op, rhs))
+            continue;
+        if (rhs == val) {
+            std::swap(lhs, rhs);
+            op = swap_cmp(op);
+        }
+        if (lhs != val)
+            continue;
+        auto other = get_range(rhs, false);
+        if (op == Instruction::lt)
+            hi = std::min(hi, other.hi - 1);
+        else if (op == Instruction::le or op == Instruction::eq)
+            hi = std::min(hi, other.hi);
+    }
+    return hi;
+}
+
+// 检查的条件总为假: 改为直接跳到访问数组的块
+void IndexCheckElim::eliminate(BranchInst *br) {
+    auto bb = br->get_parent();
+    auto except_bb = br->get_operand(1)->as<BasicBlock>();
+    auto cont_bb = br->get_operand(2)->as<BasicBlock>();
+    bb->erase_instr(br);
+    BranchInst::create_br(cont_bb, bb);
+    if (except_bb != cont_bb) {
+        for (auto &inst : except_bb->get_instructions()) {
+            if (not inst.is_phi())
+                break;
+            inst.as<PhiInst>()->remove_phi_operand(bb);
+        }
+    }
+    eliminated_++;
+}
+
+void IndexCheckElim::remove_unreachable_blocks(Function *func) {
+    while (true) {
+        std::vector<BasicBlock *> dead_blocks;
+        for (auto &bb : func->get_basic_blocks()) {
+            if (&bb != func->get_entry_block() and
+                bb.get_pre_basic_blocks().empty())
+                dead_blocks.push_back(&bb);
+        }
+        if (dead_blocks.empty())
+            return;
+        for (auto bb : dead_blocks) {
+            for (auto succ : bb->get_succ_basic_blocks()) {
+                for (auto &inst : succ->get_instructions()) {
+                    if (not inst.is_phi())
+                        break;
+                    inst.as<PhiInst>()->remove_phi_operand(bb);
+                }
+            }
+            for (auto &inst : bb->get_instructions())
+                inst.remove_all_operands();
+        }
+        for (auto bb : dead_blocks) {
+            bb->erase_from_parent();
+            delete bb;
+        }
+    }
+}
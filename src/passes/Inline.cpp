@@ -0,0 +1,287 @@
+#include "Inline.hpp"
+
+#include "AnalysisManager.hpp"
+#include "BasicBlock.hpp"
+#include "Cloning.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
+namespace {
+
+// 调用者内联后的指令数上限, 防止代码无限膨胀
+constexpr unsigned max_caller_size = 2000;
+// 循环深度对阈值的加成最多计算到这一层
+constexpr unsigned max_loop_bonus = 3;
+
+// 内联的代价: 指令数, alloca 被移到入口块, 不计入
+unsigned get_size(Function *func) {
+    unsigned size = 0;
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (not inst.is_alloca())
+                size++;
+        }
+    }
+    return size;
+}
+
+// 从入口可达的块, 按在函数中的顺序; builder 在 return 之后生成的不可达块不被复制
+std::vector<BasicBlock *> get_reachable_blocks(Function *func) {
+    std::unordered_set<BasicBlock *> reachable{func->get_entry_block()};
+    std::vector<BasicBlock *> work_list{func->get_entry_block()};
+    while (not work_list.empty()) {
+        auto bb = work_list.back();
+        work_list.pop_back();
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (reachable.insert(succ).second)
+                work_list.push_back(succ);
+        }
+    }
+    std::vector<BasicBlock *> blocks;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (reachable.count(&bb))
+            blocks.push_back(&bb);
+    }
+    return blocks;
+}
+
+/* builder 为负下标生成的出口: call neg_idx_except; ret。
+ * neg_idx_except 直接结束程序, 之后的 ret 不会执行 */
+bool is_error_exit(BasicBlock *bb) {
+    auto &insts = bb->get_instructions();
+    if (insts.size() < 2 or not bb->get_terminator()->is_ret())
+        return false;
+    auto call = std::prev(insts.end(), 2)->dyn_cast<CallInst>();
+    return call and call->get_operand(0)->get_name() == "neg_idx_except";
+}
+
+// 没有可达的 ret 的函数 (例如死循环) 调用之后的部分不可达, 不内联
+bool has_return(Function *func) {
+    for (auto bb : get_reachable_blocks(func)) {
+        if (bb->get_terminator()->is_ret() and not is_error_exit(bb))
+            return true;
+    }
+    return false;
+}
+
+// 以 func 的返回类型在 bb 末尾返回, 与 builder 在负下标出口中生成的相同
+void create_error_ret(Function *func, BasicBlock *bb, Module *m) {
+    auto type = func->get_return_type();
+    if (type->is_void_type())
+        ReturnInst::create_void_ret(bb);
+    else if (type->is_float_type())
+        ReturnInst::create_ret(ConstantFP::get(0., m), bb);
+    else
+        ReturnInst::create_ret(ConstantInt::get(0, m), bb);
+}
+
+} // namespace
+
+void Inliner::run() {
+    callees_.clear();
+    recursive_.clear();
+    index_.clear();
+    low_.clear();
+    bottom_up_.clear();
+
+    build_call_graph();
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration() and not index_.count(&func))
+            find_sccs(&func);
+    }
+    for (auto caller : bottom_up_)
+        run_on_caller(caller);
+}
+
+void Inliner::build_call_graph() {
+    for (auto &func : m_->get_functions()) {
+        auto &callees = callees_[&func];
+        for (auto &bb : func.get_basic_blocks()) {
+            for (auto &inst : bb.get_instructions()) {
+                if (not inst.is_call())
+                    continue;
+                auto callee = inst.get_operand(0)->as<Function>();
+                if (not callee->is_declaration() and
+                    std::find(callees.begin(), callees.end(), callee) ==
+                        callees.end())
+                    callees.push_back(callee);
+            }
+        }
+    }
+}
+
+// Tarjan 算法: 一个强连通分量的所有被调用者都在它之前放入 bottom_up_
+void Inliner::find_sccs(Function *func) {
+    auto idx = static_cast<unsigned>(index_.size());
+    index_[func] = low_[func] = idx;
+    stack_.push_back(func);
+    on_stack_.insert(func);
+    for (auto callee : callees_[func]) {
+        if (not index_.count(callee)) {
+            find_sccs(callee);
+            low_[func] = std::min(low_[func], low_[callee]);
+        } else if (on_stack_.count(callee)) {
+            low_[func] = std::min(low_[func], index_[callee]);
+        }
+    }
+    if (low_[func] != index_[func])
+        return;
+
+    std::vector<Function *> scc;
+    do {
+        scc.push_back(stack_.back());
+        stack_.pop_back();
+        on_stack_.erase(scc.back());
+    } while (scc.back() != func);
+    auto &callees = callees_[func];
+    if (scc.size() > 1 or
+        std::find(callees.begin(), callees.end(), func) != callees.end())
+        recursive_.insert(scc.begin(), scc.end());
+    bottom_up_.insert(bottom_up_.end(), scc.rbegin(), scc.rend());
+}
+
+bool Inliner::is_inlinable(Function *caller, Function *callee) {
+    return not callee->is_declaration() and callee != caller and
+           not recursive_.count(callee) and has_return(callee);
+}
+
+/**
+ * @brief 按代价模型内联 caller 中的调用
+ *
+ * 调用处按在函数中出现的顺序处理; 循环深度在内联前计算, 复制进来的调用不再考虑。
+ */
+void Inliner::run_on_caller(Function *caller) {
+    std::unordered_map<BasicBlock *, unsigned> loop_depth;
+    for (auto &loop : am_->get_loops(caller).get_loops()) {
+        // 外层循环的块包含内层循环的块
+        for (auto bb : loop->get_blocks())
+            loop_depth[bb]++;
+    }
+
+    std::vector<std::pair<CallInst *, unsigned>> call_sites;
+    for (auto &bb : caller->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (inst.is_call() and
+                is_inlinable(caller, inst.get_operand(0)->as<Function>()))
+                call_sites.emplace_back(inst.as<CallInst>(), loop_depth[&bb]);
+        }
+    }
+
+    auto size = get_size(caller);
+    for (auto &[call, depth] : call_sites) {
+        auto cost = get_size(call->get_operand(0)->as<Function>());
+        if (cost > threshold_ << std::min(depth, max_loop_bonus) or
+            size + cost > max_caller_size)
+            continue;
+        inline_call(call);
+        size += cost;
+        inlined_++;
+    }
+}
+
+/**
+ * @brief 把 call 替换为被调用函数的函数体
+ *
+ * 变换后的结构为
+ *   bb:     call 之前的指令; br 被调用者入口的副本
+ *   副本:   被调用者的各块, ret v 改为 br after
+ *   after:  %r = phi [v, 返回所在的块] ...; call 之后的指令
+ */
+void Inliner::inline_call(CallInst *call) {
+    auto bb = call->get_parent();
+    auto caller = bb->get_parent();
+    auto callee = call->get_operand(0)->as<Function>();
+    // 新建的块都放在 bb 原来的下一个块之前
+    auto &blocks = caller->get_basic_blocks();
+    auto pos = std::next(bb->getIterator());
+
+    // call 之后的指令移入 after, 原来的后继改为 after 的后继
+    auto after = BasicBlock::create(m_, "", caller);
+    std::vector<Instruction *> tail;
+    for (auto it = std::next(call->getIterator());
+         it != bb->get_instructions().end(); ++it)
+        tail.push_back(&*it);
+    for (auto inst : tail) {
+        bb->remove_instr(inst);
+        after->add_instruction(inst);
+        inst->set_parent(after);
+    }
+    for (auto succ : bb->get_succ_basic_blocks()) {
+        auto &pre_bbs = succ->get_pre_basic_blocks();
+        std::replace(pre_bbs.begin(), pre_bbs.end(), bb, after);
+        after->add_succ_basic_block(succ);
+        for (auto &inst : succ->get_instructions()) {
+            if (not inst.is_phi())
+                break;
+            for (unsigned i = 1; i < inst.get_num_operand(); i += 2) {
+                if (inst.get_operand(i) == bb)
+                    inst.set_operand(i, after);
+            }
+        }
+    }
+    bb->get_succ_basic_blocks().clear();
+
+    ValueMap value_map;
+    unsigned arg_no = 1;
+    for (auto &arg : callee->get_args())
+        value_map[&arg] = call->get_operand(arg_no++);
+    auto callee_blocks = get_reachable_blocks(callee);
+    auto new_blocks = clone_blocks(callee_blocks, caller, value_map);
+
+    for (auto new_bb : new_blocks) {
+        blocks.remove(new_bb);
+        blocks.insert(pos, new_bb);
+    }
+    blocks.remove(after);
+    blocks.insert(pos, after);
+
+    auto entry = caller->get_entry_block();
+    std::vector<Value *> ret_vals;
+    std::vector<BasicBlock *> ret_bbs;
+    for (unsigned i = 0; i < new_blocks.size(); i++) {
+        auto new_bb = new_blocks[i];
+        std::vector<Instruction *> allocas;
+        for (auto &inst : new_bb->get_instructions()) {
+            if (inst.is_alloca())
+                allocas.push_back(&inst);
+        }
+        for (auto it = allocas.rbegin(); it != allocas.rend(); ++it) {
+            new_bb->remove_instr(*it);
+            entry->add_instr_begin(*it);
+            (*it)->set_parent(entry);
+        }
+
+        /* 返回改为跳到 after; 负下标出口仍是死路, 不与 after 合流,
+         * 否则其中未定值的局部变量会流入调用之后的代码 */
+        auto ret = callee_blocks[i]->get_terminator()->dyn_cast<ReturnInst>();
+        if (ret == nullptr)
+            continue;
+        if (is_error_exit(callee_blocks[i])) {
+            create_error_ret(caller, new_bb, m_);
+            continue;
+        }
+        if (not ret->is_void_ret()) {
+            ret_vals.push_back(map_value(value_map, ret->get_operand(0)));
+            ret_bbs.push_back(new_bb);
+        }
+        BranchInst::create_br(after, new_bb);
+    }
+
+    if (not call->is_void()) {
+        Value *result = ret_vals.front();
+        if (ret_vals.size() > 1) {
+            auto phi = PhiInst::create_phi(call->get_type(), after, ret_vals,
+                                           ret_bbs);
+            after->add_instr_begin(phi);
+            result = phi;
+        }
+        call->replace_all_use_with(result);
+    }
+    call->remove_all_operands();
+    bb->erase_instr(call);
+    BranchInst::create_br(new_blocks.front(), bb);
+}
@@ -1,30 +1,32 @@
+#include "AliasAnalysis.hpp"
+#include "AnalysisManager.hpp"
 #include "BasicBlock.hpp"
 #include "Constant.hpp"
 #include "Function.hpp"
-#include "GlobalVariable.hpp"
 #include "IRBuilder.hpp"
 #include "Instruction.hpp"
 #include "LICM.hpp"
 #include "PassManager.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <vector>
 
+void LoopInvariantCodeMotion::initialize() {
+    func_info_ = &am_->get_func_info();
+}
+
 /**
- * @brief 循环不变式外提Pass的主入口函数
+ * @brief 循环不变式外提Pass对单个函数的入口
  * 
  */
-void LoopInvariantCodeMotion::run() {
-
-    loop_detection_ = std::make_unique<LoopDetection>(m_);
-    loop_detection_->run();
-    func_info_ = std::make_unique<FuncInfo>(m_);
-    func_info_->run();
-    for (auto &loop : loop_detection_->get_loops()) {
+void LoopInvariantCodeMotion::run_on_function(Function *func) {
+    dominators_ = &am_->get_dominators(func);
+    auto &loops = am_->get_loops(func).get_loops();
+    for (auto &loop : loops) {
         is_loop_done_[loop] = false;
     }
-
-    for (auto &loop : loop_detection_->get_loops()) {
+    for (auto &loop : loops) {
         traverse_loop(loop);
     }
 }
@@ -45,43 +47,67 @@ void LoopInvariantCodeMotion::traverse_loop(std::shared_ptr<Loop> loop) {
     run_on_loop(loop);
 }
 
-// TODO: 实现collect_loop_info函数
-// 1. 遍历当前循环及其子循环的所有指令
-// 2. 收集所有指令到loop_instructions中
-// 3. 检查store指令是否修改了全局变量，如果是则添加到updated_global中
-// 4. 检查是否包含非纯函数调用，如果有则设置contains_impure_call为true
+namespace {
+
+// 除数可能为 0 或 -1 的除法在循环外提前执行可能引发原来不会发生的异常
+bool may_trap(Instruction *inst) {
+    if (not inst->is_div())
+        return false;
+    auto divisor = inst->get_operand(1)->dyn_cast<ConstantInt>();
+    return divisor == nullptr or divisor->get_value() == 0 or
+           divisor->get_value() == -1;
+}
+
+/* 无论程序是否走到, 从 ptr 读取都不会出错: ptr 是 alloca 或全局变量本身,
+ * 或者是在其上下标都为范围内常量的 GEP */
+bool is_dereferenceable(Value *ptr) {
+    auto gep = ptr->dyn_cast<GetElementPtrInst>();
+    if (gep == nullptr)
+        return is_identified_object(ptr);
+    auto base = gep->get_operand(0);
+    if (not is_identified_object(base))
+        return false;
+    auto type = base->get_type()->get_pointer_element_type();
+    for (unsigned i = 1; i < gep->get_num_operand(); i++) {
+        auto idx = gep->get_operand(i)->dyn_cast<ConstantInt>();
+        if (idx == nullptr or idx->get_value() < 0)
+            return false;
+        if (i == 1) {
+            // 第一个下标越过的是整个对象
+            if (idx->get_value() != 0)
+                return false;
+            continue;
+        }
+        if (not type->is_array_type())
+            return false;
+        auto array = static_cast<ArrayType *>(type);
+        if (static_cast<unsigned>(idx->get_value()) >=
+            array->get_num_of_elements())
+            return false;
+        type = array->get_element_type();
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief 收集循环 (包括子循环) 中的指令, 写内存的地址与是否调用了非纯函数
+ */
 void LoopInvariantCodeMotion::collect_loop_info(
     std::shared_ptr<Loop> loop,
-    std::set<Value *> &loop_instructions,
-    std::set<Value *> &updated_global,
+    std::set<Value *, CreationOrder> &loop_instructions,
+    std::set<Value *> &stored_ptrs,
     bool &contains_impure_call) {
-    
-    for(auto &bb : loop->get_blocks())
-    {
-        for(auto &instr: bb->get_instructions())
-        {
+    for (auto &bb : loop->get_blocks()) {
+        for (auto &instr : bb->get_instructions()) {
             loop_instructions.insert(&instr);
-            if(instr.is_store())
-            {
-                
-                auto *store = static_cast<StoreInst*>(&instr);
-                auto &globals=m_->get_global_variable();
-                for(auto &global_1: globals)
-                {
-                    auto global = static_cast<Value*>(&global_1);
-                    if(store->get_operand(1)==global)
-                    {
-                        updated_global.insert(store->get_operand(1));
-                    }
-                }
-            }
-            else if(instr.is_call())
-            {
-                auto *call= static_cast<CallInst*>(&instr);
-                if(!func_info_->is_pure_function(static_cast<Function*>(call->get_operand(0))))
-                {
+            if (instr.is_store()) {
+                stored_ptrs.insert(instr.as<StoreInst>()->get_lval());
+            } else if (instr.is_call()) {
+                auto callee = instr.get_operand(0)->as<Function>();
+                if (not func_info_->is_pure_function(callee))
                     contains_impure_call = true;
-                }
             }
         }
     }
@@ -90,205 +116,145 @@ void LoopInvariantCodeMotion::collect_loop_info(
 /**
  * @brief 对单个循环执行不变式外提优化
  * @param loop 要优化的循环
- * 
+ *
+ * 操作数都在循环外定义或本身是不变式的无副作用指令是不变式;
+ * load 还要求循环中没有非纯函数调用, 也没有可能写到同一地址的 store。
+ * 外提后的指令即使循环一次也不执行也会执行, 因此 load 与纯函数调用
+ * (被调用者可能不终止) 只从每次进入循环都会执行的块中外提,
+ * 读取地址一定有效的 load 除外。
+ * 不变式按发现的顺序移到 preheader, 被依赖的指令总是先被发现。
  */
-void LoopInvariantCodeMotion::run_on_loop(std::shared_ptr<Loop> loop) 
-{
-    std::set<Value *> loop_instructions;
-    std::set<Value *> updated_global;
+void LoopInvariantCodeMotion::run_on_loop(std::shared_ptr<Loop> loop) {
+    std::set<Value *, CreationOrder> loop_instructions; // 按创建顺序遍历
+    std::set<Value *> stored_ptrs;
     bool contains_impure_call = false;
-    collect_loop_info(loop, loop_instructions, updated_global, contains_impure_call);
+    collect_loop_info(loop, loop_instructions, stored_ptrs,
+                      contains_impure_call);
 
-    std::vector<Value *> loop_invariant;
-    bool is_invar=true;
+    /* 进入循环后一定执行的块: 支配循环的所有出口块与回边的起点。
+     * 从 header 出发的路径要么离开循环, 要么回到 header; 对 while 循环即为 header */
+    auto &blocks = loop->get_blocks();
+    auto in_loop = [&](BasicBlock *bb) {
+        return std::find(blocks.begin(), blocks.end(), bb) != blocks.end();
+    };
+    std::vector<BasicBlock *> must_pass(loop->get_latches().begin(),
+                                        loop->get_latches().end());
+    for (auto bb : blocks) {
+        auto &succs = bb->get_succ_basic_blocks();
+        if (not std::all_of(succs.begin(), succs.end(), in_loop))
+            must_pass.push_back(bb);
+    }
+    auto always_executes = [&](Instruction *instr) {
+        return std::all_of(must_pass.begin(), must_pass.end(),
+                           [&](BasicBlock *bb) {
+                               return dominators_->is_dominate(
+                                   instr->get_parent(), bb);
+                           });
+    };
 
-    // TODO: 识别循环不变式指令
-    //
-    // - 如果指令已被标记为不变式则跳过
-    // - 跳过 store、ret、br、phi 等指令与非纯函数调用
-    // - 特殊处理全局变量的 load 指令
-    // - 检查指令的所有操作数是否都是循环不变的
-    // - 如果有新的不变式被添加则注意更新 changed 标志，继续迭代
+    std::vector<Instruction *> loop_invariant;
+    std::set<Value *> is_invariant;
+    auto is_invariant_operand = [&](Value *val) {
+        return not loop_instructions.count(val) or is_invariant.count(val);
+    };
 
     bool changed;
-    do 
-    {
+    do {
         changed = false;
-
-        for(auto &ins: loop_instructions)
-        {
-            auto instr=static_cast<Instruction*>(ins);
-            if(std::find(loop_invariant.begin(), loop_invariant.end(), instr) != loop_invariant.end())
-            {
+        for (auto val : loop_instructions) {
+            auto instr = val->as<Instruction>();
+            if (is_invariant.count(instr))
                 continue;
-            }
-            if(instr->is_store() || instr->is_ret() || instr->is_br() || instr->is_phi())
-            {
+            if (instr->is_store() or instr->is_ret() or instr->is_br() or
+                instr->is_phi() or instr->is_alloca() or may_trap(instr))
                 continue;
-            }
-            if(instr->is_call())
-            {
-                auto *call= static_cast<CallInst*>(instr);
-                if(!func_info_->is_pure_function(static_cast<Function*>(call->get_operand(0))))
-                {
+            if (instr->is_call() and
+                (not func_info_->is_pure_function(
+                     instr->get_operand(0)->as<Function>()) or
+                 not always_executes(instr)))
+                continue;
+            if (instr->is_load()) {
+                auto ptr = instr->get_operand(0);
+                if (contains_impure_call or
+                    std::any_of(stored_ptrs.begin(), stored_ptrs.end(),
+                                [&](Value *stored) {
+                                    return may_alias(stored, ptr);
+                                }))
                     continue;
-                }
-                else 
-                {
-                    auto func=static_cast<Function*>(call->get_operand(0));
-                    for(auto &arg:func->get_args())
-                    {
-                        if( arg.is<Constant>() ||
-                            std::find(loop_instructions.begin(), loop_instructions.end(), &arg)==loop_instructions.end()||
-                            std::find(loop_invariant.begin(), loop_invariant.end(), &arg)!=loop_invariant.end())
-                        {
-                            continue;
-                        }
-                        else {
-                            is_invar=false;
-                            break;
-                        }
-                    }
-                    if(is_invar)
-                    {
-                        loop_invariant.push_back(instr);
-                        changed=true;
-                    }
-
-                }
-            }
-            if(instr->is_load())
-            {
-                auto *load= static_cast<LoadInst*>(instr);
-                if(std::find(updated_global.begin(),updated_global.end(),load->get_operand(0))!=updated_global.end())
-                {
+                if (not is_dereferenceable(ptr) and not always_executes(instr))
                     continue;
-                }
-                else 
-                {
-                    loop_invariant.push_back(instr);
-                    changed=true;
-                }
-            }
-            else
-            {
-                for(auto &arg_1:instr->get_operands())
-                {
-                    auto arg=static_cast<Value*>(arg_1);
-                    if(arg->is<Constant>()||
-                        std::find(loop_instructions.begin(), loop_instructions.end(), arg)==loop_instructions.end()||
-                        std::find(loop_invariant.begin(), loop_invariant.end(), arg)!=loop_invariant.end())
-                    {
-                        continue;
-                    }
-                    else 
-                    {
-                        is_invar=false;
-                        break;
-                    }
-                }
-                if(is_invar)
-                {
-                    loop_invariant.push_back(instr);
-                    changed=true;
-                    
-                }
             }
-
+            auto &operands = instr->get_operands();
+            if (not std::all_of(operands.begin(), operands.end(),
+                                is_invariant_operand))
+                continue;
+            loop_invariant.push_back(instr);
+            is_invariant.insert(instr);
+            changed = true;
         }
-
-    
     } while (changed);
 
-    if (loop->get_preheader() == nullptr) {
-        loop->set_preheader(
-            BasicBlock::create(m_, "", loop->get_header()->get_parent()));
-    }
-
     if (loop_invariant.empty())
         return;
 
-    // insert preheader
-    auto preheader = loop->get_preheader();
-    std::vector<BasicBlock*> outside_preds;
-    for (auto &pred : loop->get_header()->get_pre_basic_blocks()) {
-        auto blocks=loop->get_blocks();
-        if(std::find(blocks.begin(),blocks.end(),pred)==blocks.end())
-        {
+    // 插入 preheader, 循环外进入 header 的边都改为经过它
+    auto header = loop->get_header();
+    auto preheader = BasicBlock::create(m_, "", header->get_parent());
+    loop->set_preheader(preheader);
+    std::vector<BasicBlock *> outside_preds;
+    for (auto pred : header->get_pre_basic_blocks()) {
+        if (std::find(blocks.begin(), blocks.end(), pred) == blocks.end())
             outside_preds.push_back(pred);
-        }
     }
-    // TODO: 更新 phi 指令
 
-    for (auto &phi_inst_ : loop->get_header()->get_instructions()) {
-        if (phi_inst_.get_instr_type() != Instruction::phi)
-            continue;
-        else
-        {
-            auto phi=static_cast<PhiInst*>(&phi_inst_);
-            for(auto &phi_pair:phi->get_phi_pairs())
-            {
-                if(std::find(outside_preds.begin(),outside_preds.end(),phi_pair.second)!=outside_preds.end())
-                {
-                    std::vector<Value *> vals = {phi_pair.first};
-                    std::vector<BasicBlock *> val_bbs = {phi_pair.second};
-                    auto preheader_phi=PhiInst::create_phi(phi_pair.first->get_type(),preheader,vals,val_bbs);
-                    preheader->add_instruction(preheader_phi);
-                    phi->remove_phi_operand(phi_pair.second);
-                    phi->add_phi_pair_operand(preheader_phi, preheader);
-                }
+    // header 的 phi 中来自循环外的值在 preheader 中合并
+    for (auto &inst : header->get_instructions()) {
+        if (not inst.is_phi())
+            break;
+        auto phi = inst.as<PhiInst>();
+        std::vector<Value *> vals;
+        std::vector<BasicBlock *> val_bbs;
+        for (auto &[val, bb] : phi->get_phi_pairs()) {
+            if (std::find(outside_preds.begin(), outside_preds.end(), bb) !=
+                outside_preds.end()) {
+                vals.push_back(val);
+                val_bbs.push_back(bb);
             }
-            
-
         }
-
-    }
-
-    // TODO: 用跳转指令重构控制流图 
-    // 将所有非 latch 的 header 前驱块的跳转指向 preheader
-    // 并将 preheader 的跳转指向 header
-    // 注意这里需要更新前驱块的后继和后继的前驱
-    std::vector<BasicBlock *> pred_to_remove;
-    for (auto &pred : loop->get_header()->get_pre_basic_blocks()) {
-        if(std::find(outside_preds.begin(),outside_preds.end(),pred)!=outside_preds.end())
-        {
-            pred_to_remove.push_back(pred);
-            pred->remove_succ_basic_block(loop->get_header());
-            pred->add_succ_basic_block(preheader);
-            preheader->add_pre_basic_block(pred);
-            for(auto &instr:pred->get_instructions())
-            {
-                if(instr.is_br()&&instr.get_operand(0)==loop->get_header())
-                {
-                    instr.set_operand(0, preheader);
-                }
-            }
+        for (auto bb : val_bbs)
+            phi->remove_phi_operand(bb);
+        if (vals.size() == 1) {
+            phi->add_phi_pair_operand(vals.front(), preheader);
+        } else {
+            auto preheader_phi =
+                PhiInst::create_phi(phi->get_type(), preheader, vals, val_bbs);
+            preheader->add_instruction(preheader_phi);
+            phi->add_phi_pair_operand(preheader_phi, preheader);
         }
     }
-    preheader->add_succ_basic_block(loop->get_header());
-    loop->get_header()->add_pre_basic_block(preheader);
-
 
-
-    for (auto &pred : pred_to_remove) {
-        loop->get_header()->remove_pre_basic_block(pred);
+    for (auto pred : outside_preds) {
+        auto br = pred->get_terminator();
+        for (unsigned i = 0; i < br->get_num_operand(); i++) {
+            if (br->get_operand(i) == header)
+                br->set_operand(i, preheader);
+        }
+        pred->remove_succ_basic_block(header);
+        pred->add_succ_basic_block(preheader);
+        preheader->add_pre_basic_block(pred);
+        header->remove_pre_basic_block(pred);
     }
 
-    // TODO: 外提循环不变指令
-    for(auto &invar_1: loop_invariant)
-    {
-        auto invar=static_cast<Instruction*>(invar_1);
-        preheader->add_instr_begin(invar);
-        auto parent_block=invar->get_parent();
-        parent_block->remove_instr(invar);
+    // 外提循环不变指令
+    for (auto instr : loop_invariant) {
+        instr->get_parent()->remove_instr(instr);
+        preheader->add_instruction(instr);
+        instr->set_parent(preheader);
     }
+    BranchInst::create_br(header, preheader);
 
-    // insert preheader br to header
-    BranchInst::create_br(loop->get_header(), preheader);
-
-    // insert preheader to parent loop
-    if (loop->get_parent() != nullptr) {
-        loop->get_parent()->add_block(preheader);
-    }
+    // preheader 属于所有外层循环
+    for (auto parent = loop->get_parent(); parent != nullptr;
+         parent = parent->get_parent())
+        parent->add_block(preheader);
 }
-
@@ -1,4 +1,5 @@
 #include "LoopDetection.hpp"
+#include "AnalysisManager.hpp"
 #include "Dominators.hpp"
 #include <memory>
 
@@ -6,19 +7,17 @@
  * @brief 循环检测Pass的主入口函数
  *
  * 该函数执行以下步骤：
- * 1. 创建支配树分析实例
+ * 1. 从 AnalysisManager 获取各函数的支配树
  * 2. 遍历模块中的所有函数
  * 3. 对每个非声明函数执行循环检测
  * 4. 最后打印检测结果
  */
 void LoopDetection::run() {
-    dominators_ = std::make_unique<Dominators>(m_);
     for (auto &f1 : m_->get_functions()) {
         auto f = &f1;
         if (f->is_declaration())
             continue;
-        func_ = f;
-        run_on_func(f);
+        run_on_func(f, am_->get_dominators(f));
     }
     print();
 }
@@ -98,9 +97,10 @@ void LoopDetection::discover_loop_and_sub_loops(BasicBlock *bb, BBset &latches,
 /**
  * @brief 对单个函数执行循环检测
  * @param f 要分析的函数
+ * @param dominators f 的支配树
  *
  * 该函数通过以下步骤检测循环：
- * 1. 运行支配树分析
+ * 1. 取得支配树分析结果
  * 2. 按支配树后序遍历所有基本块
  * 3. 对每个块，检查其前驱是否存在回边
  * 4. 如果存在回边，创建新的循环并：
@@ -108,8 +108,9 @@ void LoopDetection::discover_loop_and_sub_loops(BasicBlock *bb, BBset &latches,
  *    - 添加latch节点
  *    - 发现循环体和子循环
  */
-void LoopDetection::run_on_func(Function *f) {
-    dominators_->run_on_func(f);
+void LoopDetection::run_on_func(Function *f, Dominators &dominators) {
+    func_ = f;
+    dominators_ = &dominators;
     for (auto &bb1 : dominators_->get_dom_post_order()) {
         auto bb = bb1;
         BBset latches;
@@ -0,0 +1,419 @@
+#include "LoopUnroll.hpp"
+
+#include "AnalysisManager.hpp"
+#include "BasicBlock.hpp"
+#include "CmpUtils.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+
+// 完全展开的迭代次数上限
+constexpr int64_t max_full_trips = 32;
+// 展开后循环 (完全展开时为全部迭代) 的指令数上限
+constexpr unsigned max_unrolled_size = 256;
+
+bool holds(Instruction::OpID op, int64_t lhs, int64_t rhs) {
+    switch (op) {
+    case Instruction::lt:
+        return lhs < rhs;
+    case Instruction::le:
+        return lhs <= rhs;
+    case Instruction::gt:
+        return lhs > rhs;
+    case Instruction::ge:
+        return lhs >= rhs;
+    default:
+        return false;
+    }
+}
+
+Instruction *create_cmp(Instruction::OpID op, Value *lhs, Value *rhs,
+                        BasicBlock *bb) {
+    switch (op) {
+    case Instruction::lt:
+        return ICmpInst::create_lt(lhs, rhs, bb);
+    case Instruction::le:
+        return ICmpInst::create_le(lhs, rhs, bb);
+    case Instruction::gt:
+        return ICmpInst::create_gt(lhs, rhs, bb);
+    default:
+        return ICmpInst::create_ge(lhs, rhs, bb);
+    }
+}
+
+// 把 bb 的终结指令换成跳到 target 的无条件跳转
+void replace_terminator(BasicBlock *bb, BasicBlock *target) {
+    bb->erase_instr(bb->get_terminator());
+    BranchInst::create_br(target, bb);
+}
+
+bool in_int32(int64_t val) { return val >= INT32_MIN and val <= INT32_MAX; }
+
+} // namespace
+
+void LoopUnroll::run_on_function(Function *func) {
+    dominators_ = &am_->get_dominators(func);
+    // 最内层循环互不相交, 一个循环的展开不改变其他循环的块;
+    // 之后新建的块不在支配树中, 涉及它们的支配关系保守地视为不成立
+    for (auto &loop : am_->get_loops(func).get_loops()) {
+        CountedLoop cl;
+        if (not analyze(loop.get(), cl))
+            continue;
+        new_blocks_.clear();
+        auto trip_count = get_trip_count(cl);
+        if (trip_count == 0)
+            continue;
+        if (trip_count > 0 and trip_count * cl.size <= max_unrolled_size) {
+            full_unroll(cl, static_cast<unsigned>(trip_count));
+            full_++;
+            continue;
+        }
+        auto factor = factor_;
+        while (factor >= 2 and factor * cl.size > max_unrolled_size)
+            factor /= 2;
+        if (factor >= 2 and partial_unroll(cl, factor))
+            partial_++;
+    }
+}
+
+void LoopUnroll::merge(const FunctionPass &other) {
+    auto &unroll = static_cast<const LoopUnroll &>(other);
+    full_ += unroll.full_;
+    partial_ += unroll.partial_;
+}
+
+/**
+ * @brief 判断 loop 是否为可以展开的计数循环, 并填写 cl
+ */
+bool LoopUnroll::analyze(Loop *loop, CountedLoop &cl) {
+    if (not loop->get_sub_loops().empty() or loop->get_latches().size() != 1)
+        return false;
+    cl.header = loop->get_header();
+    cl.latch = *loop->get_latches().begin();
+    if (cl.latch == cl.header)
+        return false;
+    cl.block_set.clear();
+    cl.block_set.insert(loop->get_blocks().begin(), loop->get_blocks().end());
+    cl.blocks.assign(1, cl.header);
+    cl.size = 0;
+    for (auto &bb : cl.header->get_parent()->get_basic_blocks()) {
+        if (not cl.block_set.count(&bb))
+            continue;
+        if (&bb != cl.header)
+            cl.blocks.push_back(&bb);
+        cl.size += bb.get_instructions().size();
+    }
+
+    cl.preheader = nullptr;
+    for (auto pre : cl.header->get_pre_basic_blocks()) {
+        if (cl.block_set.count(pre))
+            continue;
+        if (cl.preheader != nullptr)
+            return false;
+        cl.preheader = pre;
+    }
+    if (cl.preheader == nullptr)
+        return false;
+    for (auto bb : {cl.preheader, cl.latch}) {
+        auto br = bb->get_terminator()->dyn_cast<BranchInst>();
+        if (br == nullptr or br->is_cond_br())
+            return false;
+    }
+
+    // 循环头: br (icmp ne (zext (icmp op lhs rhs)), 0), 循环体, 出口
+    auto br = cl.header->get_terminator()->dyn_cast<BranchInst>();
+    if (br == nullptr or not br->is_cond_br())
+        return false;
+    auto true_bb = br->get_operand(1)->as<BasicBlock>();
+    auto false_bb = br->get_operand(2)->as<BasicBlock>();
+    bool enter = cl.block_set.count(true_bb);
+    if (enter == static_cast<bool>(cl.block_set.count(false_bb)))
+        return false;
+    cl.body = enter ? true_bb : false_bb;
+    cl.exit = enter ? false_bb : true_bb;
+    Value *lhs, *rhs;
+    if (not get_branch_cmp(br, enter, lhs, cl.pred, rhs))
+        return false;
+
+    cl.phis.clear();
+    cl.init_vals.clear();
+    cl.next_vals.clear();
+    for (auto &inst : cl.header->get_instructions()) {
+        if (not inst.is_phi())
+            break;
+        auto phi = inst.as<PhiInst>();
+        Value *init = nullptr, *next = nullptr;
+        for (auto &[val, bb] : phi->get_phi_pairs())
+            (bb == cl.preheader ? init : next) = val;
+        if (phi->get_num_operand() != 4 or init == nullptr or next == nullptr)
+            return false;
+        cl.phis.push_back(phi);
+        cl.init_vals.push_back(init);
+        cl.next_vals.push_back(next);
+    }
+
+    auto find_phi = [&](Value *val) {
+        return std::find(cl.phis.begin(), cl.phis.end(), val) - cl.phis.begin();
+    };
+    auto iv = find_phi(lhs);
+    if (iv == static_cast<long>(cl.phis.size())) {
+        std::swap(lhs, rhs);
+        cl.pred = swap_cmp(cl.pred);
+        iv = find_phi(lhs);
+        if (iv == static_cast<long>(cl.phis.size()))
+            return false;
+    }
+    cl.iv = static_cast<unsigned>(iv);
+    cl.bound = rhs;
+    if (auto inst = cl.bound->dyn_cast<Instruction>()) {
+        if (cl.block_set.count(inst->get_parent()))
+            return false;
+    }
+
+    // 步长: add iv, c / add c, iv / sub iv, c
+    auto next = cl.next_vals[cl.iv]->dyn_cast<IBinaryInst>();
+    if (next == nullptr or not(next->is_add() or next->is_sub()))
+        return false;
+    auto step = next->get_operand(1)->dyn_cast<ConstantInt>();
+    if (next->is_add() and next->get_operand(1) == lhs)
+        step = next->get_operand(0)->dyn_cast<ConstantInt>();
+    else if (next->get_operand(0) != lhs)
+        return false;
+    if (step == nullptr or step->get_value() == 0 or
+        (next->is_sub() and step->get_value() == INT32_MIN))
+        return false;
+    cl.step = next->is_add() ? step->get_value() : -step->get_value();
+    bool up = cl.pred == Instruction::lt or cl.pred == Instruction::le;
+    bool down = cl.pred == Instruction::gt or cl.pred == Instruction::ge;
+    if (not(up and cl.step > 0) and not(down and cl.step < 0))
+        return false;
+
+    // 循环体中的其他出口在复制后多出前驱, 不能有 phi
+    for (auto bb : cl.blocks) {
+        if (bb == cl.header)
+            continue;
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (not cl.block_set.count(succ) and
+                succ->get_instructions().begin()->is_phi())
+                return false;
+        }
+    }
+    return check_outside_uses(cl);
+}
+
+/**
+ * @brief 循环外的使用只能是出口中来自循环头的 phi, 或位于出口支配的块中,
+ *        展开后它们改为使用最后一次迭代的值
+ */
+bool LoopUnroll::check_outside_uses(const CountedLoop &cl) {
+    for (auto bb : cl.blocks) {
+        for (auto &inst : bb->get_instructions()) {
+            for (auto &use : inst.get_use_list()) {
+                auto user = use.val_->as<Instruction>();
+                auto use_bb = user->get_parent();
+                if (cl.block_set.count(use_bb))
+                    continue;
+                // phi 的使用位于来源块的末尾
+                if (user->is_phi()) {
+                    use_bb = user->get_operand(use.arg_no_ + 1)->as<BasicBlock>();
+                    if (use_bb == cl.header and user->get_parent() == cl.exit)
+                        continue;
+                }
+                if (cl.block_set.count(use_bb) or
+                    not dominators_->is_dominate(cl.exit, use_bb))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+int64_t LoopUnroll::get_trip_count(const CountedLoop &cl) {
+    auto init = cl.init_vals[cl.iv]->dyn_cast<ConstantInt>();
+    auto bound = cl.bound->dyn_cast<ConstantInt>();
+    if (init == nullptr or bound == nullptr)
+        return -1;
+    int64_t val = init->get_value();
+    for (int64_t trips = 0; trips <= max_full_trips; trips++) {
+        if (not holds(cl.pred, val, bound->get_value()))
+            return trips;
+        val += cl.step;
+        // 归纳变量溢出时回绕, 与这里的计算不同
+        if (not in_int32(val))
+            return -1;
+    }
+    return -1;
+}
+
+ValueMap LoopUnroll::clone_iteration(const CountedLoop &cl,
+                                     const std::vector<Value *> &phi_vals,
+                                     bool header_only) {
+    ValueMap value_map;
+    auto copies = clone_blocks(
+        header_only ? std::vector<BasicBlock *>{cl.header} : cl.blocks,
+        cl.header->get_parent(), value_map);
+    new_blocks_.insert(new_blocks_.end(), copies.begin(), copies.end());
+
+    for (unsigned i = 0; i < cl.phis.size(); i++) {
+        auto copy = value_map[cl.phis[i]]->as<Instruction>();
+        copy->replace_all_use_with(phi_vals[i]);
+        copy->remove_all_operands();
+        copy->get_parent()->erase_instr(copy);
+        value_map[cl.phis[i]] = phi_vals[i];
+    }
+    replace_terminator(copies.front(),
+                       header_only ? cl.exit
+                                   : value_map[cl.body]->as<BasicBlock>());
+    return value_map;
+}
+
+/**
+ * @brief 完全展开
+ *
+ * 原来的循环作为第一次迭代, 之后依次接上各次迭代的副本, 最后是只含循环头的副本,
+ * 它计算循环结束时循环头中的值并跳到出口。
+ */
+void LoopUnroll::full_unroll(const CountedLoop &cl, unsigned trip_count) {
+    // 在复制之前收集循环外的使用, 副本中的使用不在其中
+    std::vector<std::pair<Instruction *, unsigned>> outside_uses;
+    for (auto bb : cl.blocks) {
+        for (auto &inst : bb->get_instructions()) {
+            for (auto &use : inst.get_use_list()) {
+                auto user = use.val_->as<Instruction>();
+                if (not cl.block_set.count(user->get_parent()))
+                    outside_uses.emplace_back(user, use.arg_no_);
+            }
+        }
+    }
+
+    // 副本放在循环的最后一个块之后
+    auto &blocks = cl.header->get_parent()->get_basic_blocks();
+    auto pos = blocks.end();
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        if (cl.block_set.count(&*it))
+            pos = std::next(it);
+    }
+
+    auto vals = cl.next_vals;
+    auto latch = cl.latch;
+    ValueMap value_map;
+    for (unsigned k = 1; k <= trip_count; k++) {
+        value_map = clone_iteration(cl, vals, k == trip_count);
+        replace_terminator(latch, value_map[cl.header]->as<BasicBlock>());
+        if (k == trip_count)
+            break;
+        latch = value_map[cl.latch]->as<BasicBlock>();
+        for (unsigned i = 0; i < vals.size(); i++)
+            vals[i] = map_value(value_map, cl.next_vals[i]);
+    }
+    auto last_header = value_map[cl.header];
+    replace_terminator(cl.header, cl.body);
+
+    for (auto &[user, idx] : outside_uses) {
+        user->set_operand(idx, map_value(value_map, user->get_operand(idx)));
+        if (user->is_phi() and user->get_operand(idx + 1) == cl.header)
+            user->set_operand(idx + 1, last_header);
+    }
+    // 原来的循环头只剩 preheader 一个前驱
+    for (unsigned i = 0; i < cl.phis.size(); i++) {
+        cl.phis[i]->replace_all_use_with(cl.init_vals[i]);
+        cl.phis[i]->remove_all_operands();
+        cl.header->erase_instr(cl.phis[i]);
+    }
+
+    for (auto bb : new_blocks_) {
+        blocks.remove(bb);
+        blocks.insert(pos, bb);
+    }
+}
+
+/**
+ * @brief 按 factor 部分展开, 原来的循环作为余下迭代的循环
+ *
+ * 变换后的结构为
+ *   preheader: %adj = bound - (factor - 1) * step; br %safe, unrolled, header
+ *   unrolled:  %q = phi [init, preheader], [最后一个副本的 next, 其 latch]
+ *              br (q_iv pred %adj), 第一个副本的循环体, header
+ *   副本:      factor 次迭代依次相连, 循环头的副本不再判断条件
+ *   header:    原来的循环, phi 增加来源 [%q, unrolled]
+ * iv + (factor - 1) * step pred bound 等价于 iv pred %adj, 只要 %adj 的计算不溢出,
+ * %safe 即为此判断; bound 为常数时在编译时判断。
+ * @return 是否展开
+ */
+bool LoopUnroll::partial_unroll(const CountedLoop &cl, unsigned factor) {
+    int64_t span = static_cast<int64_t>(factor - 1) * cl.step;
+    if (not in_int32(span))
+        return false;
+    int64_t limit = cl.step > 0 ? INT32_MIN + span : INT32_MAX + span;
+    auto bound = cl.bound->dyn_cast<ConstantInt>();
+    if (bound and (cl.step > 0 ? bound->get_value() < limit
+                               : bound->get_value() > limit))
+        return false;
+
+    auto func = cl.header->get_parent();
+    auto pre = cl.preheader;
+    // 新建的块放在 preheader 之后
+    auto &blocks = func->get_basic_blocks();
+    auto pos = std::next(pre->getIterator());
+    pre->erase_instr(pre->get_terminator());
+    Value *adj, *safe = nullptr;
+    if (bound) {
+        adj = ConstantInt::get(static_cast<int>(bound->get_value() - span), m_);
+    } else {
+        adj = IBinaryInst::create_sub(
+            cl.bound, ConstantInt::get(static_cast<int>(span), m_), pre);
+        auto limit_val = ConstantInt::get(static_cast<int>(limit), m_);
+        safe = cl.step > 0 ? ICmpInst::create_ge(cl.bound, limit_val, pre)
+                           : ICmpInst::create_le(cl.bound, limit_val, pre);
+    }
+
+    auto unrolled = BasicBlock::create(m_, "", func);
+    new_blocks_.push_back(unrolled);
+    std::vector<PhiInst *> merged;
+    std::vector<Value *> vals;
+    for (unsigned i = 0; i < cl.phis.size(); i++) {
+        auto phi = PhiInst::create_phi(cl.phis[i]->get_type(), unrolled,
+                                       {cl.init_vals[i]}, {pre});
+        unrolled->add_instruction(phi);
+        merged.push_back(phi);
+        vals.push_back(phi);
+    }
+    auto test = create_cmp(cl.pred, merged[cl.iv], adj, unrolled);
+    if (safe) {
+        BranchInst::create_cond_br(safe, unrolled, cl.header, pre);
+    } else {
+        BranchInst::create_br(unrolled, pre);
+        for (auto phi : cl.phis)
+            phi->remove_phi_operand(pre);
+    }
+
+    BasicBlock *first = nullptr, *latch = nullptr;
+    for (unsigned k = 0; k < factor; k++) {
+        auto value_map = clone_iteration(cl, vals, false);
+        auto header = value_map[cl.header]->as<BasicBlock>();
+        if (latch)
+            replace_terminator(latch, header);
+        else
+            first = header;
+        latch = value_map[cl.latch]->as<BasicBlock>();
+        for (unsigned i = 0; i < vals.size(); i++)
+            vals[i] = map_value(value_map, cl.next_vals[i]);
+    }
+    replace_terminator(latch, unrolled);
+    for (unsigned i = 0; i < merged.size(); i++)
+        merged[i]->add_phi_pair_operand(vals[i], latch);
+    BranchInst::create_cond_br(test, first, cl.header, unrolled);
+    for (unsigned i = 0; i < cl.phis.size(); i++)
+        cl.phis[i]->add_phi_pair_operand(merged[i], unrolled);
+
+    for (auto bb : new_blocks_) {
+        blocks.remove(bb);
+        blocks.insert(pos, bb);
+    }
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "Mem2Reg.hpp"
+#include "AnalysisManager.hpp"
 #include "IRBuilder.hpp"
 #include "Value.hpp"
 
@@ -6,46 +7,33 @@
 #include <locale>
 #include <memory>
 
-#define IS_GLOBAL_VARIABLE(l_val) dynamic_cast<GlobalVariable *>(l_val)
-#define IS_GEP_INSTR(l_val) dynamic_cast<GetElementPtrInst *>(l_val)
 /**
- * @brief Mem2Reg Pass的主入口函数
+ * @brief Mem2Reg Pass对单个函数的入口
  * 
  * 该函数执行内存到寄存器的提升过程，将栈上的局部变量提升到SSA格式。
  * 主要步骤：
- * 1. 创建并运行支配树分析
- * 2. 对每个非声明函数：
+ *    - 从 AnalysisManager 获取支配树
  *    - 清空相关数据结构
  *    - 插入必要的phi指令
  *    - 执行变量重命名
  * 
  * 注意：函数执行后，冗余的局部变量分配指令将由后续的死代码删除Pass处理
  */
-void Mem2Reg::run() {
-    // 创建支配树分析 Pass 的实例
-    dominators_ = std::make_unique<Dominators>(m_);
-    // 建立支配树
-    dominators_->run();
-    // 以函数为单元遍历实现 Mem2Reg 算法
-    
-    for (auto &f : m_->get_functions()) {
-        if (f.is_declaration())
-            continue;
-        func_ = &f;
-        var_val_stack.clear();
-        phi_lval.clear();
-
-        if (func_->get_basic_blocks().size() >= 1) {
-            // 对应伪代码中 phi 指令插入的阶段
-            generate_phi();
-            // 对应伪代码中重命名阶段
-            rename(func_->get_entry_block());
-        }
-
-        // 后续 DeadCode 将移除冗余的局部变量的分配空间
+void Mem2Reg::run_on_function(Function *func) {
+    // 以函数为单元实现 Mem2Reg 算法
+    func_ = func;
+    dominators_ = &am_->get_dominators(func_);
+    var_val_stack.clear();
+    phi_lval.clear();
+
+    if (func_->get_basic_blocks().size() >= 1) {
+        // 对应伪代码中 phi 指令插入的阶段
+        generate_phi();
+        // 对应伪代码中重命名阶段
+        rename(func_->get_entry_block());
     }
-    
-    
+
+    // 后续 DeadCode 将移除冗余的局部变量的分配空间
 }
 
 /**
@@ -66,8 +54,9 @@ void Mem2Reg::run() {
 void Mem2Reg::generate_phi() {
     // global_live_var_name 是全局名字集合，以 alloca 出的局部变量来统计。
     // 步骤一：找到活跃在多个 block 的全局名字集合，以及它们所属的 bb 块
-    std::set<Value *> global_live_var_name;
-    std::map<Value *, std::set<BasicBlock *>> live_var_2blocks;
+    // 按创建顺序遍历, 插入的 phi 的顺序不随内存地址变化
+    std::set<Value *, CreationOrder> global_live_var_name;
+    std::map<Value *, std::set<BasicBlock *, CreationOrder>> live_var_2blocks;
     for (auto &bb : func_->get_basic_blocks()) {
         std::set<Value *> var_is_killed;
         for (auto &instr : bb.get_instructions()) {
@@ -126,7 +115,8 @@ void Mem2Reg::rename(BasicBlock *bb) {
     for (auto &instr_1 : bb->get_instructions() )
     {
         auto instr = &instr_1;
-        if (instr->is_phi())
+        // 只处理本 Pass 插入的 phi, 之前的 Pass (如内联) 留下的 phi 保持不变
+        if (instr->is_phi() and phi_lval.count(static_cast<PhiInst *>(instr)))
         {
             auto l_val = phi_lval[static_cast<PhiInst *>(instr)];
             var_val_stack[l_val].push(instr);
@@ -140,7 +130,7 @@ void Mem2Reg::rename(BasicBlock *bb) {
         {
             auto l_val = static_cast<LoadInst *>(instr)->get_lval();
 
-            if (!IS_GLOBAL_VARIABLE(l_val) && !IS_GEP_INSTR(l_val))
+            if (is_valid_ptr(l_val))
             {
                 if ( var_val_stack.find(l_val)!=var_val_stack.end())
                 {
@@ -155,7 +145,7 @@ void Mem2Reg::rename(BasicBlock *bb) {
             auto l_val = static_cast<StoreInst *>(instr)->get_lval();
             auto r_val = static_cast<StoreInst *>(instr)->get_rval();
 
-            if (!IS_GLOBAL_VARIABLE(l_val) && !IS_GEP_INSTR(l_val))
+            if (is_valid_ptr(l_val))
             {
                 var_val_stack[l_val].push(r_val);
                 wait_delete.push_back(instr);
@@ -169,7 +159,7 @@ void Mem2Reg::rename(BasicBlock *bb) {
         for ( auto &instr_1 : succ_bb->get_instructions() )
         {
             auto instr = &instr_1;
-            if ( instr->is_phi())
+            if ( instr->is_phi() and phi_lval.count(static_cast<PhiInst *>(instr)))
             {
                 auto l_val = phi_lval[static_cast<PhiInst *>(instr)];
                 if (var_val_stack.find(l_val)!= var_val_stack.end())
@@ -195,13 +185,13 @@ void Mem2Reg::rename(BasicBlock *bb) {
         if(instr->is_store())
         {
             auto l_val = static_cast<StoreInst *>(instr)->get_lval();
-            if (!IS_GLOBAL_VARIABLE(l_val) && !IS_GEP_INSTR(l_val))
+            if (is_valid_ptr(l_val))
             {
                 var_val_stack[l_val].pop();
             }
             
         }
-        else if (instr->is_phi())
+        else if (instr->is_phi() and phi_lval.count(static_cast<PhiInst *>(instr)))
         {
             auto l_val =phi_lval[static_cast<PhiInst *>(instr)];
             if ( var_val_stack.find(l_val)!=var_val_stack.end())
@@ -0,0 +1,188 @@
+#include "PassInstrumentation.hpp"
+
+#include <cassert>
+#include <iomanip>
+#include <sys/resource.h>
+
+IRCounts IRCounts::of(Module *m) {
+    IRCounts counts;
+    for (auto &func : m->get_functions()) {
+        for (auto &bb : func.get_basic_blocks()) {
+            counts.blocks++;
+            for (auto &inst : bb.get_instructions()) {
+                counts.instructions++;
+                counts.phis += inst.is_phi();
+                counts.loads += inst.is_load();
+                counts.stores += inst.is_store();
+            }
+        }
+    }
+    return counts;
+}
+
+PassInstrumentation::Sample PassInstrumentation::sample() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval &tv) {
+        return tv.tv_sec + tv.tv_usec / 1e6;
+    };
+    return {std::chrono::steady_clock::now(),
+            seconds(usage.ru_utime) + seconds(usage.ru_stime),
+            usage.ru_maxrss};
+}
+
+void PassInstrumentation::start(std::string name, Module *m) {
+    assert(not running_ && "phases cannot be nested");
+    running_ = true;
+    Record record;
+    record.name = std::move(name);
+    if (m) {
+        record.has_before = true;
+        record.before = IRCounts::of(m);
+    }
+    records_.push_back(std::move(record));
+    // IR 的统计不计入阶段的耗时
+    started_ = sample();
+}
+
+void PassInstrumentation::stop(Module *m) {
+    assert(running_ && "stop without start");
+    auto now = sample();
+    running_ = false;
+    auto &record = records_.back();
+    record.wall =
+        std::chrono::duration<double>(now.wall - started_.wall).count();
+    record.cpu = now.cpu - started_.cpu;
+    record.peak_rss_delta = now.peak_rss - started_.peak_rss;
+    if (m) {
+        record.has_after = true;
+        record.after = IRCounts::of(m);
+    }
+}
+
+void PassInstrumentation::add_counter(std::string name, long value) {
+    assert(not records_.empty() && "counter without a phase");
+    records_.back().counters.emplace_back(std::move(name), value);
+}
+
+namespace {
+
+constexpr int name_width = 20;
+
+// 形如 "120 -> 80" 的一列, 缺少的一侧用 "-" 表示
+std::string change(bool has_before, unsigned before, bool has_after,
+                   unsigned after) {
+    auto str = [](bool has, unsigned val) {
+        return has ? std::to_string(val) : std::string("-");
+    };
+    return str(has_before, before) + " -> " + str(has_after, after);
+}
+
+void json_counts(std::ostream &os, const IRCounts &counts) {
+    os << "{\"instructions\": " << counts.instructions
+       << ", \"blocks\": " << counts.blocks << ", \"phis\": " << counts.phis
+       << ", \"loads\": " << counts.loads << ", \"stores\": " << counts.stores
+       << "}";
+}
+
+std::string json_string(const std::string &str) {
+    std::string out = "\"";
+    for (auto ch : str) {
+        if (ch == '"' or ch == '\\')
+            out += '\\';
+        out += ch;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+void PassInstrumentation::print_timing(std::ostream &os) const {
+    double wall = 0, cpu = 0;
+    long peak_rss = 0;
+    os << "===== cminusfc time report =====\n";
+    os << std::left << std::setw(name_width) << "phase" << std::right
+       << std::setw(12) << "wall(s)" << std::setw(12) << "cpu(s)"
+       << std::setw(16) << "peak-mem(+KB)" << "\n";
+    auto row = [&](const std::string &name, double w, double c, long rss) {
+        os << std::left << std::setw(name_width) << name << std::right
+           << std::fixed << std::setprecision(4) << std::setw(12) << w
+           << std::setw(12) << c << std::setw(16) << rss << "\n";
+    };
+    for (auto &record : records_) {
+        row(record.name, record.wall, record.cpu, record.peak_rss_delta);
+        wall += record.wall;
+        cpu += record.cpu;
+        peak_rss += record.peak_rss_delta;
+    }
+    row("total", wall, cpu, peak_rss);
+    os.unsetf(std::ios::floatfield);
+}
+
+void PassInstrumentation::print_stats(std::ostream &os) const {
+    os << "===== cminusfc IR statistics =====\n";
+    os << std::left << std::setw(name_width) << "phase" << std::right;
+    for (auto *col : {"instructions", "blocks", "phis", "loads", "stores"})
+        os << std::setw(20) << col;
+    os << "\n";
+    for (auto &record : records_) {
+        if (not record.has_before and not record.has_after)
+            continue;
+        auto &b = record.before;
+        auto &a = record.after;
+        bool hb = record.has_before, ha = record.has_after;
+        os << std::left << std::setw(name_width) << record.name << std::right
+           << std::setw(20)
+           << change(hb, b.instructions, ha, a.instructions) << std::setw(20)
+           << change(hb, b.blocks, ha, a.blocks) << std::setw(20)
+           << change(hb, b.phis, ha, a.phis) << std::setw(20)
+           << change(hb, b.loads, ha, a.loads) << std::setw(20)
+           << change(hb, b.stores, ha, a.stores) << "\n";
+    }
+
+    bool has_counters = false;
+    for (auto &record : records_)
+        has_counters |= not record.counters.empty();
+    if (not has_counters)
+        return;
+    os << "===== cminusfc pass counters =====\n";
+    os << std::left << std::setw(name_width) << "phase" << std::setw(32)
+       << "counter" << std::right << std::setw(12) << "value" << "\n";
+    for (auto &record : records_) {
+        for (auto &[name, value] : record.counters)
+            os << std::left << std::setw(name_width) << record.name
+               << std::setw(32) << name << std::right << std::setw(12)
+               << value << "\n";
+    }
+}
+
+void PassInstrumentation::print_json(std::ostream &os) const {
+    os << "{\n  \"phases\": [";
+    bool first = true;
+    for (auto &record : records_) {
+        os << (first ? "\n" : ",\n");
+        first = false;
+        os << "    {\"name\": " << json_string(record.name)
+           << ", \"wall_seconds\": " << record.wall
+           << ", \"cpu_seconds\": " << record.cpu
+           << ", \"peak_rss_delta_kb\": " << record.peak_rss_delta;
+        if (record.has_before) {
+            os << ", \"before\": ";
+            json_counts(os, record.before);
+        }
+        if (record.has_after) {
+            os << ", \"after\": ";
+            json_counts(os, record.after);
+        }
+        if (not record.counters.empty()) {
+            os << ", \"counters\": {";
+            for (std::size_t i = 0; i < record.counters.size(); i++) {
+                os << (i ? ", " : "") << json_string(record.counters[i].first)
+                   << ": " << record.counters[i].second;
+            }
+            os << "}";
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
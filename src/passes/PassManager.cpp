@@ -0,0 +1,69 @@
+#include "PassManager.hpp"
+#include "AnalysisManager.hpp"
+#include "PassInstrumentation.hpp"
+#include "ThreadPool.hpp"
+
+void FunctionPass::run() {
+    initialize();
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration())
+            run_on_function(&func);
+    }
+    finalize();
+}
+
+PassManager::PassManager(Module *m, ThreadPool *pool)
+    : m_(m), pool_(pool), am_(std::make_unique<AnalysisManager>(m)) {}
+
+PassManager::~PassManager() = default;
+
+void PassManager::run() {
+    for (unsigned i = 0; i < passes_.size(); ++i) {
+        auto &pass = passes_[i];
+        pass->set_analysis_manager(am_.get());
+        if (pi_)
+            pi_->start(pass->get_name(), m_);
+        if (clone_[i] and pool_ and pool_->get_num_threads() > 1)
+            run_parallel(static_cast<FunctionPass &>(*pass), clone_[i]);
+        else
+            pass->run();
+        am_->invalidate(pass->get_preserved());
+        if (pi_) {
+            pi_->stop(m_);
+            for (auto &[name, value] : pass->get_statistics())
+                pi_->add_counter(name, value);
+        }
+    }
+}
+
+/**
+ * @brief 在线程池上运行函数 Pass
+ *
+ * 0 号线程使用 pass 本身, 其余线程各用一个新实例; 各实例的 initialize 依次在
+ * 当前线程中执行, 之后各函数被分给不同线程, 最后把统计合并回 pass。
+ */
+void PassManager::run_parallel(FunctionPass &pass, const CloneFn &clone) {
+    std::vector<Function *> funcs;
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration())
+            funcs.push_back(&func);
+    }
+
+    std::vector<std::unique_ptr<FunctionPass>> clones;
+    std::vector<FunctionPass *> instances{&pass};
+    for (unsigned i = 1; i < pool_->get_num_threads(); ++i) {
+        clones.push_back(clone());
+        clones.back()->set_analysis_manager(am_.get());
+        instances.push_back(clones.back().get());
+    }
+    for (auto *instance : instances)
+        instance->initialize();
+
+    pool_->parallel_for(funcs.size(), [&](std::size_t idx, unsigned worker) {
+        instances[worker]->run_on_function(funcs[idx]);
+    });
+
+    for (auto &other : clones)
+        pass.merge(*other);
+    pass.finalize();
+}
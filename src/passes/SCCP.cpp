@@ -0,0 +1,362 @@
+#include "SCCP.hpp"
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+void SCCP::run_on_function(Function *func) {
+    lattice_.clear();
+    executable_edges_.clear();
+    executable_blocks_.clear();
+    cfg_work_list_.clear();
+    ssa_work_list_.clear();
+
+    mark_edge(nullptr, func->get_entry_block());
+    do {
+        solve();
+    } while (resolve_undef_branches(func));
+
+    replace_constants(func);
+    rewrite_branches(func);
+    remove_dead_blocks(func);
+}
+
+void SCCP::merge(const FunctionPass &other) {
+    auto &sccp = static_cast<const SCCP &>(other);
+    folded_ += sccp.folded_;
+    branches_ += sccp.branches_;
+    blocks_ += sccp.blocks_;
+}
+
+/**
+ * @brief 交替处理两个工作表, 直到格的值与可执行边都不再变化
+ *
+ * 控制流工作表中是新变为可执行的边: 目标块的 phi 需要重新计算,
+ * 块第一次可执行时还要计算其中的其他指令。
+ * SSA 工作表中是某个操作数的格值发生变化的指令, 只在所在块可执行时重新计算。
+ */
+void SCCP::solve() {
+    while (not cfg_work_list_.empty() or not ssa_work_list_.empty()) {
+        while (not cfg_work_list_.empty()) {
+            auto bb = cfg_work_list_.back().second;
+            cfg_work_list_.pop_back();
+            bool first_visit = executable_blocks_.insert(bb).second;
+            for (auto &inst : bb->get_instructions()) {
+                if (inst.is_phi())
+                    visit_phi(inst.as<PhiInst>());
+                else if (first_visit)
+                    visit(&inst);
+                else
+                    break;
+            }
+        }
+        while (not ssa_work_list_.empty()) {
+            auto inst = ssa_work_list_.back();
+            ssa_work_list_.pop_back();
+            if (executable_blocks_.count(inst->get_parent()))
+                visit(inst);
+        }
+    }
+}
+
+void SCCP::mark_edge(BasicBlock *from, BasicBlock *to) {
+    if (executable_edges_.insert({from, to}).second)
+        cfg_work_list_.push_back({from, to});
+}
+
+void SCCP::visit(Instruction *inst) {
+    if (inst->is_phi()) {
+        visit_phi(inst->as<PhiInst>());
+        return;
+    }
+    if (inst->is_br()) {
+        visit_br(inst->as<BranchInst>());
+        return;
+    }
+    if (inst->is_void())
+        return;
+    bool foldable = inst->isBinary() or inst->is_cmp() or inst->is_fcmp() or
+                    inst->is_zext() or inst->is_fp2si() or inst->is_si2fp();
+    if (not foldable) {
+        set_lattice(inst, {LatticeVal::overdefined});
+        return;
+    }
+
+    std::vector<Constant *> ops;
+    bool has_undef = false;
+    for (auto op : inst->get_operands()) {
+        auto val = get_lattice(op);
+        if (val.kind == LatticeVal::overdefined) {
+            set_lattice(inst, {LatticeVal::overdefined});
+            return;
+        }
+        if (val.kind == LatticeVal::undef)
+            has_undef = true;
+        else
+            ops.push_back(val.val);
+    }
+    if (has_undef)
+        return;
+    auto result = fold(inst, ops);
+    if (result)
+        set_lattice(inst, {LatticeVal::constant, result});
+    else
+        set_lattice(inst, {LatticeVal::overdefined});
+}
+
+// phi 的值为所有可执行入边上来源值的交
+void SCCP::visit_phi(PhiInst *phi) {
+    LatticeVal result;
+    for (auto &[val, pre_bb] : phi->get_phi_pairs()) {
+        if (not executable_edges_.count({pre_bb, phi->get_parent()}))
+            continue;
+        auto val_lattice = get_lattice(val);
+        if (val_lattice.kind == LatticeVal::undef)
+            continue;
+        if (result.kind == LatticeVal::undef) {
+            result = val_lattice;
+        } else if (not(result == val_lattice)) {
+            result = {LatticeVal::overdefined};
+            break;
+        }
+    }
+    if (result.kind != LatticeVal::undef)
+        set_lattice(phi, result);
+}
+
+void SCCP::visit_br(BranchInst *br) {
+    auto bb = br->get_parent();
+    if (not br->is_cond_br()) {
+        mark_edge(bb, br->get_operand(0)->as<BasicBlock>());
+        return;
+    }
+    auto if_true = br->get_operand(1)->as<BasicBlock>();
+    auto if_false = br->get_operand(2)->as<BasicBlock>();
+    auto cond = get_lattice(br->get_condition());
+    switch (cond.kind) {
+    case LatticeVal::undef:
+        break;
+    case LatticeVal::constant:
+        mark_edge(bb, cond.val->as<ConstantInt>()->get_value() ? if_true
+                                                               : if_false);
+        break;
+    case LatticeVal::overdefined:
+        mark_edge(bb, if_true);
+        mark_edge(bb, if_false);
+        break;
+    }
+}
+
+SCCP::LatticeVal SCCP::get_lattice(Value *val) {
+    if (val->is<ConstantInt>() or val->is<ConstantFP>())
+        return {LatticeVal::constant, val->as<Constant>()};
+    // 参数, 全局变量等在编译时不知道值
+    if (not val->is<Instruction>())
+        return {LatticeVal::overdefined};
+    auto it = lattice_.find(val);
+    return it == lattice_.end() ? LatticeVal{} : it->second;
+}
+
+void SCCP::set_lattice(Instruction *inst, LatticeVal val) {
+    auto &cur = lattice_[inst];
+    if (cur == val or cur.kind == LatticeVal::overdefined)
+        return;
+    cur = val;
+    for (auto &use : inst->get_use_list()) {
+        if (auto user = use.val_->dyn_cast<Instruction>())
+            ssa_work_list_.push_back(user);
+    }
+}
+
+/**
+ * @brief 计算操作数都是常量的指令
+ *
+ * 整数运算按 32 位补码回绕; 除数为 0 或 INT_MIN / -1 的除法,
+ * 结果超出 int 范围的 fptosi, 以及结果不是有限值的浮点运算都保留到运行时。
+ * 浮点比较与 IR 中一样是无序比较, 任一操作数为 NaN 时为真。
+ */
+Constant *SCCP::fold(Instruction *inst, const std::vector<Constant *> &ops) {
+    auto wrap = [](int64_t val) {
+        return static_cast<int>(static_cast<uint32_t>(val));
+    };
+    auto int_val = [&](unsigned i) -> int64_t {
+        return ops[i]->as<ConstantInt>()->get_value();
+    };
+    auto float_val = [&](unsigned i) {
+        return ops[i]->as<ConstantFP>()->get_value();
+    };
+    auto make_float = [&](float val) -> Constant * {
+        if (not std::isfinite(val))
+            return nullptr;
+        return ConstantFP::get(val, m_);
+    };
+    auto unordered = [&] {
+        return std::isnan(float_val(0)) or std::isnan(float_val(1));
+    };
+
+    switch (inst->get_instr_type()) {
+    case Instruction::add:
+        return ConstantInt::get(wrap(int_val(0) + int_val(1)), m_);
+    case Instruction::sub:
+        return ConstantInt::get(wrap(int_val(0) - int_val(1)), m_);
+    case Instruction::mul:
+        return ConstantInt::get(wrap(int_val(0) * int_val(1)), m_);
+    case Instruction::sdiv:
+        if (int_val(1) == 0 or (int_val(0) == INT_MIN and int_val(1) == -1))
+            return nullptr;
+        return ConstantInt::get(static_cast<int>(int_val(0) / int_val(1)),
+                                m_);
+    case Instruction::fadd:
+        return make_float(float_val(0) + float_val(1));
+    case Instruction::fsub:
+        return make_float(float_val(0) - float_val(1));
+    case Instruction::fmul:
+        return make_float(float_val(0) * float_val(1));
+    case Instruction::fdiv:
+        return make_float(float_val(0) / float_val(1));
+    case Instruction::ge:
+        return ConstantInt::get(int_val(0) >= int_val(1), m_);
+    case Instruction::gt:
+        return ConstantInt::get(int_val(0) > int_val(1), m_);
+    case Instruction::le:
+        return ConstantInt::get(int_val(0) <= int_val(1), m_);
+    case Instruction::lt:
+        return ConstantInt::get(int_val(0) < int_val(1), m_);
+    case Instruction::eq:
+        return ConstantInt::get(int_val(0) == int_val(1), m_);
+    case Instruction::ne:
+        return ConstantInt::get(int_val(0) != int_val(1), m_);
+    case Instruction::fge:
+        return ConstantInt::get(unordered() or float_val(0) >= float_val(1),
+                                m_);
+    case Instruction::fgt:
+        return ConstantInt::get(unordered() or float_val(0) > float_val(1),
+                                m_);
+    case Instruction::fle:
+        return ConstantInt::get(unordered() or float_val(0) <= float_val(1),
+                                m_);
+    case Instruction::flt:
+        return ConstantInt::get(unordered() or float_val(0) < float_val(1),
+                                m_);
+    case Instruction::feq:
+        return ConstantInt::get(unordered() or float_val(0) == float_val(1),
+                                m_);
+    case Instruction::fne:
+        return ConstantInt::get(unordered() or float_val(0) != float_val(1),
+                                m_);
+    case Instruction::zext:
+        return ConstantInt::get(static_cast<int>(int_val(0)), m_);
+    case Instruction::fptosi: {
+        auto val = float_val(0);
+        if (not(val >= -2147483648.0f and val < 2147483648.0f))
+            return nullptr;
+        return ConstantInt::get(static_cast<int>(val), m_);
+    }
+    case Instruction::sitofp:
+        return ConstantFP::get(static_cast<float>(int_val(0)), m_);
+    default:
+        return nullptr;
+    }
+}
+
+bool SCCP::resolve_undef_branches(Function *func) {
+    bool changed = false;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not executable_blocks_.count(&bb) or not bb.is_terminated())
+            continue;
+        auto br = bb.get_terminator()->dyn_cast<BranchInst>();
+        if (br == nullptr or not br->is_cond_br())
+            continue;
+        if (get_lattice(br->get_condition()).kind != LatticeVal::undef)
+            continue;
+        set_lattice(br->get_condition()->as<Instruction>(),
+                    {LatticeVal::overdefined});
+        changed = true;
+    }
+    return changed;
+}
+
+void SCCP::replace_constants(Function *func) {
+    std::vector<Instruction *> wait_del;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not executable_blocks_.count(&bb))
+            continue;
+        for (auto &inst : bb.get_instructions()) {
+            auto it = lattice_.find(&inst);
+            if (it == lattice_.end() or
+                it->second.kind != LatticeVal::constant)
+                continue;
+            inst.replace_all_use_with(it->second.val);
+            wait_del.push_back(&inst);
+        }
+    }
+    for (auto inst : wait_del) {
+        inst->remove_all_operands();
+        inst->get_parent()->erase_instr(inst);
+    }
+    folded_ += wait_del.size();
+}
+
+// 只有一条出边可执行的条件分支改为无条件跳转, 并从另一个后继的 phi 中删除来自本块的值
+void SCCP::rewrite_branches(Function *func) {
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not executable_blocks_.count(&bb) or not bb.is_terminated())
+            continue;
+        auto br = bb.get_terminator()->dyn_cast<BranchInst>();
+        if (br == nullptr or not br->is_cond_br())
+            continue;
+        auto if_true = br->get_operand(1)->as<BasicBlock>();
+        auto if_false = br->get_operand(2)->as<BasicBlock>();
+        bool true_taken = executable_edges_.count({&bb, if_true});
+        bool false_taken = executable_edges_.count({&bb, if_false});
+        if (true_taken and false_taken)
+            continue;
+        assert((true_taken or false_taken) &&
+               "executable block without executable successor");
+        auto taken = true_taken ? if_true : if_false;
+        auto not_taken = true_taken ? if_false : if_true;
+        // 删除 br 时其析构函数会断开到两个后继的边
+        bb.erase_instr(br);
+        BranchInst::create_br(taken, &bb);
+        for (auto &inst : not_taken->get_instructions()) {
+            if (not inst.is_phi())
+                break;
+            inst.as<PhiInst>()->remove_phi_operand(&bb);
+        }
+        branches_++;
+    }
+}
+
+void SCCP::remove_dead_blocks(Function *func) {
+    std::vector<BasicBlock *> dead_blocks;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not executable_blocks_.count(&bb))
+            dead_blocks.push_back(&bb);
+    }
+    // 可达的后继不再有来自不可达块的入边
+    for (auto bb : dead_blocks) {
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (not executable_blocks_.count(succ))
+                continue;
+            for (auto &inst : succ->get_instructions()) {
+                if (not inst.is_phi())
+                    break;
+                inst.as<PhiInst>()->remove_phi_operand(bb);
+            }
+        }
+    }
+    // 先断开所有操作数, 不可达块之间的相互引用不会留下悬空的 use
+    for (auto bb : dead_blocks) {
+        for (auto &inst : bb->get_instructions())
+            inst.remove_all_operands();
+    }
+    for (auto bb : dead_blocks) {
+        bb->erase_from_parent();
+        delete bb;
+    }
+    blocks_ += dead_blocks.size();
+}
@@ -0,0 +1,74 @@
+#include "TailRecursion.hpp"
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+
+#include <iterator>
+
+/**
+ * @brief 把函数中自身的尾调用改写为跳回原入口块的循环
+ *
+ * 变换后的结构为
+ *   new_entry: 原入口块中的 alloca; br old_entry
+ *   old_entry: %p = phi [%arg, new_entry], [实参, 尾调用所在块] ...; 原入口块的其余指令
+ * 尾调用及其后的 ret 被替换为 br old_entry。
+ */
+void TailRecursionElim::run_on_function(Function *func) {
+    std::vector<CallInst *> tail_calls;
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &inst : bb.get_instructions()) {
+            if (inst.is_alloca() and static_cast<AllocaInst *>(&inst)
+                                         ->get_alloca_type()
+                                         ->is_array_type())
+                return;
+            if (not inst.is_call() or inst.get_operand(0) != func)
+                continue;
+            auto *call = static_cast<CallInst *>(&inst);
+            if (call->is_tail_call())
+                tail_calls.push_back(call);
+        }
+    }
+    if (tail_calls.empty())
+        return;
+
+    auto *old_entry = func->get_entry_block();
+    auto *new_entry = BasicBlock::create(m_, "", func);
+    func->get_basic_blocks().remove(new_entry);
+    func->get_basic_blocks().push_front(new_entry);
+
+    std::vector<Instruction *> allocas;
+    for (auto &inst : old_entry->get_instructions()) {
+        if (inst.is_alloca())
+            allocas.push_back(&inst);
+    }
+    for (auto *alloca : allocas) {
+        old_entry->remove_instr(alloca);
+        new_entry->add_instruction(alloca);
+        alloca->set_parent(new_entry);
+    }
+    BranchInst::create_br(old_entry, new_entry);
+
+    // 参数的所有使用都改为使用循环头的 phi
+    std::vector<PhiInst *> phis;
+    for (auto &arg : func->get_args()) {
+        auto *phi = PhiInst::create_phi(arg.get_type(), old_entry);
+        arg.replace_all_use_with(phi);
+        phi->add_phi_pair_operand(&arg, new_entry);
+        phis.push_back(phi);
+    }
+    for (auto it = phis.rbegin(); it != phis.rend(); ++it)
+        old_entry->add_instr_begin(*it);
+
+    for (auto *call : tail_calls) {
+        auto *bb = call->get_parent();
+        auto *ret = &*std::next(call->getIterator());
+        for (unsigned i = 0; i < phis.size(); i++)
+            phis[i]->add_phi_pair_operand(call->get_operand(i + 1), bb);
+        ret->remove_all_operands();
+        bb->erase_instr(ret);
+        call->remove_all_operands();
+        bb->erase_instr(call);
+        BranchInst::create_br(old_entry, bb);
+        eliminated_++;
+    }
+}
@@ -0,0 +1,99 @@
+/* 生成含大量函数的 cminus 程序, 用于检查 -j N 与 -j 1 的输出是否逐字节相同。
+ * 用法: gen_many_functions <函数个数> <输出文件>
+ * 各函数的形状按编号轮换 (循环, 数组, 分支, 浮点运算, 调用前一个函数),
+ * 使每个函数级 Pass 与寄存器分配都有事可做。
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// cminus 的标识符只能由字母组成, 编号的各位数字写成 a-j
+std::string name(const char *prefix, int i) {
+    std::string digits = std::to_string(i);
+    for (auto &c : digits)
+        c = 'a' + (c - '0');
+    return prefix + digits;
+}
+
+void gen_function(std::ostream &os, int i) {
+    switch (i % 4) {
+    case 0:
+        os << "int " << name("f", i) << "(int n, int a[]) {\n"
+           << "    int i;\n"
+           << "    int s;\n"
+           << "    i = 0;\n"
+           << "    s = " << i << ";\n"
+           << "    while (i < n) {\n"
+           << "        s = s + a[i] * " << i % 7 + 2 << ";\n"
+           << "        if (s > " << 1000 + i << ") s = s / 3;\n"
+           << "        i = i + 1;\n"
+           << "    }\n"
+           << "    return s;\n"
+           << "}\n";
+        break;
+    case 1:
+        os << "int " << name("f", i) << "(int n, int a[]) {\n"
+           << "    int b[8];\n"
+           << "    int i;\n"
+           << "    i = 0;\n"
+           << "    while (i < 8) {\n"
+           << "        b[i] = n + i * " << i % 5 + 1 << ";\n"
+           << "        i = i + 1;\n"
+           << "    }\n"
+           << "    a[n] = b[n / 2];\n"
+           << "    return " << name("f", i - 1) << "(b[7], a) + b[3];\n"
+           << "}\n";
+        break;
+    case 2:
+        os << "float " << name("g", i) << "(float x, int k) {\n"
+           << "    float y;\n"
+           << "    y = x * " << i % 9 << ".5;\n"
+           << "    if (k > " << i % 11 << ") {\n"
+           << "        y = y - x / 2.0;\n"
+           << "    } else {\n"
+           << "        y = y + k;\n"
+           << "    }\n"
+           << "    return y;\n"
+           << "}\n"
+           << "int " << name("f", i) << "(int n, int a[]) {\n"
+           << "    return " << name("g", i) << "(n * 1.5, a[0]) + "
+           << name("f", i - 1) << "(n - 1, a);\n"
+           << "}\n";
+        break;
+    default:
+        os << "int " << name("f", i) << "(int n, int a[]) {\n"
+           << "    if (n <= 0) return " << i << ";\n"
+           << "    return " << name("f", i) << "(n - 1, a) + "
+           << name("f", i - 1) << "(n / 2, a) - n * " << i % 13 << ";\n"
+           << "}\n";
+        break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <num-functions> <output>\n";
+        return 1;
+    }
+    int num = std::atoi(argv[1]);
+    std::ofstream os(argv[2]);
+    if (num < 1 or not os) {
+        std::cerr << argv[0] << ": invalid arguments\n";
+        return 1;
+    }
+
+    os << "int arr[64];\n";
+    // 0 号函数不调用其他函数, 之后的函数可以调用前一个
+    os << "int " << name("f", 0) << "(int n, int a[]) { return n; }\n";
+    for (int i = 1; i < num; i++)
+        gen_function(os, i);
+    os << "void main(void) {\n"
+       << "    output(" << name("f", num - 1) << "(input(), arr));\n"
+       << "}\n";
+    return 0;
+}
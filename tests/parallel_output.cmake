@@ -0,0 +1,34 @@
+# 用 -j 1 与 -j ${JOBS} 编译同一个含大量函数的程序, 输出必须逐字节相同。
+# 参数: GENERATOR, CMINUSFC, WORK_DIR, NUM_FUNCTIONS, JOBS
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "command failed (${result}): ${ARGN}")
+    endif()
+endfunction()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(source ${WORK_DIR}/many_functions.cminus)
+run(${GENERATOR} ${NUM_FUNCTIONS} ${source})
+
+# 最后一种打开所有可选的优化
+foreach(mode emit-llvm S-O2 S-O2-all)
+    if(mode STREQUAL "emit-llvm")
+        set(flags -emit-llvm)
+    elseif(mode STREQUAL "S-O2")
+        set(flags -S -O2)
+    else()
+        set(flags -S -O2 -inline -sccp -gvn -check-elim -licm -unroll)
+    endif()
+    set(serial ${WORK_DIR}/${mode}.j1)
+    set(parallel ${WORK_DIR}/${mode}.j${JOBS})
+    run(${CMINUSFC} ${flags} -j 1 ${source} -o ${serial})
+    run(${CMINUSFC} ${flags} -j ${JOBS} ${source} -o ${parallel})
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+                            ${serial} ${parallel}
+                    RESULT_VARIABLE different)
+    if(different)
+        message(FATAL_ERROR "${mode}: -j ${JOBS} output differs from -j 1")
+    endif()
+endforeach()
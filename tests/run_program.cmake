@@ -0,0 +1,20 @@
+# 用 FLAGS 把 SOURCE 编译为 LLVM IR, 用 lli 运行, 标准输出必须与 EXPECTED 相同。
+# 参数: CMINUSFC, LLI, IO_LIB, SOURCE, EXPECTED, FLAGS (以分号分隔), OUTPUT
+
+execute_process(COMMAND ${CMINUSFC} -emit-llvm ${FLAGS} ${SOURCE} -o ${OUTPUT}
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cminusfc ${FLAGS} failed (${result})")
+endif()
+
+execute_process(COMMAND ${LLI} -load=${IO_LIB} ${OUTPUT}
+                OUTPUT_VARIABLE actual
+                RESULT_VARIABLE result)
+if(NOT result MATCHES "^[0-9]+$")
+    message(FATAL_ERROR "lli failed: ${result}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${FLAGS}: output differs\n"
+                        "expected:\n${expected}actual:\n${actual}")
+endif()
@@ -0,0 +1,189 @@
+/* 有符号除以常量的指令选择 (CodeGen::gen_sdiv_imm):
+ * 检查 signed_div_magic 给出的魔数与移位量, 并对生成的指令序列逐条解释执行,
+ * 与 C++ 的除法 (向零取整) 比较结果。
+ */
+#include "CodeGen.hpp"
+#include "CodeGenUtil.hpp"
+#include "IRBuilder.hpp"
+#include "Module.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using MI = MachineInstr;
+
+namespace {
+
+int failures = 0;
+
+void check(bool cond, const std::string &what) {
+    if (not cond) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+int32_t low32(int64_t val) { return static_cast<int32_t>(val); }
+
+/* 解释执行 mfunc 中的指令直到 jr, 返回 $a0 的低 32 位。
+ * 只支持除法序列及函数进出会用到的指令, 遇到其他指令时报错。
+ * ops 记录执行过的指令, 用于检查序列的形状。
+ */
+bool execute(const MachineFunction &mfunc, int32_t n, int32_t &result,
+             std::vector<MI::OpID> &ops) {
+    int64_t regs[32] = {};
+    regs[Reg::a(0).id] = n;
+    auto reg = [&](const MachineInstr &inst, unsigned i) -> int64_t & {
+        return regs[inst.get_operand(i).get_greg().id];
+    };
+    auto imm = [&](const MachineInstr &inst, unsigned i) {
+        return inst.get_operand(i).get_imm();
+    };
+    for (auto &mbb : mfunc.get_blocks()) {
+        for (auto &inst : mbb.get_instrs()) {
+            if (inst.is_comment())
+                continue;
+            ops.push_back(inst.get_opcode());
+            int64_t val = 0;
+            switch (inst.get_opcode()) {
+            case MI::JR:
+                result = low32(regs[Reg::a(0).id]);
+                return true;
+            case MI::MOVE:
+                val = reg(inst, 1);
+                break;
+            case MI::ADD_W:
+                val = low32(reg(inst, 1) + reg(inst, 2));
+                break;
+            case MI::SUB_W:
+                val = low32(reg(inst, 1) - reg(inst, 2));
+                break;
+            case MI::ADDI_W:
+                val = low32(reg(inst, 1) + imm(inst, 2));
+                break;
+            case MI::MULH_W:
+                val = (static_cast<int64_t>(low32(reg(inst, 1))) *
+                       low32(reg(inst, 2))) >>
+                      32;
+                break;
+            case MI::SRAI_W:
+                val = low32(reg(inst, 1)) >> imm(inst, 2);
+                break;
+            case MI::SRLI_W:
+                val = low32(static_cast<uint32_t>(reg(inst, 1)) >>
+                            imm(inst, 2));
+                break;
+            case MI::LU12I_W:
+                val = low32(static_cast<uint32_t>(imm(inst, 1)) << 12);
+                break;
+            case MI::ORI:
+                val = reg(inst, 1) | (imm(inst, 2) & 0xFFF);
+                break;
+            default:
+                std::cerr << "unexpected instruction: " << inst.print()
+                          << std::endl;
+                return false;
+            }
+            reg(inst, 0) = val;
+            regs[0] = 0;
+        }
+    }
+    std::cerr << "missing jr in " << mfunc.get_name() << std::endl;
+    return false;
+}
+
+void check_magic(int32_t d, uint32_t magic, int shift) {
+    auto [m, s] = signed_div_magic(d);
+    check(static_cast<uint32_t>(m) == magic and s == shift,
+          "signed_div_magic(" + std::to_string(d) + ") = (" +
+              std::to_string(static_cast<uint32_t>(m)) + ", " +
+              std::to_string(s) + ")");
+}
+
+} // namespace
+
+int main() {
+    // Hacker's Delight 表 10-1
+    check_magic(3, 0x55555556, 0);
+    check_magic(5, 0x66666667, 1);
+    check_magic(6, 0x2AAAAAAB, 0);
+    check_magic(7, 0x92492493, 2);
+    check_magic(9, 0x38E38E39, 1);
+    check_magic(10, 0x66666667, 2);
+    check_magic(11, 0x2E8BA2E9, 1);
+    check_magic(12, 0x2AAAAAAB, 1);
+    check_magic(25, 0x51EB851F, 3);
+    check_magic(125, 0x10624DD3, 3);
+    check_magic(-3, 0x55555555, 1);
+    check_magic(-5, 0x99999999, 1);
+    check_magic(-7, 0x6DB6DB6D, 2);
+
+    std::vector<int32_t> divisors = {1,        -1,      2,       -2,
+                                     4,        -4,      8,       -8,
+                                     1 << 16,  -(1 << 16),       1 << 30,
+                                     -(1 << 30),        INT_MIN, 3,
+                                     -3,       5,       6,       7,
+                                     -7,       10,      641,     1000,
+                                     -1000,    INT_MAX, INT_MIN + 1};
+    std::vector<int32_t> dividends = {
+        INT_MIN, INT_MIN + 1, -1000000007, -12345, -100, -9,
+        -8,      -7,          -6,          -3,     -2,   -1,
+        0,       1,           2,           6,      7,    8,
+        100,     12345,       INT_MAX - 1, INT_MAX};
+
+    // 每个除数一个函数: i32 f(i32 n) { ret n / d }
+    auto m = std::make_unique<Module>();
+    auto int32 = m->get_int32_type();
+    auto fty = FunctionType::get(int32, {int32});
+    std::map<std::string, int32_t> func_divisor;
+    for (std::size_t i = 0; i < divisors.size(); i++) {
+        auto name = "div" + std::to_string(i);
+        auto func = Function::create(fty, name, m.get());
+        auto bb = BasicBlock::create(m.get(), "entry", func);
+        IRBuilder builder(bb, m.get());
+        auto arg = &func->get_args().front();
+        builder.create_ret(builder.create_isdiv(
+            arg, ConstantInt::get(divisors[i], m.get())));
+        func_divisor[name] = divisors[i];
+    }
+
+    CodeGen codegen(m.get(), RegAllocKind::linear);
+    codegen.run();
+
+    for (auto &mfunc : codegen.get_machine_module().get_functions()) {
+        auto d = func_divisor.at(mfunc.get_name());
+        auto abs_d = d < 0 ? -static_cast<int64_t>(d) : static_cast<int64_t>(d);
+        bool pow2 = (abs_d & (abs_d - 1)) == 0;
+        for (auto n : dividends) {
+            if (n == INT_MIN and d == -1)
+                continue; // 溢出, 结果未定义
+            std::vector<MI::OpID> ops;
+            int32_t result = 0;
+            auto what = std::to_string(n) + " / " + std::to_string(d);
+            if (not execute(mfunc, n, result, ops)) {
+                check(false, what + ": cannot execute");
+                continue;
+            }
+            check(result == n / d, what + " = " + std::to_string(result));
+            for (auto op : ops) {
+                check(op != MI::DIV_W, what + ": emitted div.w");
+                if (pow2)
+                    check(op != MI::MULH_W, what + ": emitted mulh.w");
+                if (abs_d == 1)
+                    check(op != MI::SRAI_W and op != MI::SRLI_W,
+                          what + ": emitted a shift");
+            }
+        }
+    }
+
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}